@@ -0,0 +1,145 @@
+#include <cctype>
+#include <cstdlib>
+#include <limits>
+#include "Arguments.hpp"
+
+static std::string ArgumentTrim(const std::string &string)
+{
+  auto begin = string.find_first_not_of(" \t\n\r");
+  if (begin == std::string::npos) {
+    return "";
+  }
+  auto end = string.find_last_not_of(" \t\n\r");
+  return string.substr(begin, end - begin + 1);
+}
+
+static std::string ArgumentUnquote(const std::string &string)
+{
+  if (string.size() >= 2) {
+    const char quote = string.front();
+    if ((quote == '\'' || quote == '"') && string.back() == quote) {
+      return string.substr(1, string.size() - 2);
+    }
+  }
+  return string;
+}
+
+static bool ArgumentIsOptionName(const std::string &name)
+{
+  if (name.empty()) {
+    return false;
+  }
+  for (auto character : name) {
+    if (!std::isalnum((unsigned char)character) && character != '_') {
+      return false;
+    }
+  }
+  return true;
+}
+
+Arguments::Arguments(int argc, const char *const *argv)
+{
+  for (int index = 0; index < argc; index++) {
+    const std::string argument = argv[index];
+    const auto separator = argument.find('=');
+    if (separator != std::string::npos) {
+      std::string name = ArgumentTrim(argument.substr(0, separator));
+      if (ArgumentIsOptionName(name)) {
+        for (auto &character : name) {
+          character = (char)std::tolower((unsigned char)character);
+        }
+        m_options[name] = ArgumentUnquote(ArgumentTrim(argument.substr(separator + 1)));
+        continue;
+      }
+    }
+    m_positional.push_back(argument);
+  }
+}
+
+const std::string &Arguments::operator[](const size_t index) const
+{
+  static const std::string empty;
+  return index < m_positional.size() ? m_positional[index] : empty;
+}
+
+bool Arguments::has(const std::string &name) const
+{
+  return m_options.find(name) != m_options.end();
+}
+
+std::string Arguments::get(const std::string &name, const std::string &defaultValue) const
+{
+  auto it = m_options.find(name);
+  return it != m_options.end() ? it->second : defaultValue;
+}
+
+int64_t Arguments::getInteger(const std::string &name, int64_t defaultValue) const
+{
+  auto it = m_options.find(name);
+  if (it == m_options.end() || it->second.empty()) {
+    return defaultValue;
+  }
+  return std::strtoll(it->second.c_str(), NULL, 0);
+}
+
+bool Arguments::getBoolean(const std::string &name, bool defaultValue) const
+{
+  auto it = m_options.find(name);
+  if (it == m_options.end()) {
+    return defaultValue;
+  }
+  std::string value;
+  for (auto character : it->second) {
+    value.push_back((char)std::tolower((unsigned char)character));
+  }
+  return value.empty() || value == "1" || value == "yes" || value == "true" || value == "on";
+}
+
+bool Arguments::getSize(const std::string &name, size_t &value) const
+{
+  auto it = m_options.find(name);
+  if (it == m_options.end() || it->second.empty()) {
+    return true;
+  }
+  return parseSize(it->second, value);
+}
+
+bool Arguments::parseSize(const std::string &string, size_t &value)
+{
+  size_t index = 0, size = 0;
+  for (; index < string.size() && string[index] >= '0' && string[index] <= '9'; index++) {
+    const size_t digit = (size_t)(string[index] - '0');
+    if (size > (std::numeric_limits<size_t>::max() - digit) / 10) {
+      return false;
+    }
+    size = size * 10 + digit;
+  }
+  if (index == 0) {
+    return false;
+  }
+  int shift = 0;
+  if (index < string.size()) {
+    switch (std::toupper((unsigned char)string[index++])) {
+      case 'K':
+        shift = 10;
+        break;
+      case 'M':
+        shift = 20;
+        break;
+      case 'G':
+        shift = 30;
+        break;
+      default:
+        return false;
+    }
+    // "64MB" is as good as "64M"
+    if (index < string.size() && std::toupper((unsigned char)string[index]) == 'B') {
+      index++;
+    }
+  }
+  if (index != string.size() || size > std::numeric_limits<size_t>::max() >> shift) {
+    return false;
+  }
+  value = size << shift;
+  return true;
+}
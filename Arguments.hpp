@@ -0,0 +1,40 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+ * module arguments, as passed to xCreate/xConnect after the module, database and table names
+ * `name=value` arguments are options, everything else is positional (file path, depth, key path)
+ * option names are case-insensitive, a single pair of surrounding quotes is stripped from option values
+ */
+class Arguments
+{
+public:
+  Arguments(int argc, const char *const *argv);
+
+  size_t size() const { return m_positional.size(); }
+  const std::string &operator[](const size_t) const;
+
+  bool has(const std::string &) const;
+  std::string get(const std::string &, const std::string & = "") const;
+  int64_t getInteger(const std::string &, int64_t = 0) const;
+  bool getBoolean(const std::string &, bool = false) const;
+  /*
+   * leaves `value` as it is if the option is missing or empty, false if it's not a size (see `parseSize`)
+   */
+  bool getSize(const std::string &, size_t &value) const;
+
+  /*
+   * byte count with an optional binary suffix: "4096", "512K", "64M", "2G", false for anything else, including
+   * negative counts and counts that don't fit
+   */
+  static bool parseSize(const std::string &, size_t &);
+
+  const std::map<std::string, std::string> &getOptions() const { return m_options; }
+
+private:
+  std::vector<std::string> m_positional;
+  std::map<std::string, std::string> m_options;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+/*
+ * bplist00 layout: "bplist00" header, objects, offset table, 32 bytes trailer
+ * trailer: 6 unused bytes, offset size, reference size, object count, root object, offset table position
+ * object marker: high nibble is the type, low nibble is either the size or 0xF followed by an integer object
+ */
+enum
+{
+  BinaryPlistHeaderSize = 8,
+  BinaryPlistTrailerSize = 32,
+};
+
+enum
+{
+  BinaryPlistSimple = 0x0,
+  BinaryPlistInteger = 0x1,
+  BinaryPlistReal = 0x2,
+  BinaryPlistDate = 0x3,
+  BinaryPlistData = 0x4,
+  BinaryPlistASCIIString = 0x5,
+  BinaryPlistUnicodeString = 0x6,
+  BinaryPlistUID = 0x8,
+  BinaryPlistArray = 0xA,
+  BinaryPlistSet = 0xC,
+  BinaryPlistDictionary = 0xD,
+};
+
+enum
+{
+  BinaryPlistNull = 0x00,
+  BinaryPlistFalse = 0x08,
+  BinaryPlistTrue = 0x09,
+};
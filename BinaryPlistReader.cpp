@@ -0,0 +1,441 @@
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include "BinaryPlist.hpp"
+#include "BinaryPlistReader.hpp"
+#include "Unicode.hpp"
+
+static double BinaryPlistGetReal(const uint8_t *bytes, const size_t size)
+{
+  uint64_t bits = 0;
+  for (size_t index = 0; index < size; index++) {
+    bits = bits << 8 | bytes[index];
+  }
+  if (size == 4) {
+    float value;
+    uint32_t bits32 = (uint32_t)bits;
+    std::memcpy(&value, &bits32, sizeof(value));
+    return value;
+  }
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static size_t BinaryPlistSizeOf(const uint64_t value)
+{
+  return value <= 0xFF ? 1 : value <= 0xFFFF ? 2 : value <= 0xFFFFFFFF ? 4 : 8;
+}
+
+static void BinaryPlistAppend(std::string &bytes, const uint64_t value, const size_t size)
+{
+  for (size_t index = size; index > 0; index--) {
+    bytes.push_back((char)(value >> (8 * (index - 1)) & 0xFF));
+  }
+}
+
+bool BinaryPlistReader::isBinaryPlist(const void *data, const size_t size)
+{
+  return size >= BinaryPlistHeaderSize && std::memcmp(data, "bplist00", BinaryPlistHeaderSize) == 0;
+}
+
+std::shared_ptr<BinaryPlistReader> BinaryPlistReader::create(const std::shared_ptr<const Buffer> &buffer)
+{
+  const size_t size = buffer->size();
+  if (!isBinaryPlist(buffer->data(), size) || size < BinaryPlistHeaderSize + 1 + BinaryPlistTrailerSize) {
+    return nullptr;
+  }
+
+  std::shared_ptr<BinaryPlistReader> reader(new BinaryPlistReader(buffer));
+  const size_t trailer = size - BinaryPlistTrailerSize;
+  const uint8_t *data = buffer->data();
+  reader->m_offsetSize = data[trailer + 6];
+  reader->m_referenceSize = data[trailer + 7];
+  reader->m_objectCount = reader->getInteger(trailer + 8, 8);
+  const uint64_t root = reader->getInteger(trailer + 16, 8);
+  reader->m_offsetTable = reader->getInteger(trailer + 24, 8);
+
+  if (reader->m_offsetSize < 1 || reader->m_offsetSize > 8 || reader->m_referenceSize < 1 || reader->m_referenceSize > 8) {
+    return nullptr;
+  }
+  if (reader->m_objectCount == 0 || root >= reader->m_objectCount) {
+    return nullptr;
+  }
+  if (reader->m_offsetTable <= BinaryPlistHeaderSize || reader->m_offsetTable > trailer ||
+      reader->m_objectCount > (trailer - reader->m_offsetTable) / reader->m_offsetSize) {
+    return nullptr;
+  }
+  reader->m_root = (Node)root;
+  return reader;
+}
+
+uint64_t BinaryPlistReader::getInteger(const size_t offset, const size_t size) const
+{
+  const uint8_t *bytes = m_buffer->data() + offset;
+  uint64_t value = 0;
+  for (size_t index = 0; index < size; index++) {
+    value = value << 8 | bytes[index];
+  }
+  return value;
+}
+
+bool BinaryPlistReader::getObject(const Node node, Object &object) const
+{
+  if (node >= m_objectCount) {
+    return false;
+  }
+  const uint64_t offset = getInteger((size_t)(m_offsetTable + node * m_offsetSize), m_offsetSize);
+  if (offset < BinaryPlistHeaderSize || offset >= m_offsetTable) {
+    return false;
+  }
+
+  const uint8_t *data = m_buffer->data();
+  object.marker = data[offset];
+  object.count = object.marker & 0x0F;
+  object.offset = (size_t)offset + 1;
+  object.begin = (size_t)offset;
+  object.end = object.offset;
+
+  size_t unit;
+  switch (object.marker >> 4) {
+    case BinaryPlistSimple:
+      return object.marker == BinaryPlistNull || object.marker == BinaryPlistFalse || object.marker == BinaryPlistTrue;
+    case BinaryPlistInteger:
+      if (object.count > 4) {
+        return false;
+      }
+      unit = (size_t)1 << object.count;
+      object.count = 1;
+      break;
+    case BinaryPlistReal:
+      if (object.count != 2 && object.count != 3) {
+        return false;
+      }
+      unit = (size_t)1 << object.count;
+      object.count = 1;
+      break;
+    case BinaryPlistDate:
+      if (object.marker != 0x33) {
+        return false;
+      }
+      unit = 8;
+      object.count = 1;
+      break;
+    case BinaryPlistUID:
+      unit = object.count + 1;
+      object.count = 1;
+      break;
+    case BinaryPlistData:
+    case BinaryPlistASCIIString:
+      unit = 1;
+      break;
+    case BinaryPlistUnicodeString:
+      unit = 2;
+      break;
+    case BinaryPlistArray:
+    case BinaryPlistSet:
+      unit = m_referenceSize;
+      break;
+    case BinaryPlistDictionary:
+      unit = 2 * m_referenceSize;
+      break;
+    default:
+      return false;
+  }
+
+  if ((object.marker >> 4) >= BinaryPlistData && object.count == 0x0F) {
+    if (object.offset >= m_offsetTable || (data[object.offset] >> 4) != BinaryPlistInteger || (data[object.offset] & 0x0F) > 3) {
+      return false;
+    }
+    const size_t size = (size_t)1 << (data[object.offset] & 0x0F);
+    if (object.offset + 1 + size > m_offsetTable) {
+      return false;
+    }
+    const uint64_t count = getInteger(object.offset + 1, size);
+    object.offset += 1 + size;
+    if (count > SIZE_MAX) {
+      return false;
+    }
+    object.count = (size_t)count;
+  }
+
+  if (object.offset > m_offsetTable || object.count > (m_offsetTable - object.offset) / unit) {
+    return false;
+  }
+  object.end = object.offset + object.count * unit;
+  return true;
+}
+
+bool BinaryPlistReader::getReference(const Object &object, const size_t index, Node &node) const
+{
+  const uint64_t reference = getInteger(object.offset + index * m_referenceSize, m_referenceSize);
+  node = (Node)reference;
+  return reference < m_objectCount;
+}
+
+bool BinaryPlistReader::getText(const Object &object, std::string &text) const
+{
+  const uint8_t *bytes = m_buffer->data() + object.offset;
+  switch (object.marker >> 4) {
+    case BinaryPlistASCIIString:
+      text.assign((const char *)bytes, object.count);
+      return true;
+    case BinaryPlistUnicodeString:
+      text.clear();
+      Unicode::appendUtf16BE(text, bytes, object.count);
+      return true;
+    default:
+      return false;
+  }
+}
+
+Cell::Type BinaryPlistReader::getType(const Node node) const
+{
+  Object object;
+  if (!getObject(node, object)) {
+    return Cell::NUL;
+  }
+  switch (object.marker >> 4) {
+    case BinaryPlistSimple:
+      return object.marker == BinaryPlistNull ? Cell::NUL : Cell::INTEGER;
+    case BinaryPlistInteger:
+      return Cell::INTEGER;
+    case BinaryPlistReal:
+    case BinaryPlistDate:
+      return Cell::REAL;
+    case BinaryPlistData:
+      return Cell::BLOB;
+    case BinaryPlistASCIIString:
+    case BinaryPlistUnicodeString:
+      return Cell::TEXT;
+    case BinaryPlistUID:
+    case BinaryPlistDictionary:
+      return Cell::ROW;
+    default:
+      return Cell::COLUMN;
+  }
+}
+
+bool BinaryPlistReader::find(const Node node, const std::string &key, Node &result) const
+{
+  Object object;
+  if (!getObject(node, object) || (object.marker >> 4) != BinaryPlistDictionary) {
+    return false;
+  }
+  std::string text;
+  for (size_t index = 0; index < object.count; index++) {
+    Node keyNode;
+    Object keyObject;
+    if (!getReference(object, index, keyNode) || !getObject(keyNode, keyObject)) {
+      return false;
+    }
+    bool matches;
+    if ((keyObject.marker >> 4) == BinaryPlistASCIIString) {
+      matches = keyObject.count == key.size() && std::memcmp(m_buffer->data() + keyObject.offset, key.data(), key.size()) == 0;
+    }
+    else {
+      matches = getText(keyObject, text) && text == key;
+    }
+    if (matches) {
+      return getReference(object, object.count + index, result);
+    }
+  }
+  return false;
+}
+
+bool BinaryPlistReader::next(const Node node, size_t &position, Node &item, std::string &key) const
+{
+  Object object;
+  if (!getObject(node, object) || position >= object.count) {
+    return false;
+  }
+  switch (object.marker >> 4) {
+    case BinaryPlistDictionary: {
+      Node keyNode;
+      Object keyObject;
+      if (!getReference(object, position, keyNode) || !getObject(keyNode, keyObject) || !getText(keyObject, key) ||
+          !getReference(object, object.count + position, item)) {
+        return false;
+      }
+      break;
+    }
+    case BinaryPlistArray:
+    case BinaryPlistSet:
+      if (!getReference(object, position, item)) {
+        return false;
+      }
+      break;
+    default:
+      return false;
+  }
+  position++;
+  return true;
+}
+
+Cell BinaryPlistReader::read(const Node node, const int depth) const
+{
+  /*
+   * containers being read are kept on a stack, a document nests as deep as it has objects
+   * a reference to a container that is still being read is a cycle, the document is broken then
+   */
+  std::vector<ReadFrame> frames;
+  std::unordered_set<Node> path;
+  Node current = node;
+  while (true) {
+    Object object;
+    Cell cell;
+    if (!getObject(current, object)) {
+      return nullptr;
+    }
+    if (!read(current, object, depth - (int)frames.size(), cell)) {
+      if (!path.insert(current).second) {
+        return nullptr;
+      }
+      frames.push_back(ReadFrame{current, object, (object.marker >> 4) == BinaryPlistDictionary, 0, "", {}, {}});
+      if (!frames.back().isDictionary) {
+        frames.back().column.reserve(object.count);
+      }
+    }
+    else if (frames.empty()) {
+      return cell;
+    }
+    else {
+      frames.back().add(std::move(cell));
+    }
+
+    while (true) {
+      auto &frame = frames.back();
+      if (frame.index < frame.object.count) {
+        Node keyNode;
+        Object keyObject;
+        const size_t index = frame.isDictionary ? frame.object.count + frame.index : frame.index;
+        if (!getReference(frame.object, index, current) ||
+            (frame.isDictionary && (!getReference(frame.object, frame.index, keyNode) || !getObject(keyNode, keyObject) ||
+                                    !getText(keyObject, frame.key)))) {
+          return nullptr;
+        }
+        break;
+      }
+      Cell container = frame.isDictionary ? Cell(std::move(frame.row)) : Cell(std::move(frame.column));
+      path.erase(frame.node);
+      frames.pop_back();
+      if (frames.empty()) {
+        return container;
+      }
+      frames.back().add(std::move(container));
+    }
+  }
+}
+
+/*
+ * `cell` is the value of any object but a container that is read deeper than `depth`, those return false
+ * null objects are valid values (a NUL cell) like any other
+ */
+bool BinaryPlistReader::read(const Node node, const Object &object, const int depth, Cell &cell) const
+{
+  const uint8_t *bytes = m_buffer->data() + object.offset;
+  const size_t size = (size_t)1 << (object.marker & 0x0F);
+
+  switch (object.marker >> 4) {
+    case BinaryPlistSimple:
+      cell = object.marker == BinaryPlistNull ? Cell() : Cell::boolean(object.marker == BinaryPlistTrue);
+      return true;
+    case BinaryPlistInteger:
+      // 1, 2 and 4 byte integers are unsigned, 8 byte ones are signed, 16 byte ones are truncated to the low 8 bytes
+      cell = (Cell::Integer)getInteger(object.offset + (size == 16 ? 8 : 0), size == 16 ? 8 : size);
+      return true;
+    case BinaryPlistReal:
+      cell = (Cell::Real)BinaryPlistGetReal(bytes, size);
+      return true;
+    case BinaryPlistDate:
+      cell = Cell::date(BinaryPlistGetReal(bytes, 8));
+      return true;
+    case BinaryPlistData:
+      cell = Cell::Blob(bytes, bytes + object.count);
+      return true;
+    case BinaryPlistASCIIString:
+    case BinaryPlistUnicodeString: {
+      Cell::Text text;
+      getText(object, text);
+      cell = Cell(std::move(text));
+      return true;
+    }
+    case BinaryPlistUID:
+      // keyed archiver references, represented the same way the XML format spells them
+      cell = Cell::Row{{"CF$UID", (Cell::Integer)getInteger(object.offset, (object.marker & 0x0F) + 1)}};
+      return true;
+    default:
+      break;
+  }
+
+  if (depth > 0) {
+    return false;
+  }
+  cell = lazy(node, (object.marker >> 4) == BinaryPlistDictionary ? Cell::ROW : Cell::COLUMN);
+  return true;
+}
+
+bool BinaryPlistReader::slice(const Node node, std::string &bytes) const
+{
+  // objects reachable from the node are numbered in discovery order, shared objects and cycles are copied once
+  std::unordered_map<Node, uint64_t> references{{node, 0}};
+  std::vector<Node> nodes{node};
+  for (size_t index = 0; index < nodes.size(); index++) {
+    Object object;
+    if (!getObject(nodes[index], object)) {
+      return false;
+    }
+    const uint8_t type = object.marker >> 4;
+    if (type != BinaryPlistArray && type != BinaryPlistSet && type != BinaryPlistDictionary) {
+      continue;
+    }
+    const size_t count = type == BinaryPlistDictionary ? 2 * object.count : object.count;
+    for (size_t item = 0; item < count; item++) {
+      Node child;
+      if (!getReference(object, item, child)) {
+        return false;
+      }
+      if (references.insert({child, nodes.size()}).second) {
+        nodes.push_back(child);
+      }
+    }
+  }
+
+  // objects are copied as they are, only references are renumbered (and resized to the slice's object count)
+  const uint8_t *data = m_buffer->data();
+  const size_t referenceSize = BinaryPlistSizeOf(nodes.size() - 1);
+  std::vector<uint64_t> offsets;
+  offsets.reserve(nodes.size());
+  bytes.assign("bplist00");
+  for (const Node item : nodes) {
+    Object object;
+    getObject(item, object);
+    offsets.push_back(bytes.size());
+    const uint8_t type = object.marker >> 4;
+    if (type != BinaryPlistArray && type != BinaryPlistSet && type != BinaryPlistDictionary) {
+      bytes.append((const char *)data + object.begin, object.end - object.begin);
+      continue;
+    }
+    bytes.append((const char *)data + object.begin, object.offset - object.begin);
+    const size_t count = type == BinaryPlistDictionary ? 2 * object.count : object.count;
+    for (size_t index = 0; index < count; index++) {
+      Node child;
+      getReference(object, index, child);
+      BinaryPlistAppend(bytes, references[child], referenceSize);
+    }
+  }
+
+  const uint64_t offsetTable = bytes.size();
+  const size_t offsetSize = BinaryPlistSizeOf(offsets.back());
+  for (const uint64_t offset : offsets) {
+    BinaryPlistAppend(bytes, offset, offsetSize);
+  }
+  bytes.append(6, '\0');
+  bytes.push_back((char)offsetSize);
+  bytes.push_back((char)referenceSize);
+  BinaryPlistAppend(bytes, nodes.size(), 8);
+  BinaryPlistAppend(bytes, 0, 8);
+  BinaryPlistAppend(bytes, offsetTable, 8);
+  return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <unordered_set>
+#include <vector>
+#include "PlistReader.hpp"
+
+/*
+ * bplist00 reader, nodes are object references
+ */
+class BinaryPlistReader : public PlistReader
+{
+public:
+  static bool isBinaryPlist(const void *, const size_t);
+  static std::shared_ptr<BinaryPlistReader> create(const std::shared_ptr<const Buffer> &);
+
+  Node getRoot() const override { return m_root; }
+  Cell::Type getType(const Node) const override;
+  bool find(const Node, const std::string &, Node &) const override;
+  bool next(const Node, size_t &, Node &, std::string &) const override;
+  Cell read(const Node, const int) const override;
+  bool slice(const Node, std::string &) const override;
+
+private:
+  BinaryPlistReader(const std::shared_ptr<const Buffer> &buffer) : PlistReader(buffer) { }
+
+  struct Object
+  {
+    uint8_t marker;
+    size_t count;
+    size_t offset;
+    size_t begin;
+    size_t end;
+  };
+
+  bool getObject(const Node, Object &) const;
+  bool getReference(const Object &, const size_t, Node &) const;
+  bool getText(const Object &, std::string &) const;
+  bool read(const Node, const Object &, const int, Cell &) const;
+
+  struct ReadFrame
+  {
+    Node node;
+    Object object;
+    bool isDictionary;
+    size_t index;
+    std::string key;
+    Cell::Row row;
+    Cell::Column column;
+
+    void add(Cell &&cell)
+    {
+      if (isDictionary) {
+        row.insert({key, std::move(cell)});
+      }
+      else {
+        column.push_back(std::move(cell));
+      }
+      index++;
+    }
+  };
+
+  uint64_t getInteger(const size_t offset, const size_t size) const;
+
+  size_t m_offsetSize = 0;
+  size_t m_referenceSize = 0;
+  uint64_t m_objectCount = 0;
+  uint64_t m_offsetTable = 0;
+  Node m_root = 0;
+};
@@ -0,0 +1,251 @@
+#include <cstring>
+#include "BinaryPlist.hpp"
+#include "BinaryPlistWriter.hpp"
+#include "Trace.hpp"
+#include "Unicode.hpp"
+
+static size_t BinaryPlistWriterSizeOf(const uint64_t value)
+{
+  return value <= 0xFF ? 1 : value <= 0xFFFF ? 2 : value <= 0xFFFFFFFF ? 4 : 8;
+}
+
+static uint8_t BinaryPlistWriterLog2(const size_t size)
+{
+  return size == 1 ? 0 : size == 2 ? 1 : size == 4 ? 2 : 3;
+}
+
+static void BinaryPlistWriterAppend(std::string &bytes, const uint64_t value, const size_t size)
+{
+  for (size_t index = size; index > 0; index--) {
+    bytes.push_back((char)(value >> (8 * (index - 1)) & 0xFF));
+  }
+}
+
+static void BinaryPlistWriterAppendInteger(std::string &bytes, const uint64_t value)
+{
+  // 8 byte integers are read back as signed, which is what negative values need
+  const size_t size = BinaryPlistWriterSizeOf(value);
+  bytes.push_back((char)(BinaryPlistInteger << 4 | BinaryPlistWriterLog2(size)));
+  BinaryPlistWriterAppend(bytes, value, size);
+}
+
+static void BinaryPlistWriterAppendHeader(std::string &bytes, const uint8_t type, const uint64_t count)
+{
+  if (count < 0xF) {
+    bytes.push_back((char)(type << 4 | count));
+    return;
+  }
+  bytes.push_back((char)(type << 4 | 0xF));
+  BinaryPlistWriterAppendInteger(bytes, count);
+}
+
+static void BinaryPlistWriterAppendReal(std::string &bytes, const uint8_t type, const double value)
+{
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  bytes.push_back((char)(type << 4 | 3));
+  BinaryPlistWriterAppend(bytes, bits, 8);
+}
+
+static void BinaryPlistWriterAppendText(std::string &bytes, const std::string &text)
+{
+  bool isASCII = true;
+  for (const char character : text) {
+    if ((unsigned char)character >= 0x80) {
+      isASCII = false;
+      break;
+    }
+  }
+  if (isASCII) {
+    BinaryPlistWriterAppendHeader(bytes, BinaryPlistASCIIString, text.size());
+    bytes.append(text);
+    return;
+  }
+  std::string units;
+  BinaryPlistWriterAppendHeader(bytes, BinaryPlistUnicodeString, Unicode::encodeUtf16BE(units, text));
+  bytes.append(units);
+}
+
+static bool BinaryPlistWriterIsUID(const Cell::Row &row)
+{
+  if (row.size() != 1 || row.begin()->first != "CF$UID" || !row.begin()->second.isInteger()) {
+    return false;
+  }
+  const Cell::Integer value = row.begin()->second.integerValue();
+  return value >= 0 && value <= 0xFFFFFFFF;
+}
+
+bool BinaryPlistWriter::write(const Cell &cell, std::string &bytes)
+{
+  TRACE_SCOPE("BinaryPlistWriter::write");
+  if (!cell.isValid()) {
+    return false;
+  }
+  BinaryPlistWriter writer;
+  writer.add(cell);
+  writer.serialize(bytes);
+  return true;
+}
+
+uint64_t BinaryPlistWriter::addPrimitive(std::string &&bytes)
+{
+  auto result = m_primitives.emplace(std::move(bytes), m_objects.size());
+  if (result.second) {
+    m_objects.push_back({&result.first->first, 0, {}});
+    m_size += result.first->first.size();
+  }
+  return result.first->second;
+}
+
+uint64_t BinaryPlistWriter::add(const Cell &cell)
+{
+  /*
+   * containers being added are kept on a stack, objects are numbered in the order a depth-first walk meets them
+   */
+  uint64_t reference;
+  if (add(cell, reference)) {
+    return reference;
+  }
+  std::vector<WriteFrame> frames;
+  open(cell, frames);
+  while (true) {
+    auto &frame = frames.back();
+    const Cell *child = nullptr;
+    if (frame.cell->isRow()) {
+      const auto &row = frame.cell->rowValue();
+      while (frame.row != row.end() && !frame.row->second.isValid()) {
+        ++frame.row;
+      }
+      if (frame.row != row.end()) {
+        std::string key;
+        BinaryPlistWriterAppendText(key, frame.row->first);
+        frame.references.push_back(addPrimitive(std::move(key)));
+        child = &(frame.row++)->second;
+      }
+    }
+    else {
+      const auto &column = frame.cell->columnValue();
+      while (frame.column < column.size() && !column[frame.column].isValid()) {
+        frame.column++;
+      }
+      if (frame.column < column.size()) {
+        child = &column[frame.column++];
+      }
+    }
+    if (child != nullptr) {
+      if (add(*child, reference)) {
+        frame.values.push_back(reference);
+      }
+      else {
+        open(*child, frames);
+      }
+      continue;
+    }
+
+    const uint64_t index = frame.index;
+    auto &object = m_objects[index];
+    object.type = frame.cell->isRow() ? BinaryPlistDictionary : BinaryPlistArray;
+    object.references = std::move(frame.references);
+    object.references.insert(object.references.end(), frame.values.begin(), frame.values.end());
+    m_references += object.references.size();
+    frames.pop_back();
+    if (frames.empty()) {
+      return index;
+    }
+    frames.back().values.push_back(index);
+  }
+}
+
+void BinaryPlistWriter::open(const Cell &cell, std::vector<WriteFrame> &frames)
+{
+  // containers are never shared, their index is taken before the children's so the root ends up first
+  frames.push_back(WriteFrame{&cell, m_objects.size(), {}, 0, {}, {}});
+  if (cell.isRow()) {
+    frames.back().row = cell.rowValue().begin();
+  }
+  m_objects.push_back({nullptr, 0, {}});
+}
+
+/*
+ * adds anything but containers, which return false
+ */
+bool BinaryPlistWriter::add(const Cell &cell, uint64_t &reference)
+{
+  std::string bytes;
+  switch (cell.type()) {
+    case Cell::INTEGER:
+      if (cell.isBoolean()) {
+        bytes.push_back(cell.integerValue() ? BinaryPlistTrue : BinaryPlistFalse);
+      }
+      else {
+        BinaryPlistWriterAppendInteger(bytes, (uint64_t)cell.integerValue());
+      }
+      break;
+    case Cell::REAL:
+      BinaryPlistWriterAppendReal(bytes, cell.isDate() ? BinaryPlistDate : BinaryPlistReal, cell.realValue());
+      break;
+    case Cell::TEXT:
+      BinaryPlistWriterAppendText(bytes, cell.textValue());
+      break;
+    case Cell::BLOB: {
+      const Cell::Blob &blob = cell.blobValue();
+      BinaryPlistWriterAppendHeader(bytes, BinaryPlistData, blob.size());
+      bytes.append(blob.begin(), blob.end());
+      break;
+    }
+    case Cell::NUL:
+      bytes.push_back(BinaryPlistNull);
+      break;
+    case Cell::ROW: {
+      if (!BinaryPlistWriterIsUID(cell.rowValue())) {
+        return false;
+      }
+      const uint64_t value = (uint64_t)cell.rowValue().begin()->second.integerValue();
+      const size_t size = BinaryPlistWriterSizeOf(value);
+      bytes.push_back((char)(BinaryPlistUID << 4 | (size - 1)));
+      BinaryPlistWriterAppend(bytes, value, size);
+      break;
+    }
+    case Cell::COLUMN:
+      return false;
+  }
+  reference = addPrimitive(std::move(bytes));
+  return true;
+}
+
+void BinaryPlistWriter::serialize(std::string &bytes) const
+{
+  const size_t referenceSize = BinaryPlistWriterSizeOf(m_objects.size() - 1);
+  std::vector<uint64_t> offsets;
+  offsets.reserve(m_objects.size());
+
+  // upper bound, so the output is allocated once however large the document is
+  bytes.clear();
+  bytes.reserve(BinaryPlistHeaderSize + m_size + m_objects.size() * 18 + m_references * referenceSize + BinaryPlistTrailerSize);
+  bytes.append("bplist00");
+  for (const auto &object : m_objects) {
+    offsets.push_back(bytes.size());
+    if (object.bytes) {
+      bytes.append(*object.bytes);
+      continue;
+    }
+    const size_t count = object.references.size();
+    BinaryPlistWriterAppendHeader(bytes, object.type, object.type == BinaryPlistDictionary ? count / 2 : count);
+    for (const uint64_t reference : object.references) {
+      BinaryPlistWriterAppend(bytes, reference, referenceSize);
+    }
+  }
+
+  const uint64_t offsetTable = bytes.size();
+  const size_t offsetSize = BinaryPlistWriterSizeOf(offsets.back());
+  for (const uint64_t offset : offsets) {
+    BinaryPlistWriterAppend(bytes, offset, offsetSize);
+  }
+
+  bytes.append(6, '\0');
+  bytes.push_back((char)offsetSize);
+  bytes.push_back((char)referenceSize);
+  BinaryPlistWriterAppend(bytes, m_objects.size(), 8);
+  BinaryPlistWriterAppend(bytes, 0, 8);
+  BinaryPlistWriterAppend(bytes, offsetTable, 8);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Cell.hpp"
+
+/*
+ * bplist00 writer, equal primitives (dictionary keys included) are stored once
+ * reference and offset sizes are the smallest that fit, null cells are left out
+ * single-key {"CF$UID": n} dictionaries are written back as UIDs
+ */
+class BinaryPlistWriter
+{
+public:
+  static bool write(const Cell &, std::string &);
+
+private:
+  BinaryPlistWriter() = default;
+
+  struct Object
+  {
+    const std::string *bytes;
+    uint8_t type;
+    std::vector<uint64_t> references;
+  };
+
+  struct WriteFrame
+  {
+    const Cell *cell;
+    uint64_t index;
+    Cell::Row::const_iterator row;
+    size_t column;
+    std::vector<uint64_t> references;
+    std::vector<uint64_t> values;
+  };
+
+  uint64_t add(const Cell &);
+  bool add(const Cell &, uint64_t &);
+  void open(const Cell &, std::vector<WriteFrame> &);
+  uint64_t addPrimitive(std::string &&);
+  void serialize(std::string &) const;
+
+  std::vector<Object> m_objects;
+  std::unordered_map<std::string, uint64_t> m_primitives;
+  size_t m_size = 0;
+  size_t m_references = 0;
+};
@@ -0,0 +1,57 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Buffer.hpp"
+
+std::shared_ptr<const Buffer> Buffer::fromFile(const std::string &path)
+{
+  int file = open(path.c_str(), O_RDONLY);
+  if (file < 0) {
+    return nullptr;
+  }
+  struct stat info;
+  if (fstat(file, &info) != 0 || !S_ISREG(info.st_mode)) {
+    close(file);
+    return nullptr;
+  }
+
+  std::shared_ptr<Buffer> buffer(new Buffer());
+  buffer->m_size = (size_t)info.st_size;
+  if (buffer->m_size != 0) {
+    void *mapping = mmap(NULL, buffer->m_size, PROT_READ, MAP_PRIVATE, file, 0);
+    if (mapping == MAP_FAILED) {
+      close(file);
+      return nullptr;
+    }
+    buffer->m_mapping = mapping;
+    buffer->m_data = (const uint8_t *)mapping;
+  }
+  close(file);
+  return buffer;
+}
+
+std::shared_ptr<const Buffer> Buffer::copy(const void *data, size_t size)
+{
+  std::shared_ptr<Buffer> buffer(new Buffer());
+  buffer->m_storage.assign((const uint8_t *)data, (const uint8_t *)data + size);
+  buffer->m_data = buffer->m_storage.data();
+  buffer->m_size = size;
+  return buffer;
+}
+
+std::shared_ptr<const Buffer> Buffer::wrap(const void *data, size_t size, const std::shared_ptr<const void> &owner)
+{
+  std::shared_ptr<Buffer> buffer(new Buffer());
+  buffer->m_data = (const uint8_t *)data;
+  buffer->m_size = size;
+  buffer->m_owner = owner;
+  return buffer;
+}
+
+Buffer::~Buffer()
+{
+  if (m_mapping != nullptr) {
+    munmap(m_mapping, m_size);
+  }
+}
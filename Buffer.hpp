@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * immutable byte range the native readers (and lazily decoded cells) keep alive for as long as they need it
+ * files are memory-mapped, so pages of skipped subtrees are never touched
+ */
+class Buffer
+{
+public:
+  static std::shared_ptr<const Buffer> fromFile(const std::string &path);
+  static std::shared_ptr<const Buffer> copy(const void *data, size_t size);
+
+  /*
+   * bytes owned by someone else, `owner` is kept alive for as long as the buffer is
+   */
+  static std::shared_ptr<const Buffer> wrap(const void *data, size_t size, const std::shared_ptr<const void> &owner);
+
+  const uint8_t *data() const { return m_data; }
+  size_t size() const { return m_size; }
+
+  Buffer(const Buffer &) = delete;
+  Buffer &operator=(const Buffer &) = delete;
+
+  ~Buffer();
+
+private:
+  Buffer() = default;
+
+  const uint8_t *m_data = nullptr;
+  size_t m_size = 0;
+  void *m_mapping = nullptr;
+  std::vector<uint8_t> m_storage;
+  std::shared_ptr<const void> m_owner;
+};
@@ -1,42 +1,135 @@
+#include <atomic>
+#include <mutex>
 #include "Cell.hpp"
+#include "Trace.hpp"
+#include "Unicode.hpp"
 
 using std::nullptr_t;
 using std::make_shared;
 
+/*
+ * `make_shared` places the value next to its control block (vtable pointer, strong and weak counters)
+ */
+static const size_t CellControlBlockSize = 3 * sizeof(void *);
+
+/*
+ * elements that are containers are left to the caller (see ValueCell::memoryUsage)
+ */
+static size_t CellElementUsage(const Cell &item, std::vector<const Cell *> &pending)
+{
+  if (item.isPrimitive()) {
+    return item.memoryUsage();
+  }
+  pending.push_back(&item);
+  return 0;
+}
+
+static size_t CellHeapUsage(const Cell::Row &row, std::vector<const Cell *> &pending)
+{
+  static const size_t nodeSize = 4 * sizeof(void *) + sizeof(Cell::Row::value_type);
+  size_t usage = 0;
+  for (auto &item : row) {
+    usage += nodeSize + CellElementUsage(item.second, pending);
+    if (item.first.capacity() >= sizeof(Cell::Name)) {
+      usage += item.first.capacity() + 1;
+    }
+  }
+  return usage;
+}
+
+static size_t CellHeapUsage(const Cell::Column &column, std::vector<const Cell *> &pending)
+{
+  size_t usage = column.capacity() * sizeof(Cell);
+  for (auto &item : column) {
+    usage += CellElementUsage(item, pending);
+  }
+  return usage;
+}
+
+static size_t CellHeapUsage(const Cell::Text &text, std::vector<const Cell *> &)
+{
+  const char *data = text.data();
+  const bool isInline = data >= (const char *)&text && data < (const char *)(&text + 1);
+  return isInline ? 0 : text.capacity() + 1;
+}
+
+static size_t CellHeapUsage(const Cell::Blob &blob, std::vector<const Cell *> &) { return blob.capacity(); }
+
+template<typename T>
+static size_t CellHeapUsage(const T &, std::vector<const Cell *> &) { return 0; }
+
 template<Cell::Type _type, typename T>
 class TemplateCell : public ValueCell
 {
 protected:
   TemplateCell(const T &value) : m_value(value) { }
+  TemplateCell(T &&value) : m_value(std::move(value)) { }
   Cell::Type type() const override { return _type; }
-  const T m_value;
+  size_t memoryUsage(std::vector<const Cell *> &pending) const override
+  {
+    return CellControlBlockSize + sizeof(*this) + CellHeapUsage(m_value, pending);
+  }
+  T m_value;
 };
 
 class RowCell : public TemplateCell<Cell::ROW, Cell::Row>
 {
 public:
   RowCell(const Cell::Row &value) : TemplateCell(value) { }
+  RowCell(Cell::Row &&value) : TemplateCell(std::move(value)) { }
+  ~RowCell() override
+  {
+    Cell::Column pending;
+    detach(pending);
+    release(pending);
+  }
   virtual const Cell::Row &rowValue() const override { return m_value; }
   virtual const Cell &operator[](const Cell::Name &name) const override {
     auto it = m_value.find(name);
     return (it != m_value.end()) ? it->second : ValueCell::operator[](name);
   }
   virtual size_t size() const override { return m_value.size(); }
+  void detach(Cell::Column &pending) override
+  {
+    for (auto &item : m_value) {
+      if (!item.second.isPrimitive()) {
+        pending.push_back(std::move(item.second));
+      }
+    }
+    m_value.clear();
+  }
 };
 
 class ColumnCell : public TemplateCell<Cell::COLUMN, Cell::Column>
 {
 public:
   ColumnCell(const Cell::Column &value) : TemplateCell(value) { }
+  ColumnCell(Cell::Column &&value) : TemplateCell(std::move(value)) { }
+  ~ColumnCell() override
+  {
+    Cell::Column pending;
+    detach(pending);
+    release(pending);
+  }
   virtual const Cell::Column &columnValue() const override { return m_value; };
   virtual const Cell &operator[](const Cell::Index &index) const override { return m_value[index]; }
   virtual size_t size() const override { return m_value.size(); }
+  void detach(Cell::Column &pending) override
+  {
+    for (auto &item : m_value) {
+      if (!item.isPrimitive()) {
+        pending.push_back(std::move(item));
+      }
+    }
+    m_value.clear();
+  }
 };
 
 class TextCell : public TemplateCell<Cell::TEXT, Cell::Text>
 {
 public:
   TextCell(const Cell::Text &value) : TemplateCell(value) { }
+  TextCell(Cell::Text &&value) : TemplateCell(std::move(value)) { }
   virtual const Cell::Text &textValue() const override { return m_value; };
 };
 
@@ -47,6 +140,13 @@ public:
   virtual const Cell::Integer &integerValue() const override { return m_value; };
 };
 
+class BooleanCell : public IntegerCell
+{
+public:
+  BooleanCell(const bool value) : IntegerCell(value) { }
+  virtual bool isBoolean() const override { return true; }
+};
+
 class RealCell : public TemplateCell<Cell::REAL, Cell::Real>
 {
 public:
@@ -54,10 +154,18 @@ public:
   virtual const Cell::Real &realValue() const override { return m_value; };
 };
 
+class DateCell : public RealCell
+{
+public:
+  DateCell(const Cell::Real &value) : RealCell(value) { }
+  virtual bool isDate() const override { return true; }
+};
+
 class BlobCell : public TemplateCell<Cell::BLOB, Cell::Blob>
 {
 public:
   BlobCell(const Cell::Blob &value) : TemplateCell(value) { }
+  BlobCell(Cell::Blob &&value) : TemplateCell(std::move(value)) { }
   virtual const Cell::Blob &blobValue() const override { return m_value; };
 };
 
@@ -67,20 +175,112 @@ public:
   NullCell(const nullptr_t &value) : TemplateCell(value) { }
 };
 
+class LazyCell : public ValueCell
+{
+public:
+  LazyCell(const Cell::Type type, const std::function<Cell()> &loader) : m_type(type), m_loader(loader) { }
+
+protected:
+  Cell::Type type() const override { return m_type; }
+  size_t size() const override { return value().size(); }
+  bool isBoolean() const override { return value().isBoolean(); }
+  bool isDate() const override { return value().isDate(); }
+  size_t memoryUsage(std::vector<const Cell *> &pending) const override
+  {
+    if (m_loaded) {
+      pending.push_back(&m_value);
+    }
+    return CellControlBlockSize + sizeof(*this);
+  }
+
+  const Cell::Row &rowValue() const override { return value().rowValue(); }
+  const Cell::Column &columnValue() const override { return value().columnValue(); }
+  const Cell::Text &textValue() const override { return value().textValue(); }
+  const Cell::Integer &integerValue() const override { return value().integerValue(); }
+  const Cell::Real &realValue() const override { return value().realValue(); }
+  const Cell::Blob &blobValue() const override { return value().blobValue(); }
+
+  const Cell &operator[](const Cell::Index &index) const override { return value()[index]; }
+  const Cell &operator[](const Cell::Name &name) const override { return value()[name]; }
+
+private:
+  const Cell &value() const
+  {
+    std::call_once(m_once, [this] {
+      TRACE_SCOPE("Cell::lazy");
+      m_value = m_loader();
+      m_loader = nullptr;
+      m_loaded = true;
+    });
+    return m_value;
+  }
+
+  const Cell::Type m_type;
+  mutable std::function<Cell()> m_loader;
+  mutable std::once_flag m_once;
+  mutable Cell m_value;
+  mutable std::atomic<bool> m_loaded{false};
+};
+
 Cell::Cell(const Cell::Row &row) : m_ptr(make_shared<RowCell>(row)) { }
+Cell::Cell(Cell::Row &&row) : m_ptr(make_shared<RowCell>(std::move(row))) { }
 Cell::Cell(const Cell::Column &column) : m_ptr(make_shared<ColumnCell>(column)) { }
+Cell::Cell(Cell::Column &&column) : m_ptr(make_shared<ColumnCell>(std::move(column))) { }
 Cell::Cell(const Cell::Text &text) : m_ptr(make_shared<TextCell>(text)) { }
+Cell::Cell(Cell::Text &&text) : m_ptr(make_shared<TextCell>(std::move(text))) { }
 Cell::Cell(const Cell::Integer &integer) : m_ptr(make_shared<IntegerCell>(integer)) { }
 Cell::Cell(const Cell::Real &real) : m_ptr(make_shared<RealCell>(real)) { }
 Cell::Cell(const Cell::Blob &blob) : m_ptr(make_shared<BlobCell>(blob)) { }
+Cell::Cell(Cell::Blob &&blob) : m_ptr(make_shared<BlobCell>(std::move(blob))) { }
 Cell::Cell(const nullptr_t &null) : m_ptr(make_shared<NullCell>(null)) { }
 
+Cell Cell::boolean(const bool value)
+{
+  return std::shared_ptr<ValueCell>(make_shared<BooleanCell>(value));
+}
+
+Cell Cell::date(const Cell::Real value)
+{
+  return std::shared_ptr<ValueCell>(make_shared<DateCell>(value));
+}
+
+Cell Cell::lazy(const Cell::Type type, const std::function<Cell()> &loader)
+{
+  return std::shared_ptr<ValueCell>(make_shared<LazyCell>(type, loader));
+}
+
 Cell::Type Cell::type() const { return m_ptr->type(); }
 
 size_t Cell::size() const { return m_ptr->size(); }
 
+size_t Cell::memoryUsage() const
+{
+  std::vector<const Cell *> pending;
+  size_t usage = m_ptr->memoryUsage(pending);
+  while (!pending.empty()) {
+    const Cell *cell = pending.back();
+    pending.pop_back();
+    usage += cell->m_ptr->memoryUsage(pending);
+  }
+  return usage;
+}
+
+bool Cell::isBoolean() const { return m_ptr->isBoolean(); }
+bool Cell::isDate() const { return m_ptr->isDate(); }
+
 size_t ValueCell::size() const { return 1; }
 
+void ValueCell::release(Cell::Column &pending)
+{
+  while (!pending.empty()) {
+    Cell cell = std::move(pending.back());
+    pending.pop_back();
+    if (cell.m_ptr.use_count() == 1) {
+      cell.m_ptr->detach(pending);
+    }
+  }
+}
+
 const Cell::Row &ValueCell::rowValue() const
 {
   static const Cell::Row row;
@@ -138,64 +338,37 @@ const Cell::Blob &Cell::blobValue() const { return m_ptr->blobValue(); }
 const Cell &Cell::operator[](const Cell::Index &index) const {return (*m_ptr)[index];}
 const Cell &Cell::operator[](const Cell::Name &key) const {return (*m_ptr)[key];}
 
-Cell _parse(CFDictionaryRef dictionaryRef)
+/*
+ * UTF-8 of a CFString, transcoded straight into the result unless CF keeps it as UTF-8 already
+ */
+static Cell::Text CellGetText(CFStringRef stringRef)
 {
-  Cell::Row row;
-  CFIndex size = CFDictionaryGetCount(dictionaryRef);
-  CFStringRef keys[size];
-  CFTypeRef values[size];
-  CFDictionaryGetKeysAndValues(dictionaryRef, (const void **)keys, values);
-  for (CFIndex index = 0; index < size; index++) {
-    Cell::Name name;
-    const char *stringPtr = CFStringGetCStringPtr(keys[index], kCFStringEncodingUTF8);
-    if (stringPtr == NULL) {
-      CFIndex length = CFStringGetLength(keys[index]);
-      CFIndex maxSize = CFStringGetMaximumSizeForEncoding(length, kCFStringEncodingUTF8) + 1;
-      char buffer[maxSize];
-      if (CFStringGetCString(keys[index], buffer, maxSize, kCFStringEncodingUTF8)) {
-        name = buffer;
-      }
-    }
-    else {
-      name = stringPtr;
-    }
-    CFTypeRef value = values[index];
-    auto cell = Cell::parse(value);
-    row.insert({name, cell});
+  const char *stringPtr = CFStringGetCStringPtr(stringRef, kCFStringEncodingUTF8);
+  if (stringPtr != NULL) {
+    return stringPtr;
   }
-  return row;
-}
-
-Cell _parse(CFArrayRef arrayRef)
-{
-  Cell::Column column;
-  CFIndex count = CFArrayGetCount(arrayRef);
-  for (CFIndex index = 0; index < count; index++) {
-    CFTypeRef item = CFArrayGetValueAtIndex(arrayRef, index);
-    auto cell = Cell::parse(item);
-    column.push_back(cell);
+  Cell::Text text;
+  const CFIndex length = CFStringGetLength(stringRef);
+  const UniChar *characters = CFStringGetCharactersPtr(stringRef);
+  if (characters != NULL) {
+    Unicode::appendUtf16(text, characters, (size_t)length);
+    return text;
   }
-  return column;
+  CFIndex size = 0;
+  CFStringGetBytes(stringRef, CFRangeMake(0, length), kCFStringEncodingUTF8, 0, false, NULL, 0, &size);
+  text.resize((size_t)size);
+  CFStringGetBytes(stringRef, CFRangeMake(0, length), kCFStringEncodingUTF8, 0, false, (UInt8 *)&text[0], size, NULL);
+  return text;
 }
 
 Cell _parse(CFStringRef stringRef)
 {
-  const char *stringPtr = CFStringGetCStringPtr(stringRef, kCFStringEncodingUTF8);
-  if (stringPtr != NULL) {
-    return (Cell::Text)stringPtr;
-  }
-  CFIndex length = CFStringGetLength(stringRef);
-  CFIndex size = CFStringGetMaximumSizeForEncoding(length, kCFStringEncodingUTF8);
-  char buffer[size];
-  if (CFStringGetCString(stringRef, buffer, size, kCFStringEncodingUTF8)) {
-    return Cell::Text(buffer);
-  }
-  return Cell::Text();
+  return CellGetText(stringRef);
 }
 
 Cell _parse(CFBooleanRef boolanRef)
 {
-  return (Cell::Integer)(CFBooleanGetValue(boolanRef));
+  return Cell::boolean(CFBooleanGetValue(boolanRef));
 }
 
 Cell _parse(CFNumberRef numberRef)
@@ -212,44 +385,116 @@ Cell _parse(CFNumberRef numberRef)
 
 Cell _parse(CFDateRef dateRef)
 {
-  return CFDateGetAbsoluteTime(dateRef);
+  return Cell::date(CFDateGetAbsoluteTime(dateRef));
 }
 
 Cell _parse(CFDataRef dataRef)
 {
-  Cell::Blob blob;
   const UInt8 *buffer = CFDataGetBytePtr(dataRef);
   CFIndex length = CFDataGetLength(dataRef);
-  blob.assign(buffer, buffer + length);
-  return blob;
+  return Cell::Blob(buffer, buffer + length);
 }
 
-Cell Cell::parse(const CFTypeRef ref)
+/*
+ * dictionary or array being converted by Cell::parse, elements that are containers get a frame of their own on top of
+ * it, so the depth of a document is only limited by memory
+ */
+struct CellParseFrame
+{
+  std::vector<const void *> keys;
+  std::vector<const void *> values;
+  size_t index;
+  bool isRow;
+  Cell::Row row;
+  Cell::Column column;
+};
+
+/*
+ * converts a leaf of the document, containers get a frame of their own instead (the first `count` frames are in use,
+ * the rest keep their buffers for the next ones)
+ */
+static bool CellParseOpen(CFTypeRef ref, std::vector<CellParseFrame> &frames, size_t &count, Cell &cell)
 {
   if (ref == NULL) {
-    return nullptr;
+    cell = nullptr;
+    return false;
   }
   CFTypeID type = CFGetTypeID(ref);
-  if (type == CFDictionaryGetTypeID()) {
-    return _parse((CFDictionaryRef)ref);
-  }
-  if (type == CFArrayGetTypeID()) {
-    return _parse((CFArrayRef)ref);
+  if (type != CFDictionaryGetTypeID() && type != CFArrayGetTypeID()) {
+    if (type == CFStringGetTypeID()) {
+      cell = _parse((CFStringRef)ref);
+    }
+    else if (type == CFBooleanGetTypeID()) {
+      cell = _parse((CFBooleanRef)ref);
+    }
+    else if (type == CFNumberGetTypeID()) {
+      cell = _parse((CFNumberRef)ref);
+    }
+    else if (type == CFDateGetTypeID()) {
+      cell = _parse((CFDateRef)ref);
+    }
+    else if (type == CFDataGetTypeID()) {
+      cell = _parse((CFDataRef)ref);
+    }
+    else {
+      cell = nullptr;
+    }
+    return false;
   }
-  if (type == CFStringGetTypeID()) {
-    return _parse((CFStringRef)ref);
+
+  if (count == frames.size()) {
+    frames.emplace_back();
   }
-  if (type == CFBooleanGetTypeID()) {
-    return _parse((CFBooleanRef)ref);
+  CellParseFrame &frame = frames[count++];
+  frame.index = 0;
+  frame.isRow = type == CFDictionaryGetTypeID();
+  if (frame.isRow) {
+    const CFIndex size = CFDictionaryGetCount((CFDictionaryRef)ref);
+    frame.keys.resize((size_t)size);
+    frame.values.resize((size_t)size);
+    CFDictionaryGetKeysAndValues((CFDictionaryRef)ref, frame.keys.data(), frame.values.data());
   }
-  if (type == CFNumberGetTypeID()) {
-    return _parse((CFNumberRef)ref);
+  else {
+    const CFIndex size = CFArrayGetCount((CFArrayRef)ref);
+    frame.values.resize((size_t)size);
+    CFArrayGetValues((CFArrayRef)ref, CFRangeMake(0, size), frame.values.data());
+    frame.column.reserve((size_t)size);
   }
-  if (type == CFDateGetTypeID()) {
-    return _parse((CFDateRef)ref);
+  return true;
+}
+
+Cell Cell::parse(const CFTypeRef ref)
+{
+  TRACE_SCOPE("Cell::parse");
+  std::vector<CellParseFrame> frames;
+  size_t count = 0;
+  Cell cell;
+  if (!CellParseOpen(ref, frames, count, cell)) {
+    return cell;
   }
-  if (type == CFDataGetTypeID()) {
-    return _parse((CFDataRef)ref);
+  while (true) {
+    CellParseFrame &frame = frames[count - 1];
+    if (frame.index < frame.values.size()) {
+      if (CellParseOpen(frame.values[frame.index], frames, count, cell)) {
+        continue;
+      }
+    }
+    else {
+      cell = frame.isRow ? Cell(std::move(frame.row)) : Cell(std::move(frame.column));
+      frame.row.clear();
+      frame.column.clear();
+      if (--count == 0) {
+        return cell;
+      }
+    }
+
+    CellParseFrame &parent = frames[count - 1];
+    if (parent.isRow) {
+      parent.row.insert({CellGetText((CFStringRef)parent.keys[parent.index]), std::move(cell)});
+    }
+    else {
+      parent.column.push_back(std::move(cell));
+    }
+    parent.index++;
   }
-  return nullptr;
 }
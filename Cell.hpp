@@ -1,6 +1,8 @@
 #pragma once
 
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 #include <CoreFoundation/CoreFoundation.h>
@@ -26,11 +28,15 @@ public:
   typedef std::vector<uint8_t> Blob;
 
   Cell(const Row &);
+  Cell(Row &&);
   Cell(const Column &);
+  Cell(Column &&);
   Cell(const Text &);
+  Cell(Text &&);
   Cell(const Integer &);
   Cell(const Real &);
   Cell(const Blob &);
+  Cell(Blob &&);
 
   Cell(const std::nullptr_t &);
   Cell() : Cell(nullptr) {};
@@ -39,6 +45,12 @@ public:
 
   size_t size() const;
 
+  /*
+   * heap bytes owned by the cell and everything it contains, the handle itself is owned by its container
+   * shared subtrees are counted once per reference
+   */
+  size_t memoryUsage() const;
+
   bool isRow() const { return type() == ROW; }
   bool isColumn() const { return type() == COLUMN; }
   bool isText() const { return type() == TEXT; }
@@ -47,6 +59,12 @@ public:
   bool isBlob() const { return type() == BLOB; }
   bool isNull() const { return type() == NUL; }
 
+  /*
+   * booleans and dates are integers and reals as far as SQLite is concerned, the distinction is kept for writers
+   */
+  bool isBoolean() const;
+  bool isDate() const;
+
   bool isValid() const { return !isNull(); }
   bool isPrimitive() const { return type() != ROW && type() != COLUMN; };
 
@@ -62,7 +80,20 @@ public:
 
   static Cell parse(const CFTypeRef);
 
+  static Cell boolean(const bool);
+  static Cell date(const Real);
+
+  /*
+   * cell of a known type whose value is produced by `loader` on first access and cached
+   * `type()` and `memoryUsage()` don't trigger loading
+   */
+  static Cell lazy(const Type, const std::function<Cell()> &loader);
+
 private:
+  friend class ValueCell;
+
+  Cell(const std::shared_ptr<ValueCell> &ptr) : m_ptr(ptr) { }
+
   std::shared_ptr<ValueCell> m_ptr;
 };
 
@@ -75,6 +106,15 @@ protected:
 
   virtual size_t size() const;
 
+  /*
+   * bytes of the cell itself, containers add their elements to `pending` instead of counting them, so that
+   * Cell::memoryUsage walks a document of any depth in a loop
+   */
+  virtual size_t memoryUsage(std::vector<const Cell *> &pending) const = 0;
+
+  virtual bool isBoolean() const { return false; }
+  virtual bool isDate() const { return false; }
+
   virtual const Cell::Row &rowValue() const;
   virtual const Cell::Column &columnValue() const;
   virtual const Cell::Text &textValue() const;
@@ -85,5 +125,17 @@ protected:
   virtual const Cell &operator[](const Cell::Index &) const;
   virtual const Cell &operator[](const Cell::Name &) const;
 
+  /*
+   * moves the elements that are containers themselves to `pending` and drops the rest, called on cells nothing else
+   * refers to
+   */
+  virtual void detach(Cell::Column &) { }
+
+  /*
+   * frees `pending` and the containers below it one at a time, deep documents would otherwise take a destructor
+   * frame per level
+   */
+  static void release(Cell::Column &pending);
+
   virtual ~ValueCell() { }
 };
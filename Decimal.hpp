@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+class Decimal
+{
+public:
+  /*
+   * the whole of `data` as a double the way strtod reads it in the C locale, whatever the process' locale is
+   * correctly rounded, decimal notation is converted without allocating
+   */
+  static bool parse(const char *data, const size_t size, double &value);
+
+  /*
+   * shortest of 15 to 17 significant digits reading back as `value`, with a '.' whatever the process' locale is
+   */
+  static std::string format(const double value);
+};
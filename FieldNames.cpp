@@ -0,0 +1,54 @@
+#include <algorithm>
+#include <cctype>
+#include "FieldNames.hpp"
+
+static const size_t FieldNamesNone = (size_t)-1;
+
+FieldNames::FieldNames()
+{
+  getId("");
+  m_underscore = getId("_");
+}
+
+size_t FieldNames::getId(const std::string &name)
+{
+  auto it = m_ids.find(name);
+  if (it != m_ids.end()) {
+    return it->second;
+  }
+  m_names.push_back(name);
+  m_children.emplace_back();
+  m_elements.push_back(FieldNamesNone);
+  return m_ids.insert({name, m_names.size() - 1}).first->second;
+}
+
+size_t FieldNames::getChild(const size_t parent, const std::string &key)
+{
+  auto it = m_children[parent].find(key);
+  if (it != m_children[parent].end()) {
+    return it->second;
+  }
+  std::string suffix;
+  std::transform(key.begin(), key.end(), std::back_inserter(suffix), ::tolower);
+  const auto &prefix = m_names[parent];
+  const auto delimiter = prefix.empty() || suffix.empty() ? "" : ".";
+  const size_t id = getId(prefix.empty() && suffix.empty() ? "_" : prefix + delimiter + suffix);
+  // `getId` may have grown the vector
+  m_children[parent].insert({key, id});
+  return id;
+}
+
+size_t FieldNames::getElement(const size_t parent, const size_t level)
+{
+  if (parent == Root) {
+    return m_underscore;
+  }
+  if (level == 0) {
+    return parent;
+  }
+  if (m_elements[parent] == FieldNamesNone) {
+    const size_t id = getId(m_names[parent] + "._");
+    m_elements[parent] = id;
+  }
+  return m_elements[parent];
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * names of flattened fields by id, the name of a field below another is built (and its key lowercased) once per
+ * (parent, key) pair however many dictionaries hold the key, equal names share one id
+ * the root (id 0) is named "", values right at the root go to "_"
+ */
+class FieldNames
+{
+public:
+  static const size_t Root = 0;
+
+  FieldNames();
+
+  /*
+   * `parent + "." + key`, or just one of them if the other is empty
+   */
+  size_t getChild(const size_t parent, const std::string &key);
+
+  /*
+   * field of the elements of an array nested `level` arrays deep in `parent`: `parent` itself at the first level,
+   * `parent + "._"` below it
+   */
+  size_t getElement(const size_t parent, const size_t level);
+
+  /*
+   * field of a primitive value found at `parent`
+   */
+  size_t getValue(const size_t parent) const { return parent == Root ? m_underscore : parent; }
+
+  const std::string &getName(const size_t id) const { return m_names[id]; }
+
+private:
+  size_t getId(const std::string &name);
+
+  std::vector<std::string> m_names;
+  std::unordered_map<std::string, size_t> m_ids;
+  std::vector<std::unordered_map<std::string, size_t>> m_children;
+  std::vector<size_t> m_elements;
+  size_t m_underscore;
+};
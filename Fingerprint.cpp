@@ -0,0 +1,25 @@
+#include <sys/stat.h>
+#include "Fingerprint.hpp"
+
+bool Fingerprint::get(const std::string &path, Fingerprint &fingerprint)
+{
+  struct stat info;
+  if (stat(path.c_str(), &info) != 0) {
+    return false;
+  }
+  fingerprint.m_device = (uint64_t)info.st_dev;
+  fingerprint.m_inode = (uint64_t)info.st_ino;
+  fingerprint.m_size = (uint64_t)info.st_size;
+#ifdef __APPLE__
+  fingerprint.m_modified = (int64_t)info.st_mtimespec.tv_sec * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+  fingerprint.m_modified = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+  return true;
+}
+
+std::string Fingerprint::toString() const
+{
+  return std::to_string(m_device) + ":" + std::to_string(m_inode) + ":" + std::to_string(m_size) + ":" +
+         std::to_string(m_modified);
+}
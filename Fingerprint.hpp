@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/*
+ * identity of a file's contents as far as the file system can tell without reading it
+ * a rewrite through rename changes the inode, an in-place rewrite changes size and/or modification time
+ */
+class Fingerprint
+{
+public:
+  static bool get(const std::string &path, Fingerprint &);
+
+  bool isValid() const { return m_inode != 0 || m_modified != 0; }
+
+  bool operator==(const Fingerprint &other) const
+  {
+    return m_device == other.m_device && m_inode == other.m_inode && m_size == other.m_size && m_modified == other.m_modified;
+  }
+  bool operator!=(const Fingerprint &other) const { return !(*this == other); }
+
+  uint64_t getSize() const { return m_size; }
+
+  /*
+   * stable textual form, e.g. for persisting next to derived data
+   */
+  std::string toString() const;
+
+private:
+  uint64_t m_device = 0;
+  uint64_t m_inode = 0;
+  uint64_t m_size = 0;
+  int64_t m_modified = 0;
+};
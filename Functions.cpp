@@ -0,0 +1,289 @@
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "BinaryPlistReader.hpp"
+#include "BinaryPlistWriter.hpp"
+#include "Functions.hpp"
+#include "Plist.hpp"
+#include "PlistReader.hpp"
+#include "PlistTable.hpp"
+#include "XmlPlistWriter.hpp"
+
+#include <sqlite3ext.h>
+
+SQLITE_EXTENSION_INIT3
+
+#ifndef SQLITE_SUBTYPE
+#define SQLITE_SUBTYPE 0
+#endif
+#ifndef SQLITE_RESULT_SUBTYPE
+#define SQLITE_RESULT_SUBTYPE 0
+#endif
+
+enum
+{
+  FunctionsPlistSubtype = 'P',
+  FunctionsExtractCacheSize = 4,
+};
+
+enum FunctionsFormat
+{
+  FUNCTIONS_BINARY,
+  FUNCTIONS_XML,
+};
+
+static void FunctionsResult(sqlite3_context *context, const Cell &cell, const FunctionsFormat format)
+{
+  std::string bytes;
+  const bool isWritten = format == FUNCTIONS_XML ? XmlPlistWriter::write(cell, bytes) : BinaryPlistWriter::write(cell, bytes);
+  if (!isWritten) {
+    sqlite3_result_null(context);
+    return;
+  }
+  PlistToSQLiteResult(context, bytes);
+}
+
+static FunctionsFormat FunctionsGetFormat(sqlite3_context *context)
+{
+  return sqlite3_user_data(context) != NULL ? FUNCTIONS_XML : FUNCTIONS_BINARY;
+}
+
+Cell CellFromSQLiteValue(sqlite3_value *value)
+{
+  switch (sqlite3_value_type(value)) {
+    case SQLITE_INTEGER:
+      return (Cell::Integer)sqlite3_value_int64(value);
+    case SQLITE_FLOAT:
+      return (Cell::Real)sqlite3_value_double(value);
+    case SQLITE_TEXT: {
+      auto text = reinterpret_cast<const char *>(sqlite3_value_text(value));
+      const size_t size = (size_t)sqlite3_value_bytes(value);
+      if (sqlite3_value_subtype(value) == FunctionsPlistSubtype) {
+        return Plist::parse(text, size);
+      }
+      return Cell::Text(text, size);
+    }
+    case SQLITE_BLOB: {
+      auto blob = reinterpret_cast<const uint8_t *>(sqlite3_value_blob(value));
+      const size_t size = (size_t)sqlite3_value_bytes(value);
+      if (sqlite3_value_subtype(value) == FunctionsPlistSubtype) {
+        return Plist::parse(blob, size);
+      }
+      return Cell::Blob(blob, blob + size);
+    }
+    default:
+      return nullptr;
+  }
+}
+
+void CellToSQLiteResult(sqlite3_context *context, const Cell &cell)
+{
+  switch (cell.type()) {
+    case Cell::TEXT: {
+      auto &text = cell.textValue();
+      sqlite3_result_text64(context, text.data(), text.size(), SQLITE_TRANSIENT, SQLITE_UTF8);
+      break;
+    }
+    case Cell::INTEGER:
+      sqlite3_result_int64(context, cell.integerValue());
+      break;
+    case Cell::REAL:
+      sqlite3_result_double(context, cell.realValue());
+      break;
+    case Cell::BLOB: {
+      auto &blob = cell.blobValue();
+      sqlite3_result_blob64(context, blob.data(), blob.size(), SQLITE_TRANSIENT);
+      break;
+    }
+    case Cell::ROW:
+    case Cell::COLUMN:
+      FunctionsResult(context, cell, FUNCTIONS_BINARY);
+      break;
+    case Cell::NUL:
+      sqlite3_result_null(context);
+      break;
+  }
+}
+
+void PlistToSQLiteResult(sqlite3_context *context, const std::string &bytes)
+{
+  if (BinaryPlistReader::isBinaryPlist(bytes.data(), bytes.size())) {
+    sqlite3_result_blob64(context, bytes.data(), bytes.size(), SQLITE_TRANSIENT);
+  }
+  else {
+    sqlite3_result_text64(context, bytes.data(), bytes.size(), SQLITE_TRANSIENT, SQLITE_UTF8);
+  }
+  sqlite3_result_subtype(context, FunctionsPlistSubtype);
+}
+
+int CellToSQLiteParameter(sqlite3_stmt *statement, int index, const Cell &cell)
+{
+  switch (cell.type()) {
+    case Cell::TEXT: {
+      auto &text = cell.textValue();
+      return sqlite3_bind_text64(statement, index, text.data(), text.size(), SQLITE_TRANSIENT, SQLITE_UTF8);
+    }
+    case Cell::INTEGER:
+      return sqlite3_bind_int64(statement, index, cell.integerValue());
+    case Cell::REAL:
+      return sqlite3_bind_double(statement, index, cell.realValue());
+    case Cell::BLOB: {
+      auto &blob = cell.blobValue();
+      return sqlite3_bind_blob64(statement, index, blob.data(), blob.size(), SQLITE_TRANSIENT);
+    }
+    case Cell::ROW:
+    case Cell::COLUMN: {
+      std::string bytes;
+      BinaryPlistWriter::write(cell, bytes);
+      return sqlite3_bind_blob64(statement, index, bytes.data(), bytes.size(), SQLITE_TRANSIENT);
+    }
+    case Cell::NUL:
+      break;
+  }
+  return sqlite3_bind_null(statement, index);
+}
+
+static void plistGroupStep(sqlite3_context *context, int, sqlite3_value **argv)
+{
+  auto items = reinterpret_cast<Cell::Column **>(sqlite3_aggregate_context(context, sizeof(Cell::Column *)));
+  if (items == NULL) {
+    sqlite3_result_error_nomem(context);
+    return;
+  }
+  if (*items == NULL) {
+    *items = new Cell::Column();
+  }
+  // plists have no null, NULL values are left out
+  if (sqlite3_value_type(argv[0]) != SQLITE_NULL) {
+    (*items)->push_back(CellFromSQLiteValue(argv[0]));
+  }
+}
+
+static void plistGroupFinal(sqlite3_context *context)
+{
+  auto items = reinterpret_cast<Cell::Column **>(sqlite3_aggregate_context(context, 0));
+  if (items == NULL || *items == NULL) {
+    FunctionsResult(context, Cell::Column(), FunctionsGetFormat(context));
+    return;
+  }
+  FunctionsResult(context, **items, FunctionsGetFormat(context));
+  delete *items;
+  *items = NULL;
+}
+
+static void plistObject(sqlite3_context *context, int argc, sqlite3_value **argv)
+{
+  if (argc % 2 != 0) {
+    sqlite3_result_error(context, "plist_object() requires an even number of arguments", -1);
+    return;
+  }
+  Cell::Row row;
+  for (int index = 0; index < argc; index += 2) {
+    if (sqlite3_value_type(argv[index]) != SQLITE_TEXT) {
+      sqlite3_result_error(context, "plist_object() keys must be text", -1);
+      return;
+    }
+    auto key = reinterpret_cast<const char *>(sqlite3_value_text(argv[index]));
+    Cell value = CellFromSQLiteValue(argv[index + 1]);
+    if (value.isValid()) {
+      row[Cell::Text(key, (size_t)sqlite3_value_bytes(argv[index]))] = value;
+    }
+  }
+  FunctionsResult(context, row, FunctionsGetFormat(context));
+}
+
+/*
+ * readers of the most recently extracted from documents of a connection, so several plist_extract calls over the
+ * same value (e.g. different key paths of one column in a row, or a constant document) only copy and index it once
+ * entries are found by the address and size SQLite handed the value over with, the bytes are only compared to rule
+ * out a buffer reused for another value, the same document at another address is just a miss
+ */
+class FunctionsExtractCache
+{
+public:
+  std::shared_ptr<PlistReader> get(const void *data, const size_t size)
+  {
+    for (size_t index = 0; index < m_entries.size(); index++) {
+      auto &entry = m_entries[index];
+      const auto &buffer = entry.reader->getBuffer();
+      if (entry.data == data && buffer->size() == size && std::memcmp(buffer->data(), data, size) == 0) {
+        std::swap(m_entries[index], m_entries[0]);
+        return m_entries[0].reader;
+      }
+    }
+    auto reader = PlistReader::create(Buffer::copy(data, size));
+    if (reader == nullptr) {
+      return nullptr;
+    }
+    if (m_entries.size() == FunctionsExtractCacheSize) {
+      m_entries.pop_back();
+    }
+    m_entries.insert(m_entries.begin(), Entry{data, reader});
+    return reader;
+  }
+
+  static void destroy(void *cache) { delete reinterpret_cast<FunctionsExtractCache *>(cache); }
+
+private:
+  struct Entry
+  {
+    const void *data;
+    std::shared_ptr<PlistReader> reader;
+  };
+
+  std::vector<Entry> m_entries;
+};
+
+static void plistExtract(sqlite3_context *context, int, sqlite3_value **argv)
+{
+  const int type = sqlite3_value_type(argv[0]);
+  if ((type != SQLITE_BLOB && type != SQLITE_TEXT) || sqlite3_value_type(argv[1]) == SQLITE_NULL) {
+    sqlite3_result_null(context);
+    return;
+  }
+  const void *data = type == SQLITE_BLOB ? sqlite3_value_blob(argv[0]) : sqlite3_value_text(argv[0]);
+  const size_t size = (size_t)sqlite3_value_bytes(argv[0]);
+  const std::string keyPath(reinterpret_cast<const char *>(sqlite3_value_text(argv[1])), (size_t)sqlite3_value_bytes(argv[1]));
+
+  // functions of a connection never run concurrently, its cache needs no lock
+  auto cache = reinterpret_cast<FunctionsExtractCache *>(sqlite3_user_data(context));
+  auto reader = cache->get(data, size);
+  if (reader == nullptr || keyPath.find('@') != std::string::npos) {
+    // formats and collection operators only CoreFoundation knows about
+    CellToSQLiteResult(context, Plist::parse(data, size, keyPath));
+    return;
+  }
+  PlistReader::Node node;
+  if (!reader->findKeyPath(keyPath, node)) {
+    sqlite3_result_null(context);
+    return;
+  }
+  CellToSQLiteResult(context, reader->read(node, INT_MAX));
+}
+
+static void plistMemoryUsage(sqlite3_context *context, int, sqlite3_value **)
+{
+  sqlite3_result_int64(context, (sqlite3_int64)PlistTable::getTotalMemoryUsage());
+}
+
+int registerFunctions(sqlite3 *db)
+{
+  static int xml = FUNCTIONS_XML;
+  const int flags = SQLITE_UTF8 | SQLITE_SUBTYPE | SQLITE_RESULT_SUBTYPE;
+  int result = sqlite3_create_function(db, "plist_memory_usage", 0, SQLITE_UTF8, NULL, plistMemoryUsage, NULL, NULL);
+  for (int index = 0; index < 2 && result == SQLITE_OK; index++) {
+    void *format = index == 0 ? NULL : &xml;
+    result = sqlite3_create_function(db, index == 0 ? "plist_group" : "plist_group_xml", 1, flags, format, NULL,
+                                     plistGroupStep, plistGroupFinal);
+    if (result == SQLITE_OK) {
+      result = sqlite3_create_function(db, index == 0 ? "plist_object" : "plist_object_xml", -1,
+                                       flags | SQLITE_DETERMINISTIC, format, plistObject, NULL, NULL);
+    }
+  }
+  if (result == SQLITE_OK) {
+    result = sqlite3_create_function_v2(db, "plist_extract", 2, flags | SQLITE_DETERMINISTIC, new FunctionsExtractCache(),
+                                        plistExtract, NULL, NULL, FunctionsExtractCache::destroy);
+  }
+  return result;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <sqlite3.h>
+#include "Cell.hpp"
+
+/*
+ * SQL functions registered next to the module
+ *   plist_group(value), plist_group_xml(value): aggregate, array of the (non-NULL) values of the group
+ *   plist_object(key, value, ...), plist_object_xml(...): dictionary, NULL values are left out
+ *   plist_extract(plist, keyPath): value at a dot-separated key path of a bplist00 or XML blob (or text), NULL if
+ *     it's missing, bplist00 documents are navigated without decoding anything but the value
+ *   plist_memory_usage(): bytes held by all plist tables
+ * plain variants return bplist00 blobs, `_xml` ones XML text, both are tagged with a subtype so that passing one
+ * function's result to another nests the plist instead of embedding it as data or a string
+ */
+int registerFunctions(sqlite3 *db);
+
+/*
+ * conversions between SQLite values and cells, dictionaries and arrays are returned as bplist00 blobs
+ * serialized plists are returned as subtyped blobs (bplist00) or text (XML)
+ */
+Cell CellFromSQLiteValue(sqlite3_value *);
+void CellToSQLiteResult(sqlite3_context *, const Cell &);
+void PlistToSQLiteResult(sqlite3_context *, const std::string &bytes);
+int CellToSQLiteParameter(sqlite3_stmt *, int, const Cell &);
@@ -0,0 +1,317 @@
+#include <climits>
+#include "KeyedArchive.hpp"
+#include "PlistReader.hpp"
+#include "Trace.hpp"
+
+static const Cell &KeyedArchiveGet(const Cell &cell, const char *key)
+{
+  static const Cell null;
+  if (!cell.isRow()) {
+    return null;
+  }
+  auto it = cell.rowValue().find(key);
+  return it == cell.rowValue().end() ? null : it->second;
+}
+
+static bool KeyedArchiveGetUID(const Cell &cell, size_t &uid)
+{
+  if (!cell.isRow() || cell.size() != 1) {
+    return false;
+  }
+  const auto &value = KeyedArchiveGet(cell, "CF$UID");
+  if (!value.isInteger() || value.integerValue() < 0) {
+    return false;
+  }
+  uid = (size_t)value.integerValue();
+  return true;
+}
+
+/*
+ * `$classes` lists the class followed by its superclasses, so subclasses of Foundation collections decode too
+ */
+static bool KeyedArchiveIsKindOf(const Cell &classInfo, const char *name)
+{
+  const auto &classes = KeyedArchiveGet(classInfo, "$classes");
+  if (classes.isColumn()) {
+    for (auto &item : classes.columnValue()) {
+      if (item.isText() && item.textValue() == name) {
+        return true;
+      }
+    }
+    return false;
+  }
+  const auto &className = KeyedArchiveGet(classInfo, "$classname");
+  return className.isText() && className.textValue() == name;
+}
+
+bool KeyedArchive::isArchive(const Cell &cell)
+{
+  return KeyedArchiveGet(cell, "$objects").isColumn() && KeyedArchiveGet(cell, "$top").isRow();
+}
+
+Cell KeyedArchive::decode(const Cell &archive)
+{
+  TRACE_SCOPE("KeyedArchive::decode");
+  if (!isArchive(archive)) {
+    return nullptr;
+  }
+  KeyedArchive decoder(KeyedArchiveGet(archive, "$objects").columnValue());
+  const auto &top = KeyedArchiveGet(archive, "$top").rowValue();
+  if (top.size() == 1 && top.begin()->first == "root") {
+    return decoder.resolve(top.begin()->second);
+  }
+  return decoder.resolve(top);
+}
+
+Cell KeyedArchive::decode(const std::shared_ptr<const Buffer> &buffer)
+{
+  auto reader = PlistReader::create(buffer);
+  if (reader == nullptr) {
+    return nullptr;
+  }
+  return decode(reader->read(reader->getRoot(), INT_MAX));
+}
+
+KeyedArchive::KeyedArchive(const Cell::Column &objects)
+  : m_objects(objects), m_decoded(objects.size()), m_states(objects.size(), PENDING)
+{
+}
+
+Cell KeyedArchive::resolve(const Cell &value)
+{
+  /*
+   * objects reference each other through UIDs, a chain of them is as long as the archive, so the values still
+   * waiting for their children are kept on a stack rather than in nested calls
+   */
+  std::vector<Frame> frames;
+  Cell result;
+  if (!open(value, frames, result)) {
+    return result;
+  }
+  while (true) {
+    auto &frame = frames.back();
+    if (frame.results.size() < frame.children.size()) {
+      Cell child;
+      if (!open(*frame.children[frame.results.size()], frames, child)) {
+        frame.results.push_back(child);
+      }
+      continue;
+    }
+    if (!close(frame, result)) {
+      continue;
+    }
+    frames.pop_back();
+    if (frames.empty()) {
+      return result;
+    }
+    frames.back().results.push_back(result);
+  }
+}
+
+bool KeyedArchive::open(const Cell &value, std::vector<Frame> &frames, Cell &result)
+{
+  size_t uid;
+  if (KeyedArchiveGetUID(value, uid)) {
+    return openObject(uid, frames, result);
+  }
+  if (value.isColumn()) {
+    frames.push_back(Frame{COLUMN, m_objects.size(), &value, Cell(), {}, {}});
+    for (auto &item : value.columnValue()) {
+      frames.back().children.push_back(&item);
+    }
+    return true;
+  }
+  if (value.isRow()) {
+    frames.push_back(Frame{ROW, m_objects.size(), &value, Cell(), {}, {}});
+    for (auto &item : value.rowValue()) {
+      frames.back().children.push_back(&item.second);
+    }
+    return true;
+  }
+  result = value;
+  return false;
+}
+
+bool KeyedArchive::openObject(const size_t uid, std::vector<Frame> &frames, Cell &result)
+{
+  if (uid >= m_objects.size()) {
+    result = nullptr;
+    return false;
+  }
+  if (m_states[uid] == DECODED) {
+    result = m_decoded[uid];
+    return false;
+  }
+  if (m_states[uid] == DECODING) {
+    result = Cell::Row{{"CF$UID", (Cell::Integer)uid}};
+    return false;
+  }
+
+  m_states[uid] = DECODING;
+  const auto &object = m_objects[uid];
+  size_t classUID;
+  if (object.isText() && object.textValue() == "$null") {
+    result = nullptr;
+  }
+  else if (KeyedArchiveGetUID(KeyedArchiveGet(object, "$class"), classUID)) {
+    // the class is resolved first, it decides which fields the instance needs
+    frames.push_back(Frame{CLASS, uid, &object, Cell(), {}, {}});
+    frames.back().children.push_back(&KeyedArchiveGet(object, "$class"));
+    return true;
+  }
+  else if (open(object, frames, result)) {
+    frames.back().uid = uid;
+    return true;
+  }
+  m_decoded[uid] = result;
+  m_states[uid] = DECODED;
+  return false;
+}
+
+bool KeyedArchive::close(Frame &frame, Cell &result)
+{
+  switch (frame.kind) {
+    case COLUMN:
+    case NS_ARRAY:
+      result = Cell::Column(std::move(frame.results));
+      break;
+    case ROW: {
+      Cell::Row row;
+      size_t index = 0;
+      for (auto &item : frame.value->rowValue()) {
+        row.insert({item.first, std::move(frame.results[index++])});
+      }
+      result = std::move(row);
+      break;
+    }
+    case CLASS:
+      frame.classInfo = frame.results[0];
+      if (!plan(frame, NS_NULL, result)) {
+        return false;
+      }
+      break;
+    case NS_DICTIONARY: {
+      Cell::Row row;
+      for (size_t index = 0; index + 1 < frame.results.size(); index += 2) {
+        const auto &key = frame.results[index];
+        if (key.isText()) {
+          row.insert({key.textValue(), frame.results[index + 1]});
+        }
+        else if (key.isInteger()) {
+          row.insert({std::to_string(key.integerValue()), frame.results[index + 1]});
+        }
+      }
+      result = std::move(row);
+      break;
+    }
+    case NS_STRING: {
+      const auto &bytes = KeyedArchiveGet(*frame.value, "NS.bytes");
+      if (frame.results[0].isText()) {
+        result = frame.results[0];
+      }
+      else if (bytes.isBlob()) {
+        result = Cell::Text(bytes.blobValue().begin(), bytes.blobValue().end());
+      }
+      else if (!plan(frame, NS_DATA, result)) {
+        return false;
+      }
+      break;
+    }
+    case NS_DATA:
+      if (frame.results[0].isBlob()) {
+        result = frame.results[0];
+      }
+      else if (!plan(frame, NS_DATE, result)) {
+        return false;
+      }
+      break;
+    default: {
+      Cell::Row row;
+      size_t index = 0;
+      for (auto &item : frame.value->rowValue()) {
+        if (item.first == "$class") {
+          row.insert({item.first, KeyedArchiveGet(frame.classInfo, "$classname")});
+        }
+        else {
+          row.insert({item.first, std::move(frame.results[index++])});
+        }
+      }
+      result = std::move(row);
+      break;
+    }
+  }
+  if (frame.uid < m_objects.size()) {
+    m_decoded[frame.uid] = result;
+    m_states[frame.uid] = DECODED;
+  }
+  return true;
+}
+
+bool KeyedArchive::plan(Frame &frame, const Kind from, Cell &result) const
+{
+  /*
+   * picks how an instance decodes, starting at `from` so an instance whose fields don't fit its class (e.g. an
+   * NSString without a string) falls through to the next candidate and eventually to a plain dictionary
+   * returns false if the frame now waits for the fields it picked, true if `result` is already known
+   */
+  const auto &instance = *frame.value;
+  const auto &classInfo = frame.classInfo;
+  frame.children.clear();
+  frame.results.clear();
+  if (from <= NS_NULL && KeyedArchiveIsKindOf(classInfo, "NSNull")) {
+    result = nullptr;
+    return true;
+  }
+  if (from <= NS_DICTIONARY && KeyedArchiveIsKindOf(classInfo, "NSDictionary")) {
+    frame.kind = NS_DICTIONARY;
+    const auto &keys = KeyedArchiveGet(instance, "NS.keys");
+    const auto &values = KeyedArchiveGet(instance, "NS.objects");
+    if (keys.isColumn() && values.isColumn()) {
+      for (size_t index = 0; index < keys.size() && index < values.size(); index++) {
+        frame.children.push_back(&keys.columnValue()[index]);
+        frame.children.push_back(&values.columnValue()[index]);
+      }
+    }
+    return false;
+  }
+  if (from <= NS_ARRAY && (KeyedArchiveIsKindOf(classInfo, "NSArray") || KeyedArchiveIsKindOf(classInfo, "NSSet") ||
+                           KeyedArchiveIsKindOf(classInfo, "NSOrderedSet"))) {
+    frame.kind = NS_ARRAY;
+    const auto &values = KeyedArchiveGet(instance, "NS.objects");
+    if (values.isColumn()) {
+      for (auto &item : values.columnValue()) {
+        frame.children.push_back(&item);
+      }
+    }
+    return false;
+  }
+  if (from <= NS_STRING && KeyedArchiveIsKindOf(classInfo, "NSString")) {
+    frame.kind = NS_STRING;
+    frame.children.push_back(&KeyedArchiveGet(instance, "NS.string"));
+    return false;
+  }
+  if (from <= NS_DATA && KeyedArchiveIsKindOf(classInfo, "NSData")) {
+    frame.kind = NS_DATA;
+    frame.children.push_back(&KeyedArchiveGet(instance, "NS.data"));
+    return false;
+  }
+  if (from <= NS_DATE && KeyedArchiveIsKindOf(classInfo, "NSDate")) {
+    const auto &time = KeyedArchiveGet(instance, "NS.time");
+    if (time.isReal()) {
+      result = Cell::date(time.realValue());
+      return true;
+    }
+    if (time.isInteger()) {
+      result = Cell::date((Cell::Real)time.integerValue());
+      return true;
+    }
+  }
+
+  frame.kind = INSTANCE;
+  for (auto &item : instance.rowValue()) {
+    if (item.first != "$class") {
+      frame.children.push_back(&item.second);
+    }
+  }
+  return false;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "Buffer.hpp"
+#include "Cell.hpp"
+
+/*
+ * NSKeyedArchiver object graphs ($archiver, $objects, $top) resolved into the tree of objects they describe
+ * every object is decoded once and shared by all its references, a reference back to an object that is still being
+ * decoded (a cycle) is left as its {"CF$UID": n} dictionary
+ * Foundation collections, strings, data, dates and NSNull become the plist values they stand for, other objects
+ * become dictionaries of their resolved fields with "$class" replaced by the class name
+ */
+class KeyedArchive
+{
+public:
+  static bool isArchive(const Cell &);
+
+  /*
+   * `archive` resolved from "$top", its "root" object if that's the only entry, null if it isn't an archive
+   */
+  static Cell decode(const Cell &archive);
+
+  /*
+   * decodes with the native readers, CoreFoundation turns UIDs into objects Cell can't represent
+   */
+  static Cell decode(const std::shared_ptr<const Buffer> &);
+
+private:
+  KeyedArchive(const Cell::Column &objects);
+
+  enum State
+  {
+    PENDING, DECODING, DECODED
+  };
+
+  /*
+   * how a value waiting for its children is put together once they're resolved, the instance kinds are in the order
+   * they're tried
+   */
+  enum Kind
+  {
+    COLUMN, ROW, CLASS, NS_NULL, NS_DICTIONARY, NS_ARRAY, NS_STRING, NS_DATA, NS_DATE, INSTANCE
+  };
+
+  struct Frame
+  {
+    Kind kind;
+    size_t uid; // the object the value is decoded into, past the end of `m_objects` for nested values
+    const Cell *value;
+    Cell classInfo;
+    std::vector<const Cell *> children;
+    Cell::Column results;
+  };
+
+  Cell resolve(const Cell &);
+  bool open(const Cell &, std::vector<Frame> &, Cell &);
+  bool openObject(const size_t uid, std::vector<Frame> &, Cell &);
+  bool close(Frame &, Cell &);
+  bool plan(Frame &, const Kind from, Cell &) const;
+
+  const Cell::Column &m_objects;
+  std::vector<Cell> m_decoded;
+  std::vector<State> m_states;
+};
@@ -1,9 +1,17 @@
 #include <stddef.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
 #include <sstream>
 
 #include "Module.h"
+#include "Arguments.hpp"
+#include "Functions.hpp"
+#include "PlistEach.hpp"
 #include "PlistTable.hpp"
 #include "PlistCursor.hpp"
+#include "ShadowTable.hpp"
+#include "Trace.hpp"
 
 #include <sqlite3ext.h>
 #include <iostream>
@@ -14,34 +22,27 @@ template<typename... Args>
 static int ReportSQLiteError(char **pzErr, Args... args)
 {
   if (*pzErr != NULL) {
-    sqlite3_free(pzErr);
+    sqlite3_free(*pzErr);
   }
   *pzErr = sqlite3_mprintf(args...);
   return SQLITE_ERROR;
 }
 
-int xConnect(sqlite3 *db, void *, int argc, const char *const *argv, sqlite3_vtab **ppVTab, char **pzErr)
+/*
+ * columns are declared with the type shared by their values (see TypedColumn), so comparisons with them apply the
+ * matching affinity, columns mixing types are declared without one
+ */
+static int DeclareTable(sqlite3 *db, PlistTable *table, const std::vector<std::string> &fields,
+                        const std::vector<std::string> &types, sqlite3_vtab **ppVTab, char **pzErr)
 {
-  if (argc < 4) {
-    return ReportSQLiteError(pzErr, "Please provide plist file path");
-  }
-
-  PlistTable *table = new PlistTable();
-
-  int depth = argc > 4 ? atoi(argv[4]) : 0;
-  std::string keyPath = argc > 5 ? argv[5] : "";
-
-  if (!table->load(argv[3], depth, keyPath)) {
-    return ReportSQLiteError(pzErr, "Failed loading plist from '%s'", argv[3]);
-  }
-
-  auto &fields = table->getFields();
   std::stringstream schema;
   schema << "CREATE TABLE x(";
-  for (auto it = fields.begin(); it != fields.end(); ++it) {
-    if (it != fields.begin())
+  for (size_t index = 0; index < fields.size(); index++) {
+    if (index != 0)
       schema << ", ";
-    schema << "\"" << *it << "\"";
+    schema << "\"" << fields[index] << "\"";
+    if (index < types.size() && !types[index].empty())
+      schema << " " << types[index];
   }
   schema << ")";
   auto result = sqlite3_declare_vtab(db, schema.str().c_str());
@@ -54,6 +55,168 @@ int xConnect(sqlite3 *db, void *, int argc, const char *const *argv, sqlite3_vta
   return result;
 }
 
+static std::vector<std::string> DeclaredTypes(const PlistTable *table)
+{
+  std::vector<std::string> types;
+  for (auto type : table->getTypes()) {
+    types.push_back(TypedColumn::getDeclaredType(type));
+  }
+  return types;
+}
+
+static std::vector<std::string> SplitList(const std::string &list)
+{
+  std::vector<std::string> items;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+/*
+ * materialize=1 tables keep their rows in shadow tables (see ShadowTable), they're written by xCreate and refreshed
+ * by xFilter once the file changes, xConnect only reads their columns, `index=field[,field...]` creates indexes
+ */
+static int ConnectTable(sqlite3 *db, int argc, const char *const *argv, sqlite3_vtab **ppVTab, char **pzErr,
+                        const bool isCreate)
+{
+  Arguments arguments(argc - 3, argv + 3);
+  if (arguments.size() < 1) {
+    return ReportSQLiteError(pzErr, "Please provide plist file path");
+  }
+
+  // schemas can come from untrusted database files, the trace file is only taken from PLIST_TRACE
+  if (arguments.has("trace")) {
+    return ReportSQLiteError(pzErr, "The trace option is not supported, set PLIST_TRACE to record a trace");
+  }
+
+  PlistTable *table = new PlistTable();
+  table->setWritable(arguments.getBoolean("writable", false));
+  table->setNested(arguments.getBoolean("nested", false));
+  table->setArchive(arguments.getBoolean("archive", false));
+  // like the trace file, the cache directory is only taken from PLIST_CACHE_DIR, cache=1 without it puts the cache
+  // file next to the plist
+  std::string cache;
+  for (auto character : arguments.get("cache", "off")) {
+    cache.push_back((char)std::tolower((unsigned char)character));
+  }
+  if (arguments.getBoolean("cache", false)) {
+    const char *directory = std::getenv("PLIST_CACHE_DIR");
+    table->setCache(directory != NULL ? directory : "");
+  }
+  else if (cache != "0" && cache != "off" && cache != "no" && cache != "false") {
+    delete table;
+    return ReportSQLiteError(pzErr, "Invalid cache '%s', expected 1 or 0, set PLIST_CACHE_DIR to choose the directory",
+                             arguments.get("cache").c_str());
+  }
+  size_t memoryLimit = PlistTable::getDefaultMemoryLimit();
+  if (!arguments.getSize("memory_limit", memoryLimit)) {
+    delete table;
+    return ReportSQLiteError(pzErr, "Invalid memory_limit '%s', expected a byte count such as 4096, 512K, 64M or 2G",
+                             arguments.get("memory_limit").c_str());
+  }
+  table->setMemoryLimit(memoryLimit);
+  const auto reload = arguments.get("reload", "sync");
+  if (reload == "background") {
+    table->setReloadMode(PlistTable::RELOAD_BACKGROUND);
+  }
+  else if (reload == "sync") {
+    table->setReloadMode(PlistTable::RELOAD_SYNC);
+  }
+  else if (reload == "off" || reload == "0" || reload == "no") {
+    table->setReloadMode(PlistTable::RELOAD_OFF);
+  }
+  else {
+    delete table;
+    return ReportSQLiteError(pzErr, "Unknown reload mode '%s', expected 'background', 'sync' or 'off'", reload.c_str());
+  }
+
+  size_t sample = 0;
+  if (!arguments.getSize("sample", sample)) {
+    delete table;
+    return ReportSQLiteError(pzErr, "Invalid sample '%s', expected an element count", arguments.get("sample").c_str());
+  }
+  table->setSample(sample);
+  if (table->isWritable() && sample != 0) {
+    delete table;
+    return ReportSQLiteError(pzErr, "Sampled plist tables can't be writable");
+  }
+  // stream=1 tables re-read the file on every scan, there's nothing to reload
+  if (arguments.getBoolean("stream", false)) {
+    if (table->isWritable() || table->isArchive() || arguments.getBoolean("materialize", false)) {
+      delete table;
+      return ReportSQLiteError(pzErr, "Streamed plist tables can't be writable, archives or materialized");
+    }
+    table->setStreaming(true);
+    table->setReloadMode(PlistTable::RELOAD_OFF);
+  }
+
+  const auto &path = arguments[0];
+  int depth = atoi(arguments[1].c_str());
+  const auto &keyPath = arguments[2];
+
+  if (arguments.getBoolean("materialize", false)) {
+    if (table->isWritable()) {
+      delete table;
+      return ReportSQLiteError(pzErr, "Materialized plist tables can't be writable");
+    }
+    auto shadow = std::make_shared<ShadowTable>(db, argv[1], argv[2]);
+    table->setReloadMode(PlistTable::RELOAD_OFF);
+    table->setSource(path, depth, keyPath);
+    if (isCreate) {
+      // the key is taken first, a change while loading is picked up by the next scan
+      const auto sourceKey = table->getSourceKey();
+      if (!table->load(path, depth, keyPath)) {
+        const auto error = table->getError();
+        delete table;
+        return ReportSQLiteError(pzErr, "Failed loading plist from '%s'%s%s", path.c_str(), error.empty() ? "" : ": ",
+                                 error.c_str());
+      }
+      if (!table->loadRows()) {
+        const auto error = table->getError();
+        delete table;
+        return ReportSQLiteError(pzErr, "Failed loading plist from '%s': %s", path.c_str(), error.c_str());
+      }
+      if (!shadow->create(table->getFields(), DeclaredTypes(table), SplitList(arguments.get("index"))) || !shadow->store(*table, sourceKey)) {
+        delete table;
+        return ReportSQLiteError(pzErr, "Failed materializing plist from '%s': %s", path.c_str(), shadow->getError().c_str());
+      }
+      table->unload();
+    }
+    else if (!shadow->open()) {
+      delete table;
+      return ReportSQLiteError(pzErr, "Failed reading materialized rows of '%s': %s", argv[2], shadow->getError().c_str());
+    }
+    table->setShadow(shadow);
+    return DeclareTable(db, table, shadow->getColumns(), shadow->getTypes(), ppVTab, pzErr);
+  }
+
+  if (!table->load(path, depth, keyPath)) {
+    const auto error = table->getError();
+    delete table;
+    if (!error.empty()) {
+      return ReportSQLiteError(pzErr, "Failed loading plist from '%s': %s", path.c_str(), error.c_str());
+    }
+    return ReportSQLiteError(pzErr, "Failed loading plist from '%s'", path.c_str());
+  }
+
+  return DeclareTable(db, table, table->getFields(), DeclaredTypes(table), ppVTab, pzErr);
+}
+
+int xCreate(sqlite3 *db, void *, int argc, const char *const *argv, sqlite3_vtab **ppVTab, char **pzErr)
+{
+  return ConnectTable(db, argc, argv, ppVTab, pzErr, true);
+}
+
+int xConnect(sqlite3 *db, void *, int argc, const char *const *argv, sqlite3_vtab **ppVTab, char **pzErr)
+{
+  return ConnectTable(db, argc, argv, ppVTab, pzErr, false);
+}
+
 int xDisconnect(sqlite3_vtab *pVTab)
 {
   PlistTable *table = reinterpret_cast<PlistTable *>(pVTab);
@@ -79,22 +242,173 @@ int xClose(sqlite3_vtab_cursor *pCursor)
   return SQLITE_OK;
 }
 
-int xBestIndex(sqlite3_vtab *, sqlite3_index_info *)
+static int ReportTableError(PlistTable *table, int code)
+{
+  ReportSQLiteError(&table->getRef()->zErrMsg, "%s", table->getError().c_str());
+  return code;
+}
+
+int xDestroy(sqlite3_vtab *pVTab)
+{
+  PlistTable *table = reinterpret_cast<PlistTable *>(pVTab);
+  if (table->getShadow() != nullptr && !table->getShadow()->destroy()) {
+    return ReportSQLiteError(&pVTab->zErrMsg, "%s", table->getShadow()->getError().c_str());
+  }
+  return xDisconnect(pVTab);
+}
+
+static const char *ConstraintOperator(const unsigned char op, bool &hasArgument)
+{
+  hasArgument = true;
+  switch (op) {
+    case SQLITE_INDEX_CONSTRAINT_EQ: return "=";
+    case SQLITE_INDEX_CONSTRAINT_GT: return ">";
+    case SQLITE_INDEX_CONSTRAINT_LE: return "<=";
+    case SQLITE_INDEX_CONSTRAINT_LT: return "<";
+    case SQLITE_INDEX_CONSTRAINT_GE: return ">=";
+    case SQLITE_INDEX_CONSTRAINT_LIKE: return "LIKE";
+    case SQLITE_INDEX_CONSTRAINT_GLOB: return "GLOB";
+    case SQLITE_INDEX_CONSTRAINT_NE: return "<>";
+    case SQLITE_INDEX_CONSTRAINT_IS: return "IS";
+    case SQLITE_INDEX_CONSTRAINT_ISNOT: return "IS NOT";
+  }
+  hasArgument = false;
+  switch (op) {
+    case SQLITE_INDEX_CONSTRAINT_ISNULL: return "IS NULL";
+    case SQLITE_INDEX_CONSTRAINT_ISNOTNULL: return "IS NOT NULL";
+  }
+  return nullptr;
+}
+
+/*
+ * constraints compared with a collation other than BINARY can't be checked by comparing bytes
+ */
+static bool IsBinaryConstraint(sqlite3_index_info *info, const int index)
+{
+  const char *collation = sqlite3_vtab_collation(info, index);
+  return collation == NULL || sqlite3_stricmp(collation, "BINARY") == 0;
+}
+
+/*
+ * in-memory scans take one equality constraint on a dictionary encoded column (see PlistCursor::rewind), idxNum is
+ * the column plus one, or 0 for a full scan
+ */
+static int BestIndexMemory(PlistTable *table, sqlite3_index_info *info)
+{
+  const auto snapshot = table->getSnapshot();
+  // streamed rows and those of a sampled table still being flattened aren't in the snapshot
+  const double rows = (double)std::max<size_t>(std::max(snapshot->getHeight(), table->getElementCount()), 1);
+  info->estimatedCost = rows;
+  info->estimatedRows = (sqlite3_int64)rows;
+  for (int index = 0; index < info->nConstraint; index++) {
+    const auto &constraint = info->aConstraint[index];
+    const auto typed = constraint.iColumn >= 0 ? snapshot->getColumn((size_t)constraint.iColumn) : nullptr;
+    if (!constraint.usable || constraint.op != SQLITE_INDEX_CONSTRAINT_EQ || typed == nullptr || !typed->isEncoded() ||
+        !IsBinaryConstraint(info, index)) {
+      continue;
+    }
+    info->idxNum = constraint.iColumn + 1;
+    info->aConstraintUsage[index].argvIndex = 1;
+    // the codes are still scanned, but no row is produced for the others
+    info->estimatedCost = rows / 10;
+    info->estimatedRows = (sqlite3_int64)std::max(rows / 100, 1.0);
+    break;
+  }
+  return SQLITE_OK;
+}
+
+/*
+ * constraints on materialized tables become the WHERE clause of the query over the shadow table, so SQLite can use
+ * its indexes, they're still checked by SQLite (omit stays 0) as rows are only filtered, never transformed
+ */
+int xBestIndex(sqlite3_vtab *pVTab, sqlite3_index_info *info)
+{
+  PlistTable *table = reinterpret_cast<PlistTable *>(pVTab);
+  auto &shadow = table->getShadow();
+  if (shadow == nullptr) {
+    return BestIndexMemory(table, info);
+  }
+  std::string where;
+  int argument = 0;
+  double rows = 1000000;
+  for (int index = 0; index < info->nConstraint; index++) {
+    const auto &constraint = info->aConstraint[index];
+    bool hasArgument;
+    const char *op = ConstraintOperator(constraint.op, hasArgument);
+    if (!constraint.usable || op == nullptr || constraint.iColumn >= (int)shadow->getColumns().size() ||
+        !IsBinaryConstraint(info, index)) {
+      continue;
+    }
+    where += where.empty() ? "" : " AND ";
+    where += (constraint.iColumn < 0 ? std::string("rowid") : shadow->getColumnName(constraint.iColumn)) + " " + op;
+    if (hasArgument) {
+      where += " ?";
+      info->aConstraintUsage[index].argvIndex = ++argument;
+    }
+    rows /= constraint.op == SQLITE_INDEX_CONSTRAINT_EQ || constraint.op == SQLITE_INDEX_CONSTRAINT_IS ? 100 : 4;
+  }
+  if (!where.empty()) {
+    info->idxStr = sqlite3_mprintf("%s", where.c_str());
+    info->needToFreeIdxStr = 1;
+  }
+  info->estimatedCost = rows;
+  info->estimatedRows = (sqlite3_int64)rows;
+  return SQLITE_OK;
+}
+
+/*
+ * materialized rows are rebuilt once the file changed, if they can't be written (e.g. the database is read-only) or
+ * another scan is still reading them the scan falls back to the freshly loaded rows, the constraints are checked by
+ * SQLite either way
+ */
+static int FilterShadow(PlistTable *table, PlistCursor *cursor, const char *idxStr, int argc, sqlite3_value **argv)
 {
+  auto &shadow = table->getShadow();
+  // the cursor's own previous scan doesn't keep the rows from being replaced
+  cursor->reset();
+  const auto sourceKey = table->getSourceKey();
+  if (!sourceKey.empty() && sourceKey != shadow->getSourceKey()) {
+    // the rows keep the declared columns, also when the scan falls back to them
+    if (!table->load(shadow->getColumns())) {
+      return ReportTableError(table, SQLITE_ERROR);
+    }
+    if (shadow->isScanned() || !shadow->store(*table, sourceKey)) {
+      cursor->rewind();
+      return SQLITE_OK;
+    }
+    table->unload();
+  }
+  if (!cursor->rewind(shadow, idxStr != NULL ? idxStr : "", argc, argv)) {
+    return ReportSQLiteError(&table->getRef()->zErrMsg, "%s", sqlite3_errmsg(shadow->getDatabase()));
+  }
   return SQLITE_OK;
 }
 
-int xFilter(sqlite3_vtab_cursor *pCursor, int, const char *, int, sqlite3_value **)
+int xFilter(sqlite3_vtab_cursor *pCursor, int idxNum, const char *idxStr, int argc, sqlite3_value **argv)
 {
+  PlistTable *table = reinterpret_cast<PlistTable *>(pCursor->pVtab);
   PlistCursor *cursor = reinterpret_cast<PlistCursor *>(pCursor);
-  cursor->rewind();
+  if (table->getShadow() != nullptr) {
+    return FilterShadow(table, cursor, idxStr, argc, argv);
+  }
+  if (!table->refresh()) {
+    return ReportTableError(table, SQLITE_ERROR);
+  }
+  if (idxNum > 0 && argc > 0) {
+    cursor->rewind(idxNum - 1, argv[0]);
+  }
+  else if (!cursor->rewind()) {
+    return ReportSQLiteError(&table->getRef()->zErrMsg, "Failed streaming plist from '%s'", table->getPath().c_str());
+  }
   return SQLITE_OK;
 }
 
 int xNext(sqlite3_vtab_cursor *pCursor)
 {
   PlistCursor *cursor = reinterpret_cast<PlistCursor *>(pCursor);
-  cursor->next();
+  if (!cursor->next()) {
+    return ReportTableError(reinterpret_cast<PlistTable *>(pCursor->pVtab), SQLITE_ERROR);
+  }
   return SQLITE_OK;
 }
 
@@ -107,33 +421,7 @@ int xEof(sqlite3_vtab_cursor *pCursor)
 int xColumn(sqlite3_vtab_cursor *pCursor, sqlite3_context *sqlite3, int n)
 {
   PlistCursor *cursor = reinterpret_cast<PlistCursor *>(pCursor);
-  auto &cell = cursor->getCell(n);
-  switch (cell.type()) {
-    case Cell::TEXT: {
-      auto &text = cell.textValue();
-      size_t size = text.size();
-      char *buffer = (char *)malloc(size);
-      memcpy(buffer, text.c_str(), size);
-      sqlite3_result_text(sqlite3, buffer, (int)size, free);
-      break;
-    }
-    case Cell::INTEGER:
-      sqlite3_result_int64(sqlite3, cell.integerValue());
-      break;
-    case Cell::REAL:
-      sqlite3_result_double(sqlite3, cell.realValue());
-      break;
-    case Cell::BLOB: {
-      auto &blob = cell.blobValue();
-      size_t size = blob.size();
-      char *buffer = (char *)malloc(size);
-      memcpy(buffer, blob.data(), size);
-      sqlite3_result_blob(sqlite3, buffer, (int)size, free);
-      break;
-    }
-    default:
-      break;
-  }
+  cursor->result(sqlite3, n);
   return SQLITE_OK;
 }
 
@@ -144,29 +432,113 @@ int xRowid(sqlite3_vtab_cursor *pCursor, sqlite3_int64 *pRowid)
   return SQLITE_OK;
 }
 
-int xRename(sqlite3_vtab *, const char *)
+int xRename(sqlite3_vtab *pVTab, const char *zNew)
 {
+  PlistTable *table = reinterpret_cast<PlistTable *>(pVTab);
+  if (table->getShadow() != nullptr && !table->getShadow()->rename(zNew)) {
+    return ReportSQLiteError(&pVTab->zErrMsg, "%s", table->getShadow()->getError().c_str());
+  }
+  return SQLITE_OK;
+}
+
+/*
+ * "<name>_rows" and "<name>_source" (see ShadowTable) are only written by the module, with SQLITE_DBCONFIG_DEFENSIVE
+ * ordinary statements can't modify them
+ */
+int xShadowName(const char *suffix)
+{
+  return sqlite3_stricmp(suffix, "rows") == 0 || sqlite3_stricmp(suffix, "source") == 0;
+}
+
+int xUpdate(sqlite3_vtab *pVTab, int argc, sqlite3_value **argv, sqlite3_int64 *pRowid)
+{
+  PlistTable *table = reinterpret_cast<PlistTable *>(pVTab);
+  if (argc == 1) {
+    return table->remove(sqlite3_value_int64(argv[0])) ? SQLITE_OK : ReportTableError(table, SQLITE_ERROR);
+  }
+
+  std::vector<Cell> values;
+  values.reserve(argc - 2);
+  for (int index = 2; index < argc; index++) {
+    values.push_back(CellFromSQLiteValue(argv[index]));
+  }
+  if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+    int64_t rowid;
+    if (!table->insert(values, rowid)) {
+      return ReportTableError(table, SQLITE_ERROR);
+    }
+    *pRowid = rowid;
+    return SQLITE_OK;
+  }
+  if (sqlite3_value_int64(argv[0]) != sqlite3_value_int64(argv[1])) {
+    return ReportSQLiteError(&pVTab->zErrMsg, "rowids of plist tables can't be changed");
+  }
+  return table->update(sqlite3_value_int64(argv[0]), values) ? SQLITE_OK : ReportTableError(table, SQLITE_ERROR);
+}
+
+int xBegin(sqlite3_vtab *pVTab)
+{
+  PlistTable *table = reinterpret_cast<PlistTable *>(pVTab);
+  return table->begin() ? SQLITE_OK : ReportTableError(table, table->isWritable() ? SQLITE_ERROR : SQLITE_READONLY);
+}
+
+int xSync(sqlite3_vtab *pVTab)
+{
+  PlistTable *table = reinterpret_cast<PlistTable *>(pVTab);
+  return table->sync() ? SQLITE_OK : ReportTableError(table, SQLITE_IOERR);
+}
+
+int xCommit(sqlite3_vtab *pVTab)
+{
+  reinterpret_cast<PlistTable *>(pVTab)->commit();
+  return SQLITE_OK;
+}
+
+int xRollback(sqlite3_vtab *pVTab)
+{
+  reinterpret_cast<PlistTable *>(pVTab)->rollback();
   return SQLITE_OK;
 }
 
 int registerModule(sqlite3 *db, const char *name)
 {
+  Trace::startFromEnvironment();
+  int result = registerFunctions(db);
+  if (result == SQLITE_OK) {
+    result = registerEachModules(db);
+  }
+  if (result != SQLITE_OK) {
+    return result;
+  }
   static const struct sqlite3_module module
     {
-      .iVersion = 1,
-      .xCreate = xConnect,
+      .iVersion = 3,
+      .xCreate = xCreate,
       .xConnect = xConnect,
+      .xBestIndex = xBestIndex,
       .xDisconnect = xDisconnect,
-      .xDestroy = xDisconnect,
+      .xDestroy = xDestroy,
       .xOpen = xOpen,
       .xClose = xClose,
-      .xBestIndex = xBestIndex,
       .xFilter = xFilter,
       .xNext = xNext,
       .xEof = xEof,
       .xColumn = xColumn,
       .xRowid = xRowid,
+      .xUpdate = xUpdate,
+      .xBegin = xBegin,
+      .xSync = xSync,
+      .xCommit = xCommit,
+      .xRollback = xRollback,
+      .xFindFunction = NULL,
       .xRename = xRename,
+      .xSavepoint = NULL,
+      .xRelease = NULL,
+      .xRollbackTo = NULL,
+      .xShadowName = xShadowName,
+#if SQLITE_VERSION_NUMBER >= 3044000
+      .xIntegrity = NULL,
+#endif
     };
   return sqlite3_create_module(db, name, &module, NULL);
 }
@@ -1,13 +1,21 @@
 #pragma once
 
+#include "Buffer.hpp"
 #include "Cell.hpp"
 
 class Plist : public Cell
 {
 public:
-  static Plist parse(const std::string &path, const std::string &keyPath = "");
-  static Plist parse(const void *buffer, size_t size, const std::string &keyPath = "");
+  /*
+   * `depth` limits how many levels of containers are decoded (0 means unlimited), deeper containers are skipped by
+   * the native readers and only decoded if they are accessed
+   */
+  static Plist parse(const std::string &path, const std::string &keyPath = "", const int depth = 0);
+  static Plist parse(const void *buffer, size_t size, const std::string &keyPath = "", const int depth = 0);
   static Plist parse(CFPropertyListRef plist, const std::string &keyPath = "");
 
   Plist(const Cell &cell) : Cell(cell) { }
+
+private:
+  static Plist parse(const std::shared_ptr<const Buffer> &, const std::string &, const int);
 };
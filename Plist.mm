@@ -1,34 +1,8 @@
 #include "Plist.hpp"
-#include <cstdlib>
+#include "PlistReader.hpp"
+#include "Trace.hpp"
 #import <Foundation/Foundation.h>
 
-static CFPropertyListRef CFPropertyListCreateWithBuffer(const void *buffer, size_t size);
-
-static CFPropertyListRef CFPropertyListCreateWithFilePath(const char *path)
-{
-  FILE *file = std::fopen(path, "rb");
-  if (file == NULL) {
-    return NULL;
-  }
-  std::fseek(file, 0, SEEK_END);
-  size_t length = (size_t)std::ftell(file);
-  std::fseek(file, 0, SEEK_SET);
-
-  void *buffer = std::malloc(sizeof(uint8_t) * length);
-  if (buffer == NULL) {
-    return NULL;
-  }
-
-  if (std::fread(buffer, sizeof(uint8_t), length, file) != length) {
-    std::free(buffer);
-    return NULL;
-  }
-
-  CFPropertyListRef plist = CFPropertyListCreateWithBuffer(buffer, length);
-  std::free(buffer);
-  return plist;
-}
-
 static CFPropertyListRef CFPropertyListCreateWithBuffer(const void *buffer, size_t size)
 {
   CFDataRef data = CFDataCreateWithBytesNoCopy(NULL, (UInt8 *)buffer, size, kCFAllocatorNull);
@@ -42,9 +16,20 @@ static CFPropertyListRef CFPropertyListCreateWithBuffer(const void *buffer, size
   return plist;
 }
 
-Plist Plist::parse(const std::string &path, const std::string &keyPath)
+Plist Plist::parse(const std::string &path, const std::string &keyPath, const int depth)
+{
+  TRACE_SCOPE("Plist::parse(path)");
+  return parse(Buffer::fromFile(path), keyPath, depth);
+}
+
+Plist Plist::parse(const void *buffer, size_t size, const std::string &keyPath, const int depth)
 {
-  CFPropertyListRef plist = CFPropertyListCreateWithFilePath(path.c_str());
+  TRACE_SCOPE("Plist::parse(buffer)");
+  if (depth > 0) {
+    // lazily decoded subtrees outlive the caller's buffer
+    return parse(Buffer::copy(buffer, size), keyPath, depth);
+  }
+  CFPropertyListRef plist = CFPropertyListCreateWithBuffer(buffer, size);
   auto result = parse(plist, keyPath);
   if (plist != NULL) {
     CFRelease(plist);
@@ -52,9 +37,19 @@ Plist Plist::parse(const std::string &path, const std::string &keyPath)
   return result;
 }
 
-Plist Plist::parse(const void *buffer, size_t size, const std::string &keyPath)
+Plist Plist::parse(const std::shared_ptr<const Buffer> &buffer, const std::string &keyPath, const int depth)
 {
-  CFPropertyListRef plist = CFPropertyListCreateWithBuffer(buffer, size);
+  if (buffer == nullptr) {
+    return Cell();
+  }
+  if (depth > 0) {
+    auto reader = PlistReader::create(buffer);
+    PlistReader::Node node;
+    if (reader != nullptr && reader->findKeyPath(keyPath, node)) {
+      return reader->read(node, depth);
+    }
+  }
+  CFPropertyListRef plist = CFPropertyListCreateWithBuffer(buffer->data(), buffer->size());
   auto result = parse(plist, keyPath);
   if (plist != NULL) {
     CFRelease(plist);
@@ -64,6 +59,7 @@ Plist Plist::parse(const void *buffer, size_t size, const std::string &keyPath)
 
 Plist Plist::parse(CFPropertyListRef plist, const std::string &keyPath)
 {
+  TRACE_SCOPE("Plist::parse(CFPropertyList)");
   if (!keyPath.empty()) {
     @autoreleasepool {
       NSString *path = [NSString stringWithUTF8String:keyPath.c_str()];
@@ -1,27 +1,199 @@
+#include "Functions.hpp"
 #include "PlistCursor.hpp"
 #include "PlistTable.hpp"
+#include "Trace.hpp"
 
-void PlistCursor::rewind()
+#include <sqlite3ext.h>
+
+SQLITE_EXTENSION_INIT3
+
+bool PlistCursor::rewind()
 {
+  endScan();
+  finalize();
+  auto table = reinterpret_cast<PlistTable *>(m_cursor.pVtab);
+  m_snapshot = table->getSnapshot();
   m_row = 0;
+  m_filter = nullptr;
+  m_reader.reset();
+  m_position = 0;
+  m_rowOffset = 0;
+  if (Trace::isEnabled()) {
+    m_scanBegin = Trace::now();
+  }
+  if (table->isStreaming()) {
+    return table->openStream(m_reader, m_node) && stream();
+  }
+  return true;
+}
+
+bool PlistCursor::stream()
+{
+  // elements flattening to no rows are skipped, the rowids keep counting across elements
+  auto table = reinterpret_cast<PlistTable *>(m_cursor.pVtab);
+  while (m_reader != nullptr && m_row >= m_snapshot->getHeight()) {
+    std::shared_ptr<const PlistTable::Snapshot> rows;
+    if (!table->readStream(*m_reader, m_node, m_position, rows)) {
+      m_reader.reset();
+      return false;
+    }
+    if (rows == nullptr) {
+      m_reader.reset();
+      break;
+    }
+    m_rowOffset += (int64_t)m_snapshot->getHeight();
+    m_snapshot = rows;
+    m_row = 0;
+  }
+  return true;
 }
 
-void PlistCursor::next()
+void PlistCursor::rewind(const int column, sqlite3_value *value)
 {
-  m_row++;
+  rewind();
+  const auto typed = m_snapshot->getColumn((size_t)column);
+  if (typed == nullptr || !typed->isEncoded() || sqlite3_value_type(value) != SQLITE_TEXT) {
+    return;
+  }
+  const char *text = (const char *)sqlite3_value_text(value);
+  if (!typed->findCode(text, (size_t)sqlite3_value_bytes(value), m_code)) {
+    m_row = m_snapshot->getHeight();
+    return;
+  }
+  m_filter = typed;
+  seek();
+}
+
+void PlistCursor::seek()
+{
+  const size_t size = m_filter->size();
+  while (m_row < size && m_filter->getCode(m_row) != m_code) {
+    m_row++;
+  }
+  if (m_row >= size) {
+    m_row = m_snapshot->getHeight();
+  }
+}
+
+bool PlistCursor::rewind(const std::shared_ptr<ShadowTable> &shadow, const std::string &where, int argc,
+                         sqlite3_value **argv)
+{
+  endScan();
+  finalize();
+  m_row = 0;
+  m_filter = nullptr;
+  m_statement = shadow->select(where);
+  if (m_statement == nullptr) {
+    return false;
+  }
+  m_shadow = shadow;
+  m_shadow->beginScan();
+  for (int index = 0; index < argc; index++) {
+    sqlite3_bind_value(m_statement, index + 1, argv[index]);
+  }
+  if (Trace::isEnabled()) {
+    m_scanBegin = Trace::now();
+  }
+  const int result = sqlite3_step(m_statement);
+  m_isEof = result != SQLITE_ROW;
+  m_row = m_isEof ? 0 : 1;
+  return result == SQLITE_ROW || result == SQLITE_DONE;
+}
+
+bool PlistCursor::next()
+{
+  bool isRead = true;
+  if (m_statement != nullptr) {
+    m_isEof = sqlite3_step(m_statement) != SQLITE_ROW;
+    m_row += m_isEof ? 0 : 1;
+  }
+  else {
+    m_row++;
+    if (m_filter != nullptr) {
+      seek();
+    }
+    isRead = stream();
+  }
+  if (m_scanBegin != 0 && eof()) {
+    endScan();
+  }
+  return isRead;
 }
 
 bool PlistCursor::eof() const
 {
-  return m_row == reinterpret_cast<PlistTable *>(m_cursor.pVtab)->getHeight();
+  if (m_statement != nullptr) {
+    return m_isEof;
+  }
+  return m_row >= m_snapshot->getHeight();
+}
+
+int64_t PlistCursor::getRowId() const
+{
+  if (m_statement != nullptr) {
+    return sqlite3_column_int64(m_statement, 0);
+  }
+  return m_rowOffset + (int64_t)m_row;
+}
+
+void PlistCursor::result(sqlite3_context *context, const int column)
+{
+  if (m_statement != nullptr) {
+    sqlite3_result_value(context, sqlite3_column_value(m_statement, column + 1));
+    return;
+  }
+  const auto typed = m_snapshot->getColumn((size_t)column);
+  if (typed == nullptr) {
+    CellToSQLiteResult(context, m_snapshot->getCell(m_row, (size_t)column));
+    return;
+  }
+  // values of homogeneous columns go to SQLite straight from the dense storage, without a Cell in between
+  if (m_row >= typed->size() || typed->isNull(m_row)) {
+    sqlite3_result_null(context);
+    return;
+  }
+  size_t length;
+  switch (typed->getType()) {
+    case TypedColumn::INTEGER:
+    case TypedColumn::BOOLEAN:
+      sqlite3_result_int64(context, typed->getInteger(m_row));
+      break;
+    case TypedColumn::REAL:
+    case TypedColumn::DATE:
+      sqlite3_result_double(context, typed->getReal(m_row));
+      break;
+    case TypedColumn::TEXT: {
+      const char *bytes = typed->getBytes(m_row, length);
+      sqlite3_result_text64(context, bytes, length, SQLITE_TRANSIENT, SQLITE_UTF8);
+      break;
+    }
+    case TypedColumn::BLOB: {
+      const char *bytes = typed->getBytes(m_row, length);
+      sqlite3_result_blob64(context, bytes, length, SQLITE_TRANSIENT);
+      break;
+    }
+    default:
+      CellToSQLiteResult(context, typed->getMixed(m_row));
+      break;
+  }
 }
 
-int PlistCursor::getRowId() const
+void PlistCursor::endScan()
 {
-  return (int)m_row;
+  if (m_scanBegin != 0) {
+    Trace::complete("PlistCursor::scan", m_scanBegin, Trace::now(), "rows", m_rowOffset + (int64_t)m_row);
+    m_scanBegin = 0;
+  }
 }
 
-const Cell &PlistCursor::getCell(const int column)
+void PlistCursor::finalize()
 {
-  return reinterpret_cast<PlistTable *>(m_cursor.pVtab)->getCell((const int)m_row, column);
+  if (m_statement != nullptr) {
+    sqlite3_finalize(m_statement);
+    m_statement = nullptr;
+  }
+  if (m_shadow != nullptr) {
+    m_shadow->endScan();
+    m_shadow.reset();
+  }
 }
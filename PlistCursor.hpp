@@ -3,27 +3,77 @@
 #pragma once
 
 #include <sqlite3.h>
-#include "Cell.hpp"
+#include "PlistTable.hpp"
+#include "ShadowTable.hpp"
 
 class PlistCursor
 {
 public:
   PlistCursor(sqlite3_vtab *pVTab) { m_cursor.pVtab = pVTab; };
+  ~PlistCursor()
+  {
+    endScan();
+    finalize();
+  }
 
   sqlite3_vtab_cursor *getRef() { return &m_cursor; }
 
-  void rewind();
+  /*
+   * false if a streamed table's file can't be read (see PlistTable::setStreaming)
+   */
+  bool rewind();
 
-  void next();
+  /*
+   * scan of the rows whose `column` may equal `value`, only dictionary encoded columns skip rows (by comparing codes),
+   * the constraint is still checked by SQLite
+   */
+  void rewind(const int column, sqlite3_value *value);
+
+  /*
+   * scan of the materialized rows matching `where`, see ShadowTable::select
+   */
+  bool rewind(const std::shared_ptr<ShadowTable> &, const std::string &where, int argc, sqlite3_value **argv);
+
+  /*
+   * ends the current scan, releasing the materialized rows it was reading
+   */
+  void reset()
+  {
+    endScan();
+    finalize();
+  }
+
+  /*
+   * false if the next element of a streamed table can't be flattened
+   */
+  bool next();
 
   bool eof() const;
 
-  int getRowId() const;
+  int64_t getRowId() const;
 
-  const Cell &getCell(const int column);
+  void result(sqlite3_context *, const int column);
 
 private:
   sqlite3_vtab_cursor m_cursor;
 
+  std::shared_ptr<const PlistTable::Snapshot> m_snapshot;
   size_t m_row = 0;
+  const TypedColumn *m_filter = nullptr;
+  uint32_t m_code = 0;
+  void seek();
+
+  std::shared_ptr<PlistReader> m_reader;
+  PlistReader::Node m_node = 0;
+  size_t m_position = 0;
+  int64_t m_rowOffset = 0;
+  bool stream();
+
+  std::shared_ptr<ShadowTable> m_shadow;
+  sqlite3_stmt *m_statement = nullptr;
+  bool m_isEof = false;
+
+  uint64_t m_scanBegin = 0;
+  void endScan();
+  void finalize();
 };
@@ -0,0 +1,327 @@
+#include "BinaryPlistWriter.hpp"
+#include "Functions.hpp"
+#include "Plist.hpp"
+#include "PlistEach.hpp"
+
+#include <sqlite3ext.h>
+
+SQLITE_EXTENSION_INIT3
+
+enum
+{
+  PlistEachColumnKey,
+  PlistEachColumnValue,
+  PlistEachColumnType,
+  PlistEachColumnPath,
+  PlistEachColumnParent,
+  PlistEachColumnId,
+  PlistEachColumnPlist,
+  PlistEachColumnRoot,
+};
+
+static const char *PlistEachTypeName(const Cell::Type type, const Cell &value)
+{
+  switch (type) {
+    case Cell::ROW:
+      return "dict";
+    case Cell::COLUMN:
+      return "array";
+    case Cell::TEXT:
+      return "string";
+    case Cell::INTEGER:
+      return value.isBoolean() ? (value.integerValue() ? "true" : "false") : "integer";
+    case Cell::REAL:
+      return value.isDate() ? "date" : "real";
+    case Cell::BLOB:
+      return "data";
+    case Cell::NUL:
+      break;
+  }
+  return NULL;
+}
+
+bool PlistEachCursor::start(const void *data, const size_t size, const std::string &keyPath)
+{
+  m_frames.clear();
+  m_isEof = true;
+  m_nextId = 0;
+  if (data == NULL) {
+    return false;
+  }
+
+  auto buffer = Buffer::copy(data, size);
+  m_reader = PlistReader::create(buffer);
+  PlistReader::Node root;
+  if (m_reader == nullptr) {
+    // formats only CoreFoundation reads are converted once, only the value at the key path so that the rest of the
+    // document is never materialized, the walk itself is the same
+    std::string bytes;
+    if (!BinaryPlistWriter::write(Plist::parse(data, size, keyPath), bytes)) {
+      return false;
+    }
+    m_reader = PlistReader::create(Buffer::copy(bytes.data(), bytes.size()));
+    if (m_reader == nullptr) {
+      return false;
+    }
+    root = m_reader->getRoot();
+  }
+  else if (!m_reader->findKeyPath(keyPath, root)) {
+    return false;
+  }
+
+  const Cell::Type type = m_reader->getType(root);
+  m_path = keyPath;
+  m_hasKey = false;
+  m_parent = -1;
+  m_id = m_nextId++;
+  if (!m_isTree && (type == Cell::ROW || type == Cell::COLUMN)) {
+    // plist_each doesn't return the container itself
+    m_node = root;
+    m_type = type;
+    push(root, type);
+    next();
+    return true;
+  }
+  m_node = root;
+  m_type = type;
+  m_isEof = type == Cell::NUL;
+  return true;
+}
+
+bool PlistEachCursor::push(const PlistReader::Node node, const Cell::Type type)
+{
+  for (auto &frame : m_frames) {
+    // bplist objects can be referenced more than once, cycles are walked into once
+    if (frame.node == node) {
+      return false;
+    }
+  }
+  m_frames.push_back({node, type, 0, 0, m_id, m_path});
+  return true;
+}
+
+void PlistEachCursor::next()
+{
+  if (m_isTree && !m_isEof && (m_type == Cell::ROW || m_type == Cell::COLUMN)) {
+    push(m_node, m_type);
+  }
+  while (!m_frames.empty()) {
+    Frame &frame = m_frames.back();
+    PlistReader::Node item;
+    if (!m_reader->next(frame.node, frame.position, item, m_key)) {
+      m_frames.pop_back();
+      continue;
+    }
+    m_node = item;
+    m_type = m_reader->getType(item);
+    m_hasKey = true;
+    m_isIndex = frame.type == Cell::COLUMN;
+    m_index = frame.index++;
+    m_path = frame.path + (frame.path.empty() ? "" : ".") + (m_isIndex ? std::to_string(m_index) : m_key);
+    m_parent = frame.id;
+    m_id = m_nextId++;
+    m_isEof = false;
+    return;
+  }
+  m_isEof = true;
+}
+
+void PlistEachCursor::getColumn(sqlite3_context *context, const int column) const
+{
+  switch (column) {
+    case PlistEachColumnKey:
+      if (!m_hasKey) {
+        sqlite3_result_null(context);
+      }
+      else if (m_isIndex) {
+        sqlite3_result_int64(context, (sqlite3_int64)m_index);
+      }
+      else {
+        sqlite3_result_text64(context, m_key.data(), m_key.size(), SQLITE_TRANSIENT, SQLITE_UTF8);
+      }
+      break;
+    case PlistEachColumnValue:
+      if (m_type == Cell::ROW || m_type == Cell::COLUMN) {
+        // containers are copied out of the source as a document of its format, nothing is decoded
+        std::string bytes;
+        if (m_reader->slice(m_node, bytes)) {
+          PlistToSQLiteResult(context, bytes);
+        }
+      }
+      else {
+        CellToSQLiteResult(context, m_reader->read(m_node, 0));
+      }
+      break;
+    case PlistEachColumnType: {
+      const bool isContainer = m_type == Cell::ROW || m_type == Cell::COLUMN;
+      const char *name = PlistEachTypeName(m_type, isContainer ? Cell() : m_reader->read(m_node, 0));
+      if (name != NULL) {
+        sqlite3_result_text(context, name, -1, SQLITE_STATIC);
+      }
+      break;
+    }
+    case PlistEachColumnPath:
+      sqlite3_result_text64(context, m_path.data(), m_path.size(), SQLITE_TRANSIENT, SQLITE_UTF8);
+      break;
+    case PlistEachColumnParent:
+      if (m_parent >= 0) {
+        sqlite3_result_int64(context, m_parent);
+      }
+      break;
+    case PlistEachColumnId:
+      sqlite3_result_int64(context, m_id);
+      break;
+    default:
+      break;
+  }
+}
+
+struct PlistEachTable
+{
+  sqlite3_vtab vtab;
+  bool isTree;
+};
+
+static int PlistEachConnect(sqlite3 *db, void *pAux, int, const char *const *, sqlite3_vtab **ppVTab, char **)
+{
+  int result = sqlite3_declare_vtab(db, "CREATE TABLE x(key, value, type, path, parent, id, plist HIDDEN, root HIDDEN)");
+  if (result != SQLITE_OK) {
+    return result;
+  }
+  // the module's client data tells plist_tree from plist_each
+  PlistEachTable *table = new PlistEachTable();
+  table->isTree = pAux != NULL;
+  *ppVTab = &table->vtab;
+  return SQLITE_OK;
+}
+
+static int PlistEachDisconnect(sqlite3_vtab *pVTab)
+{
+  delete reinterpret_cast<PlistEachTable *>(pVTab);
+  return SQLITE_OK;
+}
+
+static int PlistEachBestIndex(sqlite3_vtab *, sqlite3_index_info *info)
+{
+  int plist = -1, root = -1;
+  for (int index = 0; index < info->nConstraint; index++) {
+    const auto &constraint = info->aConstraint[index];
+    if (constraint.op != SQLITE_INDEX_CONSTRAINT_EQ ||
+        (constraint.iColumn != PlistEachColumnPlist && constraint.iColumn != PlistEachColumnRoot)) {
+      continue;
+    }
+    if (!constraint.usable) {
+      return SQLITE_CONSTRAINT;
+    }
+    (constraint.iColumn == PlistEachColumnPlist ? plist : root) = index;
+  }
+  if (plist < 0) {
+    // without a document there is nothing to walk, the plan is only chosen if there is no other
+    info->idxNum = 0;
+    info->estimatedCost = 1e99;
+    return SQLITE_OK;
+  }
+  info->aConstraintUsage[plist].argvIndex = 1;
+  info->aConstraintUsage[plist].omit = 1;
+  if (root >= 0) {
+    info->aConstraintUsage[root].argvIndex = 2;
+    info->aConstraintUsage[root].omit = 1;
+  }
+  info->idxNum = root >= 0 ? 2 : 1;
+  info->estimatedCost = 100.0;
+  return SQLITE_OK;
+}
+
+static int PlistEachOpen(sqlite3_vtab *pVTab, sqlite3_vtab_cursor **ppCursor)
+{
+  auto cursor = new PlistEachCursor(pVTab, reinterpret_cast<PlistEachTable *>(pVTab)->isTree);
+  *ppCursor = cursor->getRef();
+  return SQLITE_OK;
+}
+
+static int PlistEachClose(sqlite3_vtab_cursor *pCursor)
+{
+  delete reinterpret_cast<PlistEachCursor *>(pCursor);
+  return SQLITE_OK;
+}
+
+static int PlistEachFilter(sqlite3_vtab_cursor *pCursor, int idxNum, const char *, int argc, sqlite3_value **argv)
+{
+  PlistEachCursor *cursor = reinterpret_cast<PlistEachCursor *>(pCursor);
+  const int type = idxNum > 0 && argc > 0 ? sqlite3_value_type(argv[0]) : SQLITE_NULL;
+  if (type != SQLITE_BLOB && type != SQLITE_TEXT) {
+    cursor->start(NULL, 0, "");
+    return SQLITE_OK;
+  }
+  const void *data = type == SQLITE_BLOB ? sqlite3_value_blob(argv[0]) : sqlite3_value_text(argv[0]);
+  const size_t size = (size_t)sqlite3_value_bytes(argv[0]);
+  std::string keyPath;
+  if (idxNum == 2 && argc > 1 && sqlite3_value_type(argv[1]) != SQLITE_NULL) {
+    keyPath.assign(reinterpret_cast<const char *>(sqlite3_value_text(argv[1])), (size_t)sqlite3_value_bytes(argv[1]));
+  }
+  cursor->start(data, size, keyPath);
+  return SQLITE_OK;
+}
+
+static int PlistEachNext(sqlite3_vtab_cursor *pCursor)
+{
+  reinterpret_cast<PlistEachCursor *>(pCursor)->next();
+  return SQLITE_OK;
+}
+
+static int PlistEachEof(sqlite3_vtab_cursor *pCursor)
+{
+  return reinterpret_cast<PlistEachCursor *>(pCursor)->eof();
+}
+
+static int PlistEachColumn(sqlite3_vtab_cursor *pCursor, sqlite3_context *context, int column)
+{
+  reinterpret_cast<PlistEachCursor *>(pCursor)->getColumn(context, column);
+  return SQLITE_OK;
+}
+
+static int PlistEachRowid(sqlite3_vtab_cursor *pCursor, sqlite3_int64 *pRowid)
+{
+  *pRowid = reinterpret_cast<PlistEachCursor *>(pCursor)->getRowId();
+  return SQLITE_OK;
+}
+
+int registerEachModules(sqlite3 *db)
+{
+  static const struct sqlite3_module module
+    {
+      .iVersion = 1,
+      .xCreate = NULL,
+      .xConnect = PlistEachConnect,
+      .xBestIndex = PlistEachBestIndex,
+      .xDisconnect = PlistEachDisconnect,
+      .xDestroy = PlistEachDisconnect,
+      .xOpen = PlistEachOpen,
+      .xClose = PlistEachClose,
+      .xFilter = PlistEachFilter,
+      .xNext = PlistEachNext,
+      .xEof = PlistEachEof,
+      .xColumn = PlistEachColumn,
+      .xRowid = PlistEachRowid,
+      .xUpdate = NULL,
+      .xBegin = NULL,
+      .xSync = NULL,
+      .xCommit = NULL,
+      .xRollback = NULL,
+      .xFindFunction = NULL,
+      .xRename = NULL,
+      .xSavepoint = NULL,
+      .xRelease = NULL,
+      .xRollbackTo = NULL,
+      .xShadowName = NULL,
+#if SQLITE_VERSION_NUMBER >= 3044000
+      .xIntegrity = NULL,
+#endif
+    };
+  static int tree;
+  int result = sqlite3_create_module(db, "plist_each", &module, NULL);
+  if (result == SQLITE_OK) {
+    result = sqlite3_create_module(db, "plist_tree", &module, &tree);
+  }
+  return result;
+}
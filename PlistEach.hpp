@@ -0,0 +1,66 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <sqlite3.h>
+#include "PlistReader.hpp"
+
+/*
+ * plist_each(plist [, keyPath]) and plist_tree(plist [, keyPath]) table-valued functions, the json_each/json_tree
+ * equivalents for plists stored in BLOB (or TEXT) columns
+ * plist_each returns the items of the container at keyPath (or the value itself if it's not a container),
+ * plist_tree walks the whole subtree depth-first starting with the value at keyPath
+ * columns: key (dictionary key or array index), value, type (element name: dict, array, string, integer, real,
+ * true, false, date, data), path, parent (id of the containing row) and id (position in the walk)
+ * the walk is driven by the native reader over the serialized document, only the current path is kept in memory
+ * dictionary and array values are slices of the source (bplist00 blobs or XML text, tagged like the plist_*
+ * functions' results), copied without being decoded
+ */
+int registerEachModules(sqlite3 *db);
+
+class PlistEachCursor
+{
+public:
+  PlistEachCursor(sqlite3_vtab *pVTab, const bool isTree) : m_isTree(isTree) { m_cursor.pVtab = pVTab; }
+
+  sqlite3_vtab_cursor *getRef() { return &m_cursor; }
+
+  bool start(const void *, const size_t, const std::string &keyPath);
+  void next();
+  bool eof() const { return m_isEof; }
+
+  void getColumn(sqlite3_context *, const int) const;
+  int64_t getRowId() const { return m_id; }
+
+private:
+  sqlite3_vtab_cursor m_cursor;
+
+  struct Frame
+  {
+    PlistReader::Node node;
+    Cell::Type type;
+    size_t position;
+    size_t index;
+    int64_t id;
+    std::string path;
+  };
+
+  bool push(const PlistReader::Node, const Cell::Type);
+
+  const bool m_isTree;
+  std::shared_ptr<PlistReader> m_reader;
+  std::vector<Frame> m_frames;
+  bool m_isEof = true;
+
+  PlistReader::Node m_node = 0;
+  Cell::Type m_type = Cell::NUL;
+  std::string m_key;
+  bool m_hasKey = false;
+  bool m_isIndex = false;
+  size_t m_index = 0;
+  std::string m_path;
+  int64_t m_parent = -1;
+  int64_t m_id = 0;
+  int64_t m_nextId = 0;
+};
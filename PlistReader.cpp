@@ -0,0 +1,72 @@
+#include <climits>
+#include <cstring>
+#include "PlistReader.hpp"
+#include "BinaryPlistReader.hpp"
+#include "XmlPlistReader.hpp"
+
+std::shared_ptr<PlistReader> PlistReader::create(const std::shared_ptr<const Buffer> &buffer)
+{
+  if (buffer == nullptr) {
+    return nullptr;
+  }
+  if (BinaryPlistReader::isBinaryPlist(buffer->data(), buffer->size())) {
+    return BinaryPlistReader::create(buffer);
+  }
+  return XmlPlistReader::create(buffer);
+}
+
+static bool PlistReaderHasXmlHeader(const uint8_t *data, const size_t size)
+{
+  size_t offset = size >= 3 && std::memcmp(data, "\xEF\xBB\xBF", 3) == 0 ? 3 : 0;
+  while (offset < size && (data[offset] == ' ' || data[offset] == '\t' || data[offset] == '\r' || data[offset] == '\n')) {
+    offset++;
+  }
+  static const char *prefixes[] = {"<?xml", "<!DOCTYPE plist", "<plist"};
+  for (auto prefix : prefixes) {
+    const size_t length = std::strlen(prefix);
+    if (size - offset >= length && std::memcmp(data + offset, prefix, length) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Cell PlistReader::embedded(const Cell &blob)
+{
+  if (!blob.isBlob()) {
+    return nullptr;
+  }
+  const auto &bytes = blob.blobValue();
+  if (!BinaryPlistReader::isBinaryPlist(bytes.data(), bytes.size()) && !PlistReaderHasXmlHeader(bytes.data(), bytes.size())) {
+    return nullptr;
+  }
+  auto reader = create(Buffer::wrap(bytes.data(), bytes.size(), std::make_shared<Cell>(blob)));
+  if (reader == nullptr) {
+    return nullptr;
+  }
+  return reader->read(reader->getRoot(), 0);
+}
+
+bool PlistReader::findKeyPath(const std::string &keyPath, Node &node) const
+{
+  node = getRoot();
+  size_t begin = 0;
+  while (begin <= keyPath.size() && !keyPath.empty()) {
+    size_t end = keyPath.find('.', begin);
+    if (end == std::string::npos) {
+      end = keyPath.size();
+    }
+    const auto key = keyPath.substr(begin, end - begin);
+    if (key.empty() || key[0] == '@' || !find(node, key, node)) {
+      return false;
+    }
+    begin = end + 1;
+  }
+  return true;
+}
+
+Cell PlistReader::lazy(const Node node, const Cell::Type type) const
+{
+  auto reader = shared_from_this();
+  return Cell::lazy(type, [reader, node] { return reader->read(node, INT_MAX); });
+}
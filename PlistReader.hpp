@@ -0,0 +1,75 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include "Buffer.hpp"
+#include "Cell.hpp"
+
+/*
+ * native, CoreFoundation-free plist reader working directly on the serialized bytes
+ * nodes are opaque positions in the buffer (object references for bplist, element offsets for XML), so the reader
+ * can navigate to a key path and decode only the part of the document that is actually needed
+ */
+class PlistReader : public std::enable_shared_from_this<PlistReader>
+{
+public:
+  typedef size_t Node;
+
+  /*
+   * returns nullptr if the buffer is neither a bplist00 nor an XML plist, or if its framing is broken
+   */
+  static std::shared_ptr<PlistReader> create(const std::shared_ptr<const Buffer> &);
+
+  /*
+   * plist embedded in a data cell (nested bplists, NSKeyedArchiver payloads, XML plists), recognized by its header
+   * containers come back as lazy cells decoding the blob in place on first access, null if `blob` isn't a plist
+   */
+  static Cell embedded(const Cell &blob);
+
+  virtual ~PlistReader() { }
+
+  virtual Node getRoot() const = 0;
+  virtual Cell::Type getType(const Node) const = 0;
+
+  /*
+   * dictionary lookup, returns false if `node` is not a dictionary or has no such key
+   */
+  virtual bool find(const Node, const std::string &key, Node &) const = 0;
+
+  /*
+   * iteration over the items of a container without decoding them, `position` starts at 0 and is advanced by every
+   * call, returns false past the last item or if the container is malformed, `key` is only set for dictionary items
+   */
+  virtual bool next(const Node, size_t &position, Node &item, std::string &key) const = 0;
+
+  /*
+   * decodes `node`, expanding at most `depth` levels of containers
+   * containers below that level become lazy cells that are decoded on first access
+   * returns a null cell if the node is malformed
+   */
+  virtual Cell read(const Node, const int depth) const = 0;
+
+  /*
+   * standalone document of the reader's own format holding only `node`, copied from the source without decoding it
+   * (objects reachable from the node for bplist, the element for XML), returns false if the node is malformed
+   */
+  virtual bool slice(const Node, std::string &bytes) const = 0;
+
+  /*
+   * dot-separated key path relative to the root, only dictionaries can be traversed
+   * returns false if a key is missing or the path goes through anything else (e.g. arrays or collection operators)
+   */
+  bool findKeyPath(const std::string &keyPath, Node &) const;
+
+  const std::shared_ptr<const Buffer> &getBuffer() const { return m_buffer; }
+
+protected:
+  PlistReader(const std::shared_ptr<const Buffer> &buffer) : m_buffer(buffer) { }
+
+  /*
+   * cell that re-enters the reader for `node` on first access, keeping the reader (and its buffer) alive
+   */
+  Cell lazy(const Node, const Cell::Type) const;
+
+  std::shared_ptr<const Buffer> m_buffer;
+};
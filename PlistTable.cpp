@@ -1,80 +1,1372 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
 #include <numeric>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+#include "Arguments.hpp"
+#include "BinaryPlistReader.hpp"
+#include "BinaryPlistWriter.hpp"
+#include "KeyedArchive.hpp"
+#include "PlistReader.hpp"
 #include "PlistTable.hpp"
+#include "Trace.hpp"
+#include "XmlPlistWriter.hpp"
+
+static size_t PlistTableEnvironmentSize(const char *name)
+{
+  // unset or not a size: no limit
+  const char *value = std::getenv(name);
+  size_t size = 0;
+  return value != NULL && Arguments::parseSize(value, size) ? size : 0;
+}
+
+static std::atomic<size_t> &PlistTableDefaultMemoryLimit()
+{
+  static std::atomic<size_t> limit{PlistTableEnvironmentSize("PLIST_MEMORY_LIMIT")};
+  return limit;
+}
+
+static std::atomic<size_t> &PlistTableGlobalMemoryLimit()
+{
+  static std::atomic<size_t> limit{PlistTableEnvironmentSize("PLIST_GLOBAL_MEMORY_LIMIT")};
+  return limit;
+}
+
+static std::atomic<size_t> s_totalMemoryUsage{0};
+
+static const char PlistTableResidualField[] = "_residual";
+
+/*
+ * latest snapshot of a file loaded by any table of the process, by source key, `loading` is held while it's built
+ */
+struct PlistTableShared
+{
+  std::mutex loading;
+  std::weak_ptr<const PlistTable::Snapshot> snapshot;
+  std::vector<std::string> fields;
+};
+
+static std::mutex s_sharedMutex;
+static std::map<std::string, std::shared_ptr<PlistTableShared>> s_shared;
+
+static std::shared_ptr<PlistTableShared> PlistTableGetShared(const std::string &key)
+{
+  std::lock_guard<std::mutex> lock(s_sharedMutex);
+  for (auto it = s_shared.begin(); it != s_shared.end();) {
+    // nobody is loading or holding it
+    it = it->second.use_count() == 1 && it->second->snapshot.expired() ? s_shared.erase(it) : std::next(it);
+  }
+  auto &shared = s_shared[key];
+  if (shared == nullptr) {
+    shared = std::make_shared<PlistTableShared>();
+  }
+  return shared;
+}
+
+static void PlistTableSetShared(PlistTableShared &shared, const std::shared_ptr<const PlistTable::Snapshot> &snapshot,
+                                const std::vector<std::string> &fields)
+{
+  // `PlistTableGetShared` checks it without holding `loading`
+  std::lock_guard<std::mutex> lock(s_sharedMutex);
+  shared.snapshot = snapshot;
+  shared.fields = fields;
+}
+
+void PlistTable::setDefaultMemoryLimit(size_t limit) { PlistTableDefaultMemoryLimit() = limit; }
+size_t PlistTable::getDefaultMemoryLimit() { return PlistTableDefaultMemoryLimit(); }
+void PlistTable::setGlobalMemoryLimit(size_t limit) { PlistTableGlobalMemoryLimit() = limit; }
+size_t PlistTable::getGlobalMemoryLimit() { return PlistTableGlobalMemoryLimit(); }
+size_t PlistTable::getTotalMemoryUsage() { return s_totalMemoryUsage; }
+
+PlistTable::Snapshot::Snapshot(const Table<Cell> &table, const std::vector<std::string> &fields)
+  : m_height(table.getHeight())
+{
+  TRACE_SCOPE("PlistTable::Snapshot::Snapshot");
+  auto &columns = table.getTable();
+  m_columns.reserve(fields.size());
+  for (auto &field : fields) {
+    auto it = columns.find(field);
+    m_columns.emplace_back(it != columns.end() ? new TypedColumn(it->second) : nullptr);
+  }
+  m_usage = m_columns.capacity() * sizeof(m_columns[0]);
+  for (auto &column : m_columns) {
+    m_usage += column != nullptr ? column->memoryUsage() : 0;
+  }
+  s_totalMemoryUsage += m_usage;
+}
+
+PlistTable::Snapshot::Snapshot(const std::shared_ptr<const TableCache> &cache, const std::vector<std::string> &fields)
+  : m_cache(cache)
+{
+  m_cacheColumns.reserve(fields.size());
+  for (auto &field : fields) {
+    m_cacheColumns.push_back(m_cache->getColumn(field));
+  }
+  m_usage = m_cache->memoryUsage() + m_cacheColumns.capacity() * sizeof(size_t);
+  s_totalMemoryUsage += m_usage;
+}
+
+PlistTable::Snapshot::~Snapshot() { s_totalMemoryUsage -= m_usage; }
+
+Cell PlistTable::Snapshot::getCell(const size_t row, const size_t column) const
+{
+  static const Cell null;
+  if (m_cache != nullptr) {
+    return column < m_cacheColumns.size() ? m_cache->getCell(row, m_cacheColumns[column]) : null;
+  }
+  const auto typed = getColumn(column);
+  return typed != nullptr ? typed->getCell(row) : null;
+}
+
+TypedColumn::Type PlistTable::Snapshot::getType(const size_t column) const
+{
+  if (m_cache != nullptr) {
+    return column < m_cacheColumns.size() ? m_cache->getType(m_cacheColumns[column]) : TypedColumn::NUL;
+  }
+  const auto typed = getColumn(column);
+  return typed != nullptr ? typed->getType() : TypedColumn::NUL;
+}
+
+PlistTable::PlistTable() : m_vtab(), m_snapshot(std::make_shared<Snapshot>(Table<Cell>(), std::vector<std::string>()))
+{
+}
+
+PlistTable::~PlistTable()
+{
+  if (m_reloader.joinable()) {
+    m_reloader.join();
+  }
+  if (m_rowLoader.joinable()) {
+    m_rowLoader.join();
+  }
+  releaseMemory();
+}
 
 bool PlistTable::load(const std::string &path, int depth, const std::string &keyPath)
 {
-  auto plist = Plist::parse(path, keyPath);
-  return load(plist, depth);
+  if (m_reloader.joinable()) {
+    m_reloader.join();
+  }
+  loadRows();
+  setSource(path, depth, keyPath);
+  Fingerprint::get(path, m_fingerprint);
+  m_types.clear();
+  m_elementCount = 0;
+  if (m_isStreaming) {
+    return loadStream();
+  }
+  std::shared_ptr<PlistTableShared> shared;
+  std::unique_lock<std::mutex> sharing;
+  if (isShared() && m_fingerprint.isValid()) {
+    shared = PlistTableGetShared(getSourceKey(m_fingerprint));
+    sharing = std::unique_lock<std::mutex>(shared->loading);
+    if (auto snapshot = shared->snapshot.lock()) {
+      if (!isWithinMemoryLimit(*snapshot, m_error)) {
+        return false;
+      }
+      m_fields = shared->fields;
+      publish(snapshot);
+      return true;
+    }
+  }
+  if (auto cache = openCache(m_fingerprint)) {
+    m_fields = cache->getFields();
+    publish(std::make_shared<Snapshot>(cache, m_fields));
+    if (shared != nullptr) {
+      PlistTableSetShared(*shared, getSnapshot(), m_fields);
+    }
+    return true;
+  }
+
+  // a sampled document's elements are decoded as they're flattened
+  m_isSampled = false;
+  auto plist = m_isArchive ? unarchive(Buffer::fromFile(path)) : Plist::parse(path, keyPath, m_sample != 0 ? 1 : depth);
+  if (m_sample != 0 && plist.isColumn() && plist.columnValue().size() > m_sample) {
+    return loadSample(plist, depth);
+  }
+  Table<Cell> table;
+  if (!build(plist, depth, table)) {
+    return false;
+  }
+  m_fields = table.getFields();
+  storeCache(m_fingerprint, table);
+  publish(table);
+  if (m_isWritable && plist.isColumn()) {
+    m_fieldKeys.clear();
+    collectKeys(plist.columnValue());
+  }
+  if (shared != nullptr) {
+    PlistTableSetShared(*shared, getSnapshot(), m_fields);
+  }
+  return true;
+}
+
+bool PlistTable::load(const std::vector<std::string> &fields)
+{
+  loadRows();
+  Fingerprint::get(m_path, m_fingerprint);
+  // flattened by a separate instance like a reload, the field names of this one's earlier builds don't carry over
+  PlistTable loader;
+  loader.setMemoryLimit(m_memoryLimit);
+  loader.setNested(m_isNested);
+  const auto plist = m_isArchive ? unarchive(Buffer::fromFile(m_path)) : Plist::parse(m_path, m_keyPath, m_depth);
+  Table<Cell> table;
+  if (!loader.build(plist, m_depth, table)) {
+    m_error = loader.getError();
+    return false;
+  }
+  m_fields = fields;
+  publish(table);
+  return true;
 }
 
 bool PlistTable::load(const void *buffer, const size_t size, int depth)
 {
-  auto plist = Plist::parse(buffer, size);
+  loadRows();
+  auto plist = m_isArchive ? unarchive(Buffer::copy(buffer, size)) : Plist::parse(buffer, size, "", depth);
   return load(plist, depth);
 }
 
 bool PlistTable::load(const Plist &plist, int depth)
 {
+  Table<Cell> table;
+  if (!build(plist, depth, table)) {
+    return false;
+  }
+  m_fields = table.getFields();
+  publish(table);
+  return true;
+}
+
+bool PlistTable::build(const Plist &plist, int depth, Table<Cell> &table)
+{
+  m_error.clear();
+  releaseMemory();
   if (!plist.isValid()) {
     return false;
   }
 
-  m_table = getTable(plist, depth == 0 ? INT_MAX : depth);
-  m_fields = m_table.getFields();
+  m_failed = false;
+  m_valueUsage = 0;
+  if (!reserveMemory(plist.memoryUsage(), "parsed document")) {
+    releaseMemory();
+    return false;
+  }
+
+  table = getTable(plist, depth == 0 ? INT_MAX : depth, FieldNames::Root);
+  if (m_failed) {
+    releaseMemory();
+  }
+  return !m_failed;
+}
+
+bool PlistTable::loadSample(const Plist &plist, int depth)
+{
+  TRACE_SCOPE("PlistTable::loadSample");
+  const auto &elements = plist.columnValue();
+  const size_t stride = elements.size() / m_sample;
+  m_elementCount = elements.size();
+  Cell::Column sample;
+  sample.reserve(m_sample);
+  for (size_t index = 0; index < m_sample; index++) {
+    sample.push_back(elements[index * stride]);
+  }
+  Table<Cell> table;
+  if (!build(Plist(Cell(sample)), depth, table)) {
+    return false;
+  }
+  m_fields = table.getFields();
+  if (std::find(m_fields.begin(), m_fields.end(), PlistTableResidualField) == m_fields.end()) {
+    m_fields.push_back(PlistTableResidualField);
+  }
+  m_isSampled = true;
+  // the types are declared before the rows are flattened, the sample decides them like it decides the fields
+  const Snapshot sampled(table, m_fields);
+  m_types.clear();
+  for (size_t column = 0; column < m_fields.size(); column++) {
+    m_types.push_back(sampled.getType(column));
+  }
+  publish(Table<Cell>());
+
+  // like a reload, the rows are flattened by a separate instance
+  m_rowLoader = std::thread([this, plist, depth] {
+    TRACE_SCOPE("PlistTable::loadRows");
+    PlistTable loader;
+    loader.setMemoryLimit(m_memoryLimit);
+    loader.setNested(m_isNested);
+    Table<Cell> table;
+    if (!loader.build(plist, depth, table)) {
+      m_rowLoadError = loader.getError();
+      m_isRowLoadFailed = true;
+      return;
+    }
+    storeCache(m_fingerprint, table);
+    addResidual(table);
+    publish(std::make_shared<Snapshot>(table, m_fields));
+  });
   return true;
 }
 
-Table<Cell> PlistTable::getTable(const Plist &plist, int depth, const std::string &prefix)
+bool PlistTable::loadStream()
 {
-  if (plist.isRow()) {
-    return getRowTable(plist.rowValue(), depth, prefix);
+  TRACE_SCOPE("PlistTable::loadStream");
+  std::shared_ptr<PlistReader> reader;
+  PlistReader::Node node;
+  m_error.clear();
+  if (!openStream(reader, node)) {
+    m_error = "streamed documents need an array at the root or the key path";
+    return false;
+  }
+  size_t position = 0;
+  PlistReader::Node item;
+  std::string key;
+  size_t count = 0;
+  if (m_sample != 0) {
+    while (reader->next(node, position, item, key)) {
+      count++;
+    }
+  }
+  m_isSampled = count > m_sample;
+  const size_t stride = m_isSampled ? count / m_sample : 1;
+
+  m_fields.clear();
+  std::unordered_set<std::string> fields;
+  position = 0;
+  m_elementCount = 0;
+  for (size_t index = 0; reader->next(node, position, item, key); index++) {
+    m_elementCount++;
+    if (index % stride != 0 || (m_isSampled && index / stride >= m_sample)) {
+      continue;
+    }
+    Table<Cell> table;
+    if (!build(Plist(Cell(Cell::Column{reader->read(item, INT_MAX)})), m_depth, table)) {
+      return false;
+    }
+    for (auto &field : table.getFields()) {
+      if (fields.insert(field).second) {
+        m_fields.push_back(field);
+      }
+    }
   }
-  if (plist.isColumn()) {
-    return getColumnTable(plist.columnValue(), depth, prefix);
+  if (m_isSampled && fields.count(PlistTableResidualField) == 0) {
+    m_fields.push_back(PlistTableResidualField);
   }
-  const auto name = prefix.empty() ? "_" : prefix;
-  return {name, plist};
+  publish(Table<Cell>());
+  return true;
+}
+
+bool PlistTable::openStream(std::shared_ptr<PlistReader> &reader, PlistReader::Node &node) const
+{
+  reader = PlistReader::create(Buffer::fromFile(m_path));
+  return reader != nullptr && reader->findKeyPath(m_keyPath, node) && reader->getType(node) == Cell::COLUMN;
 }
 
-Table<Cell> PlistTable::getRowTable(const Cell::Row &row, int depth, const std::string &prefix)
+bool PlistTable::readStream(const PlistReader &reader, const PlistReader::Node node, size_t &position,
+                            std::shared_ptr<const Snapshot> &rows)
+{
+  PlistReader::Node item;
+  std::string key;
+  if (!reader.next(node, position, item, key)) {
+    rows = nullptr;
+    return true;
+  }
+  // wrapped in an array so the element is flattened just like an element of the whole document
+  Table<Cell> table;
+  if (!build(Plist(Cell(Cell::Column{reader.read(item, INT_MAX)})), m_depth, table)) {
+    return false;
+  }
+  addResidual(table);
+  rows = std::make_shared<Snapshot>(table, m_fields);
+  // the rows only live as long as the cursor is on them
+  releaseMemory();
+  return true;
+}
+
+bool PlistTable::loadRows()
+{
+  if (!m_rowLoader.joinable()) {
+    return true;
+  }
+  m_rowLoader.join();
+  if (m_isRowLoadFailed) {
+    m_error = m_rowLoadError;
+    m_isRowLoadFailed = false;
+    return false;
+  }
+  return true;
+}
+
+void PlistTable::addResidual(Table<Cell> &table) const
+{
+  /*
+   * a field of the document named like the residual one keeps its values, the others' are dropped
+   */
+  if (!m_isSampled || !table[PlistTableResidualField].empty()) {
+    return;
+  }
+  std::vector<std::pair<const std::string *, const std::vector<Cell> *>> others;
+  for (auto &field : table.getFields()) {
+    if (std::find(m_fields.begin(), m_fields.end(), field) == m_fields.end()) {
+      others.push_back({&field, &table[field]});
+    }
+  }
+  if (others.empty()) {
+    return;
+  }
+  std::vector<Cell> residual(table.getHeight());
+  for (size_t row = 0; row < residual.size(); row++) {
+    Cell::Row values;
+    for (auto &other : others) {
+      const auto &cell = (*other.second)[row];
+      if (!cell.isNull()) {
+        values.insert({*other.first, cell});
+      }
+    }
+    if (!values.empty()) {
+      residual[row] = values;
+    }
+  }
+  table.addColumn(PlistTableResidualField).swap(residual);
+}
+
+void PlistTable::publish(const Table<Cell> &table)
+{
+  publish(std::make_shared<Snapshot>(table, m_fields));
+}
+
+void PlistTable::unload()
+{
+  publish(Table<Cell>());
+}
+
+void PlistTable::publish(const std::shared_ptr<const Snapshot> &snapshot)
+{
+  m_memoryUsage = snapshot->memoryUsage();
+  std::atomic_store(&m_snapshot, snapshot);
+  // the snapshot counts itself now
+  releaseMemory();
+}
+
+std::vector<TypedColumn::Type> PlistTable::getTypes() const
+{
+  if (!m_types.empty()) {
+    return m_types;
+  }
+  const auto snapshot = getSnapshot();
+  std::vector<TypedColumn::Type> types;
+  for (size_t column = 0; column < m_fields.size(); column++) {
+    types.push_back(snapshot->getType(column));
+  }
+  return types;
+}
+
+bool PlistTable::refresh()
 {
   /*
-   * field names are taken from the dictionary keys
-   * if prefix is not empty (e.g. it's not a root dictionary), field name is set to `prefix + "." + key`
-   * if prefix is not empty and the key is empty (might happen), field name is set to `prefix`
-   * if it's a root dictionary and the key is empty, field name is set to "_"
+   * while a transaction is open scans keep the rows it began with, rowids handed to xUpdate must keep pointing at the
+   * elements they were read from, its changes are rebuilt into rows once on commit
    */
+  if (m_inTransaction) {
+    return true;
+  }
+  if (!loadRows()) {
+    return false;
+  }
+  if (m_reloadMode == RELOAD_OFF || m_path.empty() || m_isReloading) {
+    return true;
+  }
+  Fingerprint fingerprint;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!Fingerprint::get(m_path, fingerprint) || fingerprint == m_fingerprint) {
+      return true;
+    }
+  }
+  if (!checkReload(fingerprint)) {
+    return false;
+  }
+
+  if (m_reloadMode == RELOAD_SYNC) {
+    reload(fingerprint);
+    return checkReload(fingerprint);
+  }
+  if (m_reloader.joinable()) {
+    m_reloader.join();
+  }
+  m_isReloading = true;
+  m_reloader = std::thread([this, fingerprint] {
+    reload(fingerprint);
+    m_isReloading = false;
+  });
+  return true;
+}
+
+void PlistTable::reload(const Fingerprint &fingerprint)
+{
+  /*
+   * the document is flattened by a separate instance, so the state of an ongoing build never leaks into this one
+   * the new rows are exposed through the fields declared on the first load, so column numbers SQLite already
+   * knows about stay valid whether or not the document's fields changed
+   */
+  TRACE_SCOPE("PlistTable::reload");
+  std::shared_ptr<PlistTableShared> shared;
+  std::unique_lock<std::mutex> sharing;
+  if (isShared()) {
+    shared = PlistTableGetShared(getSourceKey(fingerprint));
+    sharing = std::unique_lock<std::mutex>(shared->loading);
+    auto snapshot = shared->snapshot.lock();
+    if (snapshot != nullptr && shared->fields == m_fields) {
+      std::string error;
+      const bool isWithinLimit = isWithinMemoryLimit(*snapshot, error);
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!isWithinLimit) {
+        m_failedFingerprint = fingerprint;
+        m_reloadError = error;
+        return;
+      }
+      m_fingerprint = fingerprint;
+      m_failedFingerprint = Fingerprint();
+      publish(snapshot);
+      return;
+    }
+  }
+  if (auto cache = openCache(fingerprint)) {
+    auto snapshot = std::make_shared<const Snapshot>(cache, m_fields);
+    if (shared != nullptr) {
+      PlistTableSetShared(*shared, snapshot, m_fields);
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_fingerprint = fingerprint;
+    publish(snapshot);
+    return;
+  }
+
+  PlistTable loader;
+  loader.setMemoryLimit(m_memoryLimit);
+  loader.setNested(m_isNested);
+  const auto plist = m_isArchive ? unarchive(Buffer::fromFile(m_path)) : Plist::parse(m_path, m_keyPath, m_depth);
   Table<Cell> table;
-  if (depth-- == 0) return table;
+  const bool isBuilt = loader.build(plist, m_depth, table);
+  std::shared_ptr<const Snapshot> snapshot;
+  if (isBuilt) {
+    storeCache(fingerprint, table);
+    addResidual(table);
+    snapshot = std::make_shared<Snapshot>(table, m_fields);
+    if (shared != nullptr) {
+      PlistTableSetShared(*shared, snapshot, m_fields);
+    }
+  }
 
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (snapshot == nullptr) {
+    m_failedFingerprint = fingerprint;
+    m_reloadError = loader.getError().empty() ? "Failed reloading plist from '" + m_path + "'" : loader.getError();
+    return;
+  }
+  m_fingerprint = fingerprint;
+  m_failedFingerprint = Fingerprint();
+  publish(snapshot);
+}
+
+bool PlistTable::checkReload(const Fingerprint &fingerprint)
+{
+  /*
+   * a failed reload leaves the fingerprint where it was, it's reported by every refresh until the file changes
+   * again and the next reload is attempted
+   */
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_failedFingerprint.isValid() && fingerprint == m_failedFingerprint) {
+    m_error = m_reloadError;
+    return false;
+  }
+  return true;
+}
+
+static std::vector<std::string> PlistTableSplitKeyPath(const std::string &keyPath)
+{
+  std::vector<std::string> keys;
+  size_t begin = 0;
+  while (!keyPath.empty()) {
+    const size_t end = keyPath.find('.', begin);
+    keys.push_back(keyPath.substr(begin, end == std::string::npos ? std::string::npos : end - begin));
+    if (end == std::string::npos) {
+      break;
+    }
+    begin = end + 1;
+  }
+  return keys;
+}
+
+/*
+ * rows that flatten to exactly one table row: values are primitives or dictionaries of those
+ */
+static bool PlistTableIsFlat(const Cell::Row &row)
+{
+  for (auto &item : row) {
+    if (item.second.isColumn() || (item.second.isRow() && !PlistTableIsFlat(item.second.rowValue()))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool PlistTableHasValues(const Cell::Row &row)
+{
+  for (auto &item : row) {
+    if (item.second.isPrimitive() || PlistTableHasValues(item.second.rowValue())) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * inverse of the field naming in getTable, the original spelling of the keys is needed to write values back
+ * a field can come from several key paths (keys differing in case, keys containing '.'), all of them are kept
+ */
+static void PlistTableCollectKeys(const Cell::Row &row, const std::string &prefix, std::vector<std::string> &keys,
+                                  std::map<std::string, std::vector<std::vector<std::string>>> &fieldKeys)
+{
   for (auto &item : row) {
     std::string suffix;
-    std::transform(item.first.begin(), item.first.end(), std::back_inserter(suffix), std::tolower);
+    std::transform(item.first.begin(), item.first.end(), std::back_inserter(suffix), ::tolower);
     const auto delimiter = prefix.empty() || suffix.empty() ? "" : ".";
     const auto name = prefix.empty() && suffix.empty() ? "_" : prefix + delimiter + suffix;
-    auto itemTable = getTable(item.second, depth, name);
-    table.combine(itemTable);
+    keys.push_back(item.first);
+    if (item.second.isRow()) {
+      PlistTableCollectKeys(item.second.rowValue(), name, keys, fieldKeys);
+    }
+    else {
+      auto &paths = fieldKeys[name];
+      if (std::find(paths.begin(), paths.end(), keys) == paths.end()) {
+        paths.push_back(keys);
+      }
+    }
+    keys.pop_back();
   }
+}
 
-  return table;
+static Cell PlistTableGet(const Cell &node, const std::vector<std::string> &keys)
+{
+  const Cell *cell = &node;
+  for (auto &key : keys) {
+    if (!cell->isRow()) {
+      return nullptr;
+    }
+    auto it = cell->rowValue().find(key);
+    if (it == cell->rowValue().end()) {
+      return nullptr;
+    }
+    cell = &it->second;
+  }
+  return *cell;
 }
 
-Table<Cell> PlistTable::getColumnTable(const Cell::Column &column, int depth, const std::string &prefix, const size_t level)
+Plist PlistTable::unarchive(const std::shared_ptr<const Buffer> &buffer) const
+{
+  return PlistTableGet(KeyedArchive::decode(buffer), PlistTableSplitKeyPath(m_keyPath));
+}
+
+/*
+ * copy of `node` with the value at `keys` replaced, null values remove the key, missing dictionaries are created
+ * only the dictionaries along the path are copied, everything else is shared with the original
+ */
+static Cell PlistTableSet(const Cell &node, const std::vector<std::string> &keys, const size_t index, const Cell &value)
+{
+  if (index == keys.size() || (!node.isRow() && !value.isValid())) {
+    return index == keys.size() ? value : node;
+  }
+  Cell::Row row = node.isRow() ? node.rowValue() : Cell::Row();
+  auto it = row.find(keys[index]);
+  const Cell child = PlistTableSet(it != row.end() ? it->second : Cell(), keys, index + 1, value);
+  if (child.isValid()) {
+    row[keys[index]] = child;
+  }
+  else if (it != row.end()) {
+    row.erase(it);
+  }
+  return row;
+}
+
+/*
+ * SQLite only knows about integers and reals, values that didn't change keep their original cell (booleans, dates,
+ * integral reals) and changed ones keep the plist type where it can represent them
+ * returns false if `value` is the same as `current`
+ */
+static bool PlistTableConvert(const Cell &current, const Cell &value, Cell &result)
+{
+  if (current.type() == value.type()) {
+    if (value.isNull() || (value.isInteger() && current.integerValue() == value.integerValue()) ||
+        (value.isReal() && current.realValue() == value.realValue()) ||
+        (value.isText() && current.textValue() == value.textValue()) ||
+        (value.isBlob() && current.blobValue() == value.blobValue())) {
+      return false;
+    }
+  }
+  if (current.isBoolean() && value.isInteger() && (value.integerValue() == 0 || value.integerValue() == 1)) {
+    result = Cell::boolean(value.integerValue() != 0);
+  }
+  else if (current.isDate() && (value.isReal() || value.isInteger())) {
+    result = Cell::date(value.isReal() ? value.realValue() : (Cell::Real)value.integerValue());
+  }
+  else {
+    result = value;
+  }
+  return true;
+}
+
+static bool PlistTableWriteFile(const std::string &path, const std::string &bytes, std::string &error)
+{
+  struct stat info;
+  const mode_t mode = stat(path.c_str(), &info) == 0 ? info.st_mode & 07777 : 0644;
+  std::vector<char> temporary(path.begin(), path.end());
+  const char suffix[] = ".XXXXXX";
+  temporary.insert(temporary.end(), suffix, suffix + sizeof(suffix));
+
+  const int file = mkstemp(temporary.data());
+  if (file < 0) {
+    error = "failed creating a temporary file next to '" + path + "': " + std::strerror(errno);
+    return false;
+  }
+  bool isWritten = fchmod(file, mode) == 0;
+  for (size_t offset = 0; isWritten && offset < bytes.size();) {
+    const ssize_t written = ::write(file, bytes.data() + offset, bytes.size() - offset);
+    isWritten = written > 0 || (written < 0 && errno == EINTR);
+    offset += written > 0 ? (size_t)written : 0;
+  }
+  isWritten = isWritten && fsync(file) == 0;
+  isWritten = close(file) == 0 && isWritten;
+  if (!isWritten || rename(temporary.data(), path.c_str()) != 0) {
+    error = "failed writing '" + path + "': " + std::strerror(errno);
+    unlink(temporary.data());
+    return false;
+  }
+  return true;
+}
+
+/*
+ * the path tells apart tables built differently from the same file, the key also identifies the file's contents
+ */
+std::string PlistTable::getCachePath() const
+{
+  return TableCache::getPath(m_cacheDirectory, m_path, getVariant());
+}
+
+std::string PlistTable::getVariant() const
+{
+  return std::to_string(m_depth) + "\n" + m_keyPath + "\n" + (m_isNested ? "nested" : "") + "\n" +
+         (m_isArchive ? "archive" : "");
+}
+
+std::string PlistTable::getSourceKey(const Fingerprint &fingerprint) const
+{
+  return fingerprint.toString() + "\n" + getVariant();
+}
+
+std::string PlistTable::getSourceKey() const
+{
+  Fingerprint fingerprint;
+  return Fingerprint::get(m_path, fingerprint) ? getSourceKey(fingerprint) : "";
+}
+
+std::shared_ptr<const TableCache> PlistTable::openCache(const Fingerprint &fingerprint) const
+{
+  if (!m_isCaching || !fingerprint.isValid()) {
+    return nullptr;
+  }
+  return TableCache::open(getCachePath(), getSourceKey(fingerprint));
+}
+
+void PlistTable::storeCache(const Fingerprint &fingerprint, const Table<Cell> &table) const
+{
+  if (!m_isCaching || !fingerprint.isValid()) {
+    return;
+  }
+  std::string bytes, error;
+  if (TableCache::serialize(table, getSourceKey(fingerprint), bytes)) {
+    PlistTableWriteFile(getCachePath(), bytes, error);
+  }
+}
+
+bool PlistTable::begin()
+{
+  TRACE_SCOPE("PlistTable::begin");
+  m_error.clear();
+  if (!m_isWritable) {
+    m_error = "table is read-only, create it with writable=1 to modify the plist";
+    return false;
+  }
+  if (m_path.empty() || m_depth != 0 || m_isNested || m_isArchive || m_keyPath.find('@') != std::string::npos) {
+    m_error = "only tables over a whole file, with unlimited depth, no nested plists or archives and a key path made of dictionary keys can be modified";
+    return false;
+  }
+  if (m_inTransaction) {
+    return true;
+  }
+
+  // the rowids SQLite is about to hand over have to come from the document being modified
+  if (m_reloader.joinable()) {
+    m_reloader.join();
+  }
+  Fingerprint fingerprint;
+  if (Fingerprint::get(m_path, fingerprint) && fingerprint != m_fingerprint) {
+    reload(fingerprint);
+  }
+
+  // the bytes are kept to put the document back on rollback, the mapping survives the file being replaced
+  m_source = Buffer::fromFile(m_path);
+  if (m_source == nullptr) {
+    m_error = "failed reading '" + m_path + "'";
+    return false;
+  }
+  m_document = Plist::parse(m_source->data(), m_source->size());
+  Cell target = m_document;
+  for (auto &key : PlistTableSplitKeyPath(m_keyPath)) {
+    target = PlistTableGet(target, {key});
+  }
+  bool isTabular = target.isColumn();
+  for (size_t index = 0; isTabular && index < target.size(); index++) {
+    const auto &element = target.columnValue()[index];
+    isTabular = element.isRow() && PlistTableIsFlat(element.rowValue());
+  }
+  if (!isTabular) {
+    m_error = "only an array of dictionaries without nested arrays can be modified";
+    m_document = Cell();
+    m_source.reset();
+    return false;
+  }
+
+  setElements(target.columnValue());
+  if (m_rowElements.size() != getHeight()) {
+    m_error = "the plist changed while it was being read";
+    endTransaction();
+    return false;
+  }
+  m_committedSnapshot = getSnapshot();
+  m_committedMemoryUsage = m_memoryUsage;
+  m_inTransaction = true;
+  return true;
+}
+
+void PlistTable::setElements(const Cell::Column &elements)
+{
+  m_elements = elements;
+  m_rowElements.clear();
+  for (size_t index = 0; index < m_elements.size(); index++) {
+    if (PlistTableHasValues(m_elements[index].rowValue())) {
+      m_rowElements.push_back(index);
+    }
+  }
+  collectKeys(elements);
+}
+
+/*
+ * key paths of the fields, collected from the document the table was declared with and the one of each
+ * transaction, so fields gone from the document can still be written
+ */
+void PlistTable::collectKeys(const Cell::Column &elements)
+{
+  std::vector<std::string> keys;
+  for (auto &element : elements) {
+    if (element.isRow()) {
+      PlistTableCollectKeys(element.rowValue(), "", keys, m_fieldKeys);
+    }
+  }
+}
+
+bool PlistTable::hasField(const Cell &element, const size_t column) const
+{
+  auto it = m_fieldKeys.find(m_fields[column]);
+  if (it != m_fieldKeys.end()) {
+    for (auto &keys : it->second) {
+      if (PlistTableGet(element, keys).isValid()) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/*
+ * key path `column` is written to in `element`: the only key path of the field the element has, or the only one the
+ * field has at all, anything else would be a guess
+ */
+bool PlistTable::getFieldKeys(const Cell &element, const size_t column, std::vector<std::string> &keys)
+{
+  auto it = m_fieldKeys.find(m_fields[column]);
+  if (it == m_fieldKeys.end()) {
+    m_error = "no key of the plist maps to column '" + m_fields[column] + "'";
+    return false;
+  }
+  const std::vector<std::string> *found = it->second.size() == 1 ? &it->second[0] : nullptr;
+  size_t count = 0;
+  for (auto &paths : it->second) {
+    if (PlistTableGet(element, paths).isValid()) {
+      found = &paths;
+      count++;
+    }
+  }
+  if (found == nullptr || count > 1) {
+    m_error = "column '" + m_fields[column] + "' maps to more than one key of the plist";
+    return false;
+  }
+  keys = *found;
+  return true;
+}
+
+bool PlistTable::getElement(const int64_t rowid, size_t &index) const
+{
+  if (rowid < 0 || (uint64_t)rowid >= m_rowElements.size() || !m_elements[m_rowElements[rowid]].isValid()) {
+    return false;
+  }
+  index = m_rowElements[rowid];
+  return true;
+}
+
+bool PlistTable::insert(const std::vector<Cell> &values, int64_t &rowid)
+{
+  if (!m_inTransaction) {
+    return false;
+  }
+  Cell element = Cell::Row();
+  for (size_t column = 0; column < values.size() && column < m_fields.size(); column++) {
+    std::vector<std::string> keys;
+    if (values[column].isNull()) {
+      continue;
+    }
+    if (!getFieldKeys(element, column, keys)) {
+      return false;
+    }
+    element = PlistTableSet(element, keys, 0, values[column]);
+  }
+  m_elements.push_back(element);
+  // inserted rows get rowids past the rows of the transaction's scans, so they can be changed again before commit,
+  // rows without values too
+  rowid = (int64_t)m_rowElements.size();
+  m_rowElements.push_back(m_elements.size() - 1);
+  m_isChanged = m_isDirty = true;
+  return true;
+}
+
+bool PlistTable::update(const int64_t rowid, const std::vector<Cell> &values)
+{
+  size_t index;
+  if (!m_inTransaction || !getElement(rowid, index)) {
+    m_error = "no row with rowid " + std::to_string(rowid);
+    return false;
+  }
+  Cell element = m_elements[index];
+  for (size_t column = 0; column < values.size() && column < m_fields.size(); column++) {
+    std::vector<std::string> keys;
+    if (!getFieldKeys(element, column, keys)) {
+      // a field the row has none of the keys of stays unset
+      if (values[column].isNull() && !hasField(element, column)) {
+        continue;
+      }
+      return false;
+    }
+    Cell value;
+    if (PlistTableConvert(PlistTableGet(element, keys), values[column], value)) {
+      element = PlistTableSet(element, keys, 0, value);
+    }
+  }
+  m_elements[index] = element;
+  m_isChanged = m_isDirty = true;
+  return true;
+}
+
+bool PlistTable::remove(const int64_t rowid)
+{
+  size_t index;
+  if (!m_inTransaction || !getElement(rowid, index)) {
+    m_error = "no row with rowid " + std::to_string(rowid);
+    return false;
+  }
+  m_elements[index] = Cell();
+  m_isChanged = m_isDirty = true;
+  return true;
+}
+
+bool PlistTable::rebuild()
+{
+  TRACE_SCOPE("PlistTable::rebuild");
+  Cell::Column elements;
+  elements.reserve(m_elements.size());
+  for (auto &element : m_elements) {
+    if (element.isValid()) {
+      elements.push_back(element);
+    }
+  }
+  Table<Cell> table;
+  if (!build(Plist(Cell(elements)), 0, table)) {
+    return false;
+  }
+  publish(table);
+  m_isDirty = false;
+  return true;
+}
+
+bool PlistTable::sync()
+{
+  if (!m_inTransaction || !m_isChanged) {
+    return true;
+  }
+  TRACE_SCOPE("PlistTable::sync");
+  Cell::Column elements;
+  for (auto &element : m_elements) {
+    if (element.isValid()) {
+      elements.push_back(element);
+    }
+  }
+  const Cell root = PlistTableSet(m_document, PlistTableSplitKeyPath(m_keyPath), 0, elements);
+  // the document keeps its format, those only CoreFoundation reads are written as XML
+  std::string bytes;
+  const bool isBinary = BinaryPlistReader::isBinaryPlist(m_source->data(), m_source->size());
+  if (!(isBinary ? BinaryPlistWriter::write(root, bytes) : XmlPlistWriter::write(root, bytes))) {
+    m_error = "failed serializing the plist";
+    return false;
+  }
+  if (!PlistTableWriteFile(m_path, bytes, m_error)) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Fingerprint::get(m_path, m_fingerprint);
+  m_isWritten = true;
+  return true;
+}
+
+void PlistTable::commit()
+{
+  if (m_inTransaction && m_isDirty && !rebuild()) {
+    // over the memory limit, the next scan reloads the written file and reports the error
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_fingerprint = Fingerprint();
+  }
+  endTransaction();
+}
+
+void PlistTable::rollback()
+{
+  if (!m_inTransaction) {
+    return;
+  }
+  if (m_isWritten) {
+    // another table failed to sync after this one was written, put the original bytes back
+    const std::string bytes((const char *)m_source->data(), m_source->size());
+    std::string error;
+    if (PlistTableWriteFile(m_path, bytes, error)) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      Fingerprint::get(m_path, m_fingerprint);
+    }
+  }
+  if (getSnapshot() != m_committedSnapshot) {
+    m_memoryUsage = m_committedMemoryUsage;
+    std::atomic_store(&m_snapshot, m_committedSnapshot);
+  }
+  endTransaction();
+}
+
+void PlistTable::endTransaction()
+{
+  m_inTransaction = m_isChanged = m_isDirty = m_isWritten = false;
+  m_document = Cell();
+  m_source.reset();
+  m_elements.clear();
+  m_rowElements.clear();
+  m_committedSnapshot.reset();
+}
+
+bool PlistTable::reserveMemory(size_t bytes, const char *what)
 {
   /*
-   * field name is, by default, prefix
-   * if prefix is empty (e.g. it's a root array), field name is set to "_"
-   * in case of multilevel arrays ([1, 2, [3, 4]]), first level's name is prefix, subsequent levels have the name `prefix + "._"`
+   * `bytes` is the projected size of a table (or document) about to be built, on top of the values collected so far
+   * tables already loaded by other instances and the reservations of their builds count towards the global limit,
+   * the table being replaced doesn't
+   * the reservation is added to the total in the same step as it's checked, so concurrent builds can't all pass the
+   * check, it's held until the rows are published (their snapshot counts itself then) or the build fails
    */
+  const size_t usage = m_valueUsage + std::min(bytes, std::numeric_limits<size_t>::max() - m_valueUsage);
+  if (m_memoryLimit != 0 && usage > m_memoryLimit) {
+    m_error = std::string(what) + " needs " + std::to_string(usage) + " bytes, exceeding the table memory limit of " +
+              std::to_string(m_memoryLimit) + " bytes";
+    m_failed = true;
+    return false;
+  }
+  const size_t globalLimit = getGlobalMemoryLimit();
+  const size_t reserved = m_reservedMemory;
+  size_t total = s_totalMemoryUsage;
+  do {
+    const size_t own = std::min(total, reserved + m_memoryUsage);
+    const size_t others = total - own;
+    if (globalLimit != 0 && (usage > globalLimit || others > globalLimit - usage)) {
+      m_error = std::string(what) + " needs " + std::to_string(usage) + " bytes, exceeding the global memory limit of " +
+                std::to_string(globalLimit) + " bytes (" + std::to_string(others) + " bytes used by other tables)";
+      m_failed = true;
+      return false;
+    }
+  } while (!s_totalMemoryUsage.compare_exchange_weak(total, total - reserved + usage));
+  m_reservedMemory = usage;
+  return true;
+}
+
+bool PlistTable::isWithinMemoryLimit(const Snapshot &snapshot, std::string &error) const
+{
+  /*
+   * a shared snapshot was built under the limits of the table that loaded it, it already counts towards the global
+   * limit but not towards this table's
+   */
+  if (m_memoryLimit == 0 || snapshot.memoryUsage() <= m_memoryLimit) {
+    return true;
+  }
+  error = "shared table needs " + std::to_string(snapshot.memoryUsage()) +
+          " bytes, exceeding the table memory limit of " + std::to_string(m_memoryLimit) + " bytes";
+  return false;
+}
+
+void PlistTable::releaseMemory()
+{
+  s_totalMemoryUsage -= m_reservedMemory.exchange(0);
+}
+
+static Cell PlistTableExpand(const Cell &blob)
+{
+  const Cell embedded = PlistReader::embedded(blob);
+  return embedded.isValid() ? embedded : blob;
+}
+
+/*
+ * drops the reference a frame keeps, the moved-from cell is only ever assigned to again
+ */
+static void PlistTableRelease(Cell &cell)
+{
+  const Cell released = std::move(cell);
+}
+
+Table<Cell> PlistTable::getTable(const Plist &plist, int depth, const size_t prefix)
+{
+  /*
+   * every dictionary and array being flattened has a frame in `m_frames` rather than a call on the stack, so the depth
+   * of a document is only limited by memory, frames stay allocated for the next documents
+   * the table of a dictionary is the product of the tables of its values (combine), that of an array is the union of
+   * the tables of its elements (join)
+   */
+  TRACE_SCOPE("PlistTable::getTable");
   Table<Cell> table;
-  if (depth-- == 0) return table;
+  m_frameCount = 0;
+  if (!openFrame(plist, depth, prefix, 0, table)) {
+    return table;
+  }
+
+  Cell child;
+  int childDepth;
+  size_t childPrefix, childLevel;
+  while (!m_failed) {
+    FlattenFrame &frame = m_frames[m_frameCount - 1];
+    if (nextChild(frame, child, childDepth, childPrefix, childLevel)) {
+      if (openFrame(child, childDepth, childPrefix, childLevel, table)) {
+        continue;
+      }
+    }
+    else if (!m_failed) {
+      table = std::move(frame.table);
+      PlistTableRelease(frame.cell);
+      PlistTableRelease(frame.expanded);
+      if (--m_frameCount == 0) {
+        break;
+      }
+    }
+    else {
+      break;
+    }
 
-  const auto name = prefix.empty() ? "_" : level == 0 ? prefix : prefix + "._";
-  for (auto &item : column) {
-    auto itemTable = item.isColumn() ?
-                     getColumnTable(item.columnValue(), depth, name, level + 1) : //subsequent levels support
-                     getTable(item, depth, item.isPrimitive() ? name : prefix);
-    table.join(itemTable);
+    FlattenFrame &parent = m_frames[m_frameCount - 1];
+    if (parent.cell.isRow()) {
+      if (!reserveMemory(parent.table.combinedMemoryUsage(table), "flattened table")) {
+        break;
+      }
+      parent.table.combine(std::move(table));
+    }
+    else {
+      if (!reserveMemory(parent.table.joinedMemoryUsage(table), "flattened table")) {
+        break;
+      }
+      parent.table.join(std::move(table));
+    }
+  }
+
+  PlistTableRelease(child);
+  if (m_failed) {
+    for (; m_frameCount > 0; m_frameCount--) {
+      FlattenFrame &frame = m_frames[m_frameCount - 1];
+      frame.table = Table<Cell>();
+      PlistTableRelease(frame.cell);
+      PlistTableRelease(frame.expanded);
+    }
+    return Table<Cell>();
   }
   return table;
 }
+
+bool PlistTable::openFrame(const Cell &cell, int depth, const size_t prefix, const size_t level, Table<Cell> &table)
+{
+  /*
+   * pushes the frame of a dictionary or an array, anything else (and containers past `depth`) is flattened right away
+   * into `table`
+   * the elements of an array are named after `prefix` ("_" at the root), those of nested arrays ([1, 2, [3, 4]]) after
+   * `prefix + "._"` (see FieldNames::getElement)
+   */
+  Cell value = cell;
+  while (m_isNested && depth > 0 && value.isBlob()) {
+    const Cell embedded = PlistReader::embedded(value);
+    if (!embedded.isValid()) {
+      break;
+    }
+    value = embedded;
+  }
+  if (value.isPrimitive()) {
+    m_valueUsage += value.memoryUsage();
+    table = {m_fieldNames.getName(m_fieldNames.getValue(prefix)), value};
+    return false;
+  }
+  if (depth == 0) {
+    table = Table<Cell>();
+    return false;
+  }
+
+  if (m_frameCount == m_frames.size()) {
+    m_frames.emplace_back();
+  }
+  FlattenFrame &frame = m_frames[m_frameCount++];
+  frame.cell = std::move(value);
+  frame.depth = depth - 1;
+  frame.prefix = prefix;
+  frame.level = level;
+  frame.index = 0;
+  frame.table = Table<Cell>();
+  if (frame.cell.isRow()) {
+    frame.it = frame.cell.rowValue().begin();
+  }
+  else {
+    frame.name = m_fieldNames.getElement(prefix, level);
+    frame.columns.clear();
+  }
+  return true;
+}
+
+bool PlistTable::nextChild(FlattenFrame &frame, Cell &child, int &depth, size_t &prefix, size_t &level)
+{
+  /*
+   * the next value of `frame` that needs a table of its own, false once there's none left or memory ran out
+   * the values of a dictionary are named `prefix + "." + key` (see FieldNames::getChild)
+   * elements of an array flattening into a single row (primitive values and records, dictionaries nested in them
+   * included) are appended to the table in place instead
+   */
+  if (frame.cell.isRow()) {
+    if (frame.it == frame.cell.rowValue().end()) {
+      return false;
+    }
+    child = frame.it->second;
+    depth = frame.depth;
+    prefix = m_fieldNames.getChild(frame.prefix, frame.it->first);
+    level = 0;
+    ++frame.it;
+    return true;
+  }
+
+  const Cell::Column &column = frame.cell.columnValue();
+  Table<Cell> &table = frame.table;
+  auto &columns = frame.columns;
+  auto &record = m_record;
+  while (frame.index < column.size()) {
+    const Cell &value = column[frame.index++];
+    const bool isExpanded = m_isNested && frame.depth > 0 && value.isBlob();
+    const Cell &item = isExpanded ? (frame.expanded = PlistTableExpand(value)) : value;
+    record.clear();
+    if (getRecord(item, frame.depth, item.isPrimitive() ? frame.name : frame.prefix, record)) {
+      if (record.empty()) {
+        continue;
+      }
+      // fields new to the table are added in the order of their names, like `join` adds them
+      std::map<std::string, size_t> newFields;
+      for (auto &field : record) {
+        if (field.first >= columns.size()) {
+          columns.resize(field.first + 1, nullptr);
+        }
+        if (columns[field.first] == nullptr) {
+          newFields[m_fieldNames.getName(field.first)] = field.first;
+        }
+      }
+      for (auto &it : newFields) {
+        columns[it.second] = &table.addColumn(it.first);
+      }
+      for (auto &field : record) {
+        appendValue(*columns[field.first], table.getHeight(), *field.second);
+      }
+      table.addRow();
+      if (!reserveMemory(Table<Cell>::memoryUsage(table.getFields().size(), table.getHeight()), "flattened table")) {
+        return false;
+      }
+      continue;
+    }
+    child = item;
+    depth = frame.depth;
+    prefix = item.isColumn() || item.isPrimitive() ? frame.name : frame.prefix;
+    level = item.isColumn() ? frame.level + 1 : 0;
+    return true;
+  }
+  return false;
+}
+
+bool PlistTable::getRecord(const Cell &item, int depth, const size_t field,
+                           std::vector<std::pair<size_t, const Cell *>> &record)
+{
+  /*
+   * collects the values getTable(item, depth, field) would flatten, false unless that's at most one row
+   * nested dictionaries are walked in the same order with `m_recordEntries` as the stack
+   */
+  m_recordEntries.clear();
+  m_recordEntries.push_back({&item, nullptr, field, depth});
+  while (!m_recordEntries.empty()) {
+    const RecordEntry entry = m_recordEntries.back();
+    m_recordEntries.pop_back();
+    const Cell &cell = *entry.cell;
+    const size_t name = entry.key != nullptr ? m_fieldNames.getChild(entry.parent, *entry.key) : entry.parent;
+    if (cell.isPrimitive()) {
+      if (m_isNested && entry.depth > 0 && cell.isBlob()) {
+        return false;
+      }
+      record.push_back({m_fieldNames.getValue(name), &cell});
+      continue;
+    }
+    if (!cell.isRow()) {
+      return false;
+    }
+    if (entry.depth == 0) {
+      continue;
+    }
+    const auto &row = cell.rowValue();
+    for (auto it = row.rbegin(); it != row.rend(); ++it) {
+      m_recordEntries.push_back({&it->second, &it->first, name, entry.depth - 1});
+    }
+  }
+  return true;
+}
+
+void PlistTable::appendValue(std::vector<Cell> &column, const size_t row, const Cell &value)
+{
+  m_valueUsage += value.memoryUsage();
+  // keys of a record naming the same field (differing only in case, "a.b" next to "a" > "b") share it, the last wins
+  if (column.size() > row) {
+    column.back() = value;
+  }
+  else {
+    column.push_back(value);
+  }
+}
@@ -1,20 +1,247 @@
 #pragma once
 
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 #include <sqlite3.h>
+#include "FieldNames.hpp"
+#include "Fingerprint.hpp"
 #include "Plist.hpp"
+#include "PlistReader.hpp"
 #include "Table.hpp"
+#include "TableCache.hpp"
+#include "TypedColumn.hpp"
+
+class ShadowTable;
 
 class PlistTable
 {
 public:
+  /*
+   * immutable rows of one load of the document, cursors keep the snapshot they started with
+   * `columns` follow the declared fields, fields missing from a reloaded document read as NULL
+   * the rows are either flattened and stored in typed columns (see TypedColumn) or decoded on access from a mapped
+   * cache file
+   * nothing is written after construction (lazily decoded cells load once, see Cell::lazy), so any number of
+   * threads can read a snapshot at once, its memory counts towards the process total for as long as it's alive
+   */
+  class Snapshot
+  {
+  public:
+    Snapshot(const Table<Cell> &, const std::vector<std::string> &fields);
+    Snapshot(const std::shared_ptr<const TableCache> &, const std::vector<std::string> &fields);
+    ~Snapshot();
+
+    size_t getHeight() const { return m_cache != nullptr ? m_cache->getHeight() : m_height; }
+    Cell getCell(const size_t row, const size_t column) const;
+
+    /*
+     * storage of `column`, nullptr if the field is missing or the rows come from a cache file
+     */
+    const TypedColumn *getColumn(const size_t column) const
+    {
+      return column < m_columns.size() ? m_columns[column].get() : nullptr;
+    }
+    TypedColumn::Type getType(const size_t column) const;
+
+    size_t memoryUsage() const { return m_usage; }
+
+  private:
+    size_t m_height = 0;
+    size_t m_usage = 0;
+    std::vector<std::unique_ptr<const TypedColumn>> m_columns;
+    std::shared_ptr<const TableCache> m_cache;
+    std::vector<size_t> m_cacheColumns;
+  };
+
+  enum ReloadMode
+  {
+    RELOAD_OFF,
+    RELOAD_SYNC,
+    RELOAD_BACKGROUND,
+  };
+
+  PlistTable();
+  ~PlistTable();
+
+  /*
+   * tables of any connection loading the same file contents with the same options share one snapshot of its rows,
+   * the first one flattens the document while the others wait for it, writable and sampled tables keep their own
+   */
   bool load(const std::string &, int, const std::string &);
   bool load(const void *, const size_t, int);
 
+  /*
+   * loads the current rows of the source (see `setSource`) through `fields`, e.g. the columns materialized rows were
+   * declared with, whatever fields the document has now, values of the others are dropped
+   */
+  bool load(const std::vector<std::string> &fields);
+
+  /*
+   * what `load(path, depth, keyPath)` loads, without loading it
+   */
+  void setSource(const std::string &path, int depth, const std::string &keyPath)
+  {
+    m_path = path;
+    m_depth = depth;
+    m_keyPath = keyPath;
+  }
+  const std::string &getPath() const { return m_path; }
+  int getDepth() const { return m_depth; }
+  const std::string &getKeyPath() const { return m_keyPath; }
+
+  /*
+   * identity of the source file's current contents combined with the options the rows are built with, empty if
+   * the file can't be read
+   */
+  std::string getSourceKey() const;
+
+  /*
+   * drops the rows, e.g. once they're materialized somewhere else
+   */
+  void unload();
+
   const std::vector<std::string> &getFields() const { return m_fields; }
-  const Cell &getCell(const int row, const int column) const { return m_table[m_fields[column]][row]; }
-  size_t getHeight() const { return m_table.getHeight(); }
+
+  /*
+   * types shared by the values of each field in the current snapshot, what the schema declares
+   * a sampled table's are those of its sample, whether or not its rows are flattened yet
+   */
+  std::vector<TypedColumn::Type> getTypes() const;
+
+  Cell getCell(const int row, const int column) const { return getSnapshot()->getCell(row, column); }
+  size_t getHeight() const { return getSnapshot()->getHeight(); }
+
+  /*
+   * elements of the document a streamed or sampled table was loaded from, the rows it will produce even though
+   * they aren't in the current snapshot, 0 for other tables
+   */
+  size_t getElementCount() const { return m_elementCount; }
+
+  std::shared_ptr<const Snapshot> getSnapshot() const { return std::atomic_load(&m_snapshot); }
+
+  /*
+   * checks whether the file the table was loaded from changed (inode, size, modification time) and reloads it,
+   * either before returning or on a background thread while the current snapshot keeps being served
+   * the declared fields never change, a failed reload keeps the current snapshot and makes every refresh return
+   * false with its error until the file changes again
+   * returns false as well if the rows of a sampled load can't be flattened
+   */
+  bool refresh();
+  void setReloadMode(ReloadMode mode) { m_reloadMode = mode; }
+
+  /*
+   * a document that is an array of more than `sample` elements only has `sample` of them (evenly spread) flattened
+   * by `load`, which declares their fields plus "_residual", the rows are flattened on a background thread started
+   * by `load` and values of fields the sample didn't have go to "_residual", as a dictionary per row
+   * 0 (the default) flattens the whole document inside `load`, whose fields are only known once all of it is
+   */
+  void setSample(size_t sample) { m_sample = sample; }
+
+  /*
+   * waits for the rows of a sampled load (`refresh` does too), false if flattening them failed (see `getError`)
+   */
+  bool loadRows();
+
+  /*
+   * for documents larger than memory: `load` only collects the fields of the elements of the root array (or the
+   * array at the key path), every scan then streams the elements from the mapped file, flattening one at a time,
+   * so neither decoded nor flattened rows of the whole document are ever held
+   * combined with `setSample` only the sampled elements' fields are declared (see `setSample`)
+   */
+  void setStreaming(bool streaming) { m_isStreaming = streaming; }
+  bool isStreaming() const { return m_isStreaming; }
+
+  /*
+   * opens the array a streamed scan walks, false if the file can't be read or isn't an array there
+   */
+  bool openStream(std::shared_ptr<PlistReader> &, PlistReader::Node &) const;
+
+  /*
+   * rows of the element after `position` (see PlistReader::next) in the declared fields, nullptr past the last
+   * element, false if they can't be flattened (see `getError`)
+   */
+  bool readStream(const PlistReader &, const PlistReader::Node, size_t &position, std::shared_ptr<const Snapshot> &);
+
+  /*
+   * data values holding a bplist00 or XML plist are flattened like any other subtree, the embedded document's
+   * containers count towards the depth limit, and data at the limit is returned as is without being decoded
+   */
+  void setNested(bool nested) { m_isNested = nested; }
+
+  /*
+   * the document is an NSKeyedArchiver archive, its object graph is resolved (see KeyedArchive) before flattening
+   * and the key path applies to the resolved objects
+   */
+  void setArchive(bool archive) { m_isArchive = archive; }
+  bool isArchive() const { return m_isArchive; }
+
+  /*
+   * flattened rows of a file are persisted to a cache file (see TableCache) in `directory`, or next to the file if
+   * it's empty, loads and reloads of a file whose fingerprint and table options match map the cache instead of
+   * parsing the file, failing to write the cache is not an error
+   */
+  void setCache(const std::string &directory)
+  {
+    m_isCaching = true;
+    m_cacheDirectory = directory;
+  }
+  bool isReloading() const { return m_isReloading; }
+
+  /*
+   * description of the last `load` failure, empty if the document itself could not be read
+   */
+  const std::string &getError() const { return m_error; }
+
+  /*
+   * memory limits are in bytes, 0 means unlimited
+   * the per-table default and the process-wide limit are initialised from
+   * PLIST_MEMORY_LIMIT and PLIST_GLOBAL_MEMORY_LIMIT environment variables
+   * a snapshot shared by several tables (see `load`) counts once towards the process total
+   */
+  void setMemoryLimit(size_t limit) { m_memoryLimit = limit; }
+  size_t getMemoryLimit() const { return m_memoryLimit; }
+  size_t getMemoryUsage() const { return m_memoryUsage; }
+
+  static void setDefaultMemoryLimit(size_t);
+  static size_t getDefaultMemoryLimit();
+  static void setGlobalMemoryLimit(size_t);
+  static size_t getGlobalMemoryLimit();
+  static size_t getTotalMemoryUsage();
+
+  /*
+   * writes are supported for tables over a file (optionally below a dictionary-only key path) whose rows are an
+   * array of dictionaries, nested dictionaries are fine but arrays inside the rows aren't, depth must be unlimited
+   * changes are buffered for the duration of the transaction, scans within it keep seeing the rows it began with and
+   * the changes are rebuilt into rows once on commit
+   * on `sync` the whole document is written back in its own format (XML for formats only CoreFoundation reads)
+   * through a temporary file renamed over the original, so readers never see a partially written file, a rollback
+   * after that writes the original bytes back
+   * rowids are the row numbers of the transaction's scans (inserted rows follow them), they shift once deleted rows
+   * are gone from a scan after commit
+   * columns are written to the key paths they were flattened from, a value for a column that more than one key path
+   * flattens to (keys differing in case, or nested keys against ones containing a dot) is rejected
+   */
+  void setWritable(bool writable) { m_isWritable = writable; }
+  bool isWritable() const { return m_isWritable; }
+
+  bool begin();
+  bool insert(const std::vector<Cell> &values, int64_t &rowid);
+  bool update(const int64_t rowid, const std::vector<Cell> &values);
+  bool remove(const int64_t rowid);
+  bool sync();
+  void commit();
+  void rollback();
+
+  /*
+   * rows materialized into the database by `CREATE VIRTUAL TABLE ... materialize=1`, scans read those instead
+   */
+  void setShadow(const std::shared_ptr<ShadowTable> &shadow) { m_shadow = shadow; }
+  const std::shared_ptr<ShadowTable> &getShadow() const { return m_shadow; }
 
   sqlite3_vtab *getRef() { return &m_vtab; }
 
@@ -22,11 +249,120 @@ private:
   sqlite3_vtab m_vtab;
 
   bool load(const Plist &, int);
+  Plist unarchive(const std::shared_ptr<const Buffer> &) const;
+  bool build(const Plist &, int, Table<Cell> &);
+  void publish(const Table<Cell> &);
+  void publish(const std::shared_ptr<const Snapshot> &);
+  void reload(const Fingerprint &);
+  bool checkReload(const Fingerprint &);
+  bool loadSample(const Plist &, int);
+  bool loadStream();
+  void addResidual(Table<Cell> &) const;
+
+  /*
+   * dictionary or array being flattened by getTable, the tables of the values below it are merged into `table` as
+   * they complete
+   */
+  struct FlattenFrame
+  {
+    Cell cell;
+    Cell expanded;
+    int depth;
+    size_t prefix;
+    size_t name;
+    size_t level;
+    size_t index;
+    Cell::Row::const_iterator it;
+    Table<Cell> table;
+    std::vector<std::vector<Cell> *> columns;
+  };
+
+  /*
+   * value of a dictionary visited by getRecord, its field is named once it's reached
+   */
+  struct RecordEntry
+  {
+    const Cell *cell;
+    const std::string *key;
+    size_t parent;
+    int depth;
+  };
+
+  Table<Cell> getTable(const Plist &, int, const size_t);
+  bool openFrame(const Cell &, int, const size_t, const size_t, Table<Cell> &);
+  bool nextChild(FlattenFrame &, Cell &, int &, size_t &, size_t &);
+  bool getRecord(const Cell &, int, const size_t, std::vector<std::pair<size_t, const Cell *>> &);
+  void appendValue(std::vector<Cell> &, const size_t, const Cell &);
+
+  bool reserveMemory(size_t, const char *);
+  void releaseMemory();
+  bool isWithinMemoryLimit(const Snapshot &, std::string &) const;
 
-  static Table<Cell> getTable(const Plist &, int, const std::string & = "");
-  static Table<Cell> getRowTable(const Cell::Row &, int, const std::string &);
-  static Table<Cell> getColumnTable(const Cell::Column &, int, const std::string &, const size_t = 0);
+  std::string getCachePath() const;
+  std::string getVariant() const;
+  std::string getSourceKey(const Fingerprint &) const;
+  std::shared_ptr<const TableCache> openCache(const Fingerprint &) const;
+  void storeCache(const Fingerprint &, const Table<Cell> &) const;
+  bool isShared() const { return !m_isWritable && m_sample == 0 && !m_isStreaming; }
 
-  Table<Cell> m_table;
+  bool getElement(const int64_t rowid, size_t &) const;
+  void setElements(const Cell::Column &);
+  void collectKeys(const Cell::Column &elements);
+  bool getFieldKeys(const Cell &element, const size_t column, std::vector<std::string> &keys);
+  bool hasField(const Cell &element, const size_t column) const;
+  bool rebuild();
+  void endTransaction();
+
+  std::shared_ptr<const Snapshot> m_snapshot;
   std::vector<std::string> m_fields;
+  std::vector<TypedColumn::Type> m_types;
+  FieldNames m_fieldNames;
+
+  std::string m_path;
+  std::string m_keyPath;
+  int m_depth = 0;
+  Fingerprint m_fingerprint;
+  Fingerprint m_failedFingerprint;
+  std::string m_reloadError;
+  ReloadMode m_reloadMode = RELOAD_SYNC;
+  bool m_isNested = false;
+  size_t m_sample = 0;
+  bool m_isStreaming = false;
+  bool m_isSampled = false;
+  size_t m_elementCount = 0;
+  std::thread m_rowLoader;
+  bool m_isRowLoadFailed = false;
+  std::string m_rowLoadError;
+  bool m_isArchive = false;
+  bool m_isCaching = false;
+  std::string m_cacheDirectory;
+  std::atomic<bool> m_isReloading{false};
+  std::thread m_reloader;
+  std::mutex m_mutex;
+
+  std::string m_error;
+  size_t m_memoryLimit = getDefaultMemoryLimit();
+  std::atomic<size_t> m_memoryUsage{0};
+  size_t m_valueUsage = 0;
+  std::atomic<size_t> m_reservedMemory{0};
+  bool m_failed = false;
+  std::vector<FlattenFrame> m_frames;
+  size_t m_frameCount = 0;
+  std::vector<std::pair<size_t, const Cell *>> m_record;
+  std::vector<RecordEntry> m_recordEntries;
+
+  bool m_isWritable = false;
+  bool m_inTransaction = false;
+  bool m_isChanged = false;
+  bool m_isDirty = false;
+  bool m_isWritten = false;
+  Cell m_document;
+  std::shared_ptr<const Buffer> m_source;
+  std::vector<Cell> m_elements;
+  std::vector<size_t> m_rowElements;
+  std::map<std::string, std::vector<std::vector<std::string>>> m_fieldKeys;
+  std::shared_ptr<const Snapshot> m_committedSnapshot;
+  size_t m_committedMemoryUsage = 0;
+
+  std::shared_ptr<ShadowTable> m_shadow;
 };
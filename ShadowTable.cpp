@@ -0,0 +1,190 @@
+#include <algorithm>
+#include "Functions.hpp"
+#include "PlistTable.hpp"
+#include "ShadowTable.hpp"
+#include "Trace.hpp"
+
+#include <sqlite3ext.h>
+
+SQLITE_EXTENSION_INIT3
+
+static std::string ShadowTableQuote(const std::string &identifier)
+{
+  std::string quoted = "\"";
+  for (auto character : identifier) {
+    quoted += character == '"' ? "\"\"" : std::string(1, character);
+  }
+  return quoted + "\"";
+}
+
+ShadowTable::ShadowTable(sqlite3 *db, const std::string &schema, const std::string &name)
+  : m_db(db), m_schema(schema), m_name(name)
+{
+}
+
+std::string ShadowTable::getTableName(const char *suffix) const
+{
+  return ShadowTableQuote(m_schema) + "." + ShadowTableQuote(m_name + suffix);
+}
+
+std::string ShadowTable::getColumnName(const size_t column) const
+{
+  return ShadowTableQuote(m_columns[column]);
+}
+
+bool ShadowTable::execute(const std::string &sql)
+{
+  char *error = NULL;
+  if (sqlite3_exec(m_db, sql.c_str(), NULL, NULL, &error) != SQLITE_OK) {
+    m_error = error != NULL ? error : sqlite3_errmsg(m_db);
+    sqlite3_free(error);
+    return false;
+  }
+  return true;
+}
+
+bool ShadowTable::create(const std::vector<std::string> &columns, const std::vector<std::string> &types,
+                         const std::vector<std::string> &indexes)
+{
+  TRACE_SCOPE("ShadowTable::create");
+  for (auto &column : columns) {
+    // "<name>_rows" keeps the row numbers as its rowid
+    if (sqlite3_stricmp(column.c_str(), "rowid") == 0 || sqlite3_stricmp(column.c_str(), "oid") == 0 ||
+        sqlite3_stricmp(column.c_str(), "_rowid_") == 0) {
+      m_error = "field '" + column + "' can't be materialized, it's named like the rowid";
+      return false;
+    }
+  }
+  m_columns = columns;
+  m_types = types;
+  m_types.resize(columns.size());
+  std::string definition;
+  for (size_t column = 0; column < columns.size(); column++) {
+    definition += (column == 0 ? "" : ", ") + ShadowTableQuote(columns[column]);
+    definition += m_types[column].empty() ? "" : " " + m_types[column];
+  }
+  if (!execute("CREATE TABLE " + getTableName("_rows") + "(" + definition + ")") ||
+      !execute("CREATE TABLE " + getTableName("_source") + "(key TEXT PRIMARY KEY, value)")) {
+    return false;
+  }
+  for (auto &index : indexes) {
+    if (std::find(columns.begin(), columns.end(), index) == columns.end()) {
+      m_error = "no field '" + index + "' to index";
+      return false;
+    }
+    const auto name = ShadowTableQuote(m_schema) + "." + ShadowTableQuote(m_name + "_rows_" + index);
+    if (!execute("CREATE INDEX " + name + " ON " + ShadowTableQuote(m_name + "_rows") + "(" + ShadowTableQuote(index) + ")")) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ShadowTable::open()
+{
+  sqlite3_stmt *statement = NULL;
+  if (sqlite3_prepare_v2(m_db, ("SELECT value FROM " + getTableName("_source") + " WHERE key = 'source'").c_str(), -1,
+                         &statement, NULL) != SQLITE_OK) {
+    m_error = sqlite3_errmsg(m_db);
+    return false;
+  }
+  if (sqlite3_step(statement) == SQLITE_ROW) {
+    const char *value = (const char *)sqlite3_column_text(statement, 0);
+    m_sourceKey = value != NULL ? value : "";
+  }
+  sqlite3_finalize(statement);
+
+  if (sqlite3_prepare_v2(m_db, ("SELECT * FROM " + getTableName("_rows") + " LIMIT 0").c_str(), -1, &statement,
+                         NULL) != SQLITE_OK) {
+    m_error = sqlite3_errmsg(m_db);
+    return false;
+  }
+  m_columns.clear();
+  m_types.clear();
+  for (int column = 0; column < sqlite3_column_count(statement); column++) {
+    const char *type = sqlite3_column_decltype(statement, column);
+    m_columns.push_back(sqlite3_column_name(statement, column));
+    m_types.push_back(type != NULL ? type : "");
+  }
+  sqlite3_finalize(statement);
+  return true;
+}
+
+bool ShadowTable::store(const PlistTable &table, const std::string &sourceKey)
+{
+  TRACE_SCOPE("ShadowTable::store");
+
+  std::string names = "rowid", parameters = "?";
+  std::vector<size_t> fields;
+  const auto &tableFields = table.getFields();
+  for (size_t column = 0; column < m_columns.size(); column++) {
+    names += ", " + getColumnName(column);
+    parameters += ", ?";
+    fields.push_back(std::find(tableFields.begin(), tableFields.end(), m_columns[column]) - tableFields.begin());
+  }
+
+  sqlite3_stmt *statement = NULL;
+  bool isStored = execute("DELETE FROM " + getTableName("_rows")) &&
+                  sqlite3_prepare_v2(m_db, ("INSERT INTO " + getTableName("_rows") + "(" + names + ") VALUES(" +
+                                            parameters + ")").c_str(), -1, &statement, NULL) == SQLITE_OK;
+  const auto snapshot = table.getSnapshot();
+  for (size_t row = 0; isStored && row < snapshot->getHeight(); row++) {
+    sqlite3_bind_int64(statement, 1, (sqlite3_int64)row);
+    for (size_t column = 0; column < fields.size(); column++) {
+      CellToSQLiteParameter(statement, (int)column + 2, snapshot->getCell(row, fields[column]));
+    }
+    isStored = sqlite3_step(statement) == SQLITE_DONE && sqlite3_reset(statement) == SQLITE_OK;
+  }
+  sqlite3_finalize(statement);
+
+  if (isStored && sqlite3_prepare_v2(m_db, ("INSERT OR REPLACE INTO " + getTableName("_source") +
+                                            "(key, value) VALUES('source', ?)").c_str(), -1, &statement, NULL) == SQLITE_OK) {
+    sqlite3_bind_text(statement, 1, sourceKey.c_str(), (int)sourceKey.size(), SQLITE_TRANSIENT);
+    isStored = sqlite3_step(statement) == SQLITE_DONE;
+    sqlite3_finalize(statement);
+  }
+  else {
+    isStored = false;
+  }
+
+  if (!isStored) {
+    m_error = sqlite3_errmsg(m_db);
+    return false;
+  }
+  m_sourceKey = sourceKey;
+  return true;
+}
+
+bool ShadowTable::rename(const std::string &name)
+{
+  const auto rows = ShadowTableQuote(name + "_rows"), source = ShadowTableQuote(name + "_source");
+  if (!execute("ALTER TABLE " + getTableName("_rows") + " RENAME TO " + rows) ||
+      !execute("ALTER TABLE " + getTableName("_source") + " RENAME TO " + source)) {
+    return false;
+  }
+  m_name = name;
+  return true;
+}
+
+bool ShadowTable::destroy()
+{
+  return execute("DROP TABLE IF EXISTS " + getTableName("_rows")) &&
+         execute("DROP TABLE IF EXISTS " + getTableName("_source"));
+}
+
+sqlite3_stmt *ShadowTable::select(const std::string &where) const
+{
+  std::string sql = "SELECT rowid";
+  for (size_t column = 0; column < m_columns.size(); column++) {
+    sql += ", " + getColumnName(column);
+  }
+  sql += " FROM " + getTableName("_rows");
+  if (!where.empty()) {
+    sql += " WHERE " + where;
+  }
+  sqlite3_stmt *statement = NULL;
+  if (sqlite3_prepare_v2(m_db, sql.c_str(), -1, &statement, NULL) != SQLITE_OK) {
+    return NULL;
+  }
+  return statement;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <sqlite3.h>
+
+class PlistTable;
+
+/*
+ * rows of a plist table materialized into ordinary tables of the database the virtual table lives in
+ *   "<name>_rows": rowid (the row number) and one column per field, indexes on it are real SQLite indexes
+ *   "<name>_source": key/value pairs describing what the rows were built from
+ * the rows are replaced only when the source key (the file's fingerprint and the table options) changes
+ */
+class ShadowTable
+{
+public:
+  ShadowTable(sqlite3 *db, const std::string &schema, const std::string &name);
+
+  /*
+   * creates both tables, the columns declared with `types` (empty for none), plus an index on "<name>_rows" for
+   * every field in `indexes`, fails for columns named like the rowid (rowid, oid, _rowid_)
+   */
+  bool create(const std::vector<std::string> &columns, const std::vector<std::string> &types,
+              const std::vector<std::string> &indexes);
+
+  /*
+   * reads the columns and source key of existing shadow tables, false if there are none
+   */
+  bool open();
+
+  const std::vector<std::string> &getColumns() const { return m_columns; }
+  const std::vector<std::string> &getTypes() const { return m_types; }
+  const std::string &getSourceKey() const { return m_sourceKey; }
+
+  /*
+   * replaces the rows with the current snapshot of `table` (matched to the columns by field name) and records
+   * `sourceKey`, it runs from xCreate/xFilter, so it's part of the transaction of the statement being executed
+   * (savepoints can't be opened there), the source key is written last, so a partial store is redone by the next scan
+   */
+  bool store(const PlistTable &table, const std::string &sourceKey);
+
+  bool rename(const std::string &name);
+  bool destroy();
+
+  /*
+   * statement over the rows returning the rowid followed by all columns, `where` is an SQL expression over the
+   * columns with `?` parameters (or empty), the caller binds, steps and finalizes it
+   */
+  sqlite3_stmt *select(const std::string &where) const;
+
+  /*
+   * scans reading the rows, `store` isn't run while there are any (e.g. the other side of a self join), the rows
+   * would be deleted and re-inserted under them
+   */
+  void beginScan() { m_scanCount++; }
+  void endScan() { m_scanCount--; }
+  bool isScanned() const { return m_scanCount > 0; }
+
+  /*
+   * quoted name of the column, for `where` expressions
+   */
+  std::string getColumnName(const size_t column) const;
+
+  const std::string &getError() const { return m_error; }
+  sqlite3 *getDatabase() const { return m_db; }
+
+private:
+  bool execute(const std::string &sql);
+  std::string getTableName(const char *suffix) const;
+
+  sqlite3 *m_db;
+  std::string m_schema;
+  std::string m_name;
+  std::vector<std::string> m_columns;
+  std::vector<std::string> m_types;
+  std::string m_sourceKey;
+  std::string m_error;
+  size_t m_scanCount = 0;
+};
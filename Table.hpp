@@ -1,7 +1,11 @@
 #pragma once
 
+#include <iterator>
+#include <limits>
+#include <utility>
 #include <vector>
 #include "Cell.hpp"
+#include "Trace.hpp"
 
 template<typename T>
 class Table
@@ -27,6 +31,55 @@ public:
 
   const std::map<std::string, std::vector<T>> &getTable() const { return m_table; }
 
+  /*
+   * bytes used by the column storage, values are accounted for by their owners
+   */
+  size_t memoryUsage() const
+  {
+    size_t usage = m_fields.capacity() * sizeof(std::string);
+    for (auto &it : m_table) {
+      usage += ColumnOverhead + it.second.capacity() * sizeof(T);
+      if (it.first.capacity() >= sizeof(std::string)) {
+        usage += 2 * (it.first.capacity() + 1);
+      }
+    }
+    return usage;
+  }
+
+  static size_t memoryUsage(const size_t width, const size_t height)
+  {
+    static const size_t max = std::numeric_limits<size_t>::max();
+    if (height > (max - ColumnOverhead) / sizeof(T)) {
+      return width == 0 ? 0 : max;
+    }
+    const size_t column = ColumnOverhead + height * sizeof(T);
+    return width > max / column ? max : width * column;
+  }
+
+  /*
+   * projected `memoryUsage` of the result of `join`/`combine`, computed without touching the columns
+   * so callers can refuse to grow the table before anything is allocated
+   */
+  size_t joinedMemoryUsage(const Table<T> &other) const
+  {
+    size_t width = m_fields.size();
+    for (auto &it : other.m_table) {
+      width += m_table.find(it.first) == m_table.end() ? 1 : 0;
+    }
+    return memoryUsage(width, m_height + other.m_height);
+  }
+
+  size_t combinedMemoryUsage(const Table<T> &other) const
+  {
+    if (m_height == 0 || other.m_height == 0) {
+      return m_height == 0 ? other.memoryUsage() : memoryUsage();
+    }
+    if (m_height > std::numeric_limits<size_t>::max() / other.m_height) {
+      return std::numeric_limits<size_t>::max();
+    }
+    return memoryUsage(m_fields.size() + other.m_fields.size(), m_height * other.m_height);
+  }
+
   /*
    *                                         a   b   c   aa   bb
    *                                       -----------------------
@@ -54,8 +107,9 @@ public:
    *                                       | 13 | - | - | 14 |
    *                                       -------------------
    */
-  void join(const Table<T> &other)
+  void join(Table<T> other)
   {
+    TRACE_SCOPE("Table::join");
     static const T defaultValue = {};
     for (auto &it : m_table) {
       it.second.resize(m_height + other.m_height);
@@ -63,7 +117,7 @@ public:
     for (auto &it : other.m_table) {
       auto &column = m_table[it.first];
       column.resize(m_height, defaultValue);
-      column.insert(column.end(), it.second.begin(), it.second.end());
+      column.insert(column.end(), std::make_move_iterator(it.second.begin()), std::make_move_iterator(it.second.end()));
       if (std::find(m_fields.begin(), m_fields.end(), it.first) == m_fields.end()) {
         m_fields.push_back(it.first);
       }
@@ -89,33 +143,64 @@ public:
    *
    * this method, unlike `join`, is not intended to work with tables that 'share' columns
    */
-  void combine(const Table<T> &other)
+  void combine(Table<T> other)
   {
+    TRACE_SCOPE("Table::combine");
     if (other.m_height == 0) {
       return;
     }
     if (m_height == 0) {
-      m_table = other.m_table;
-      m_height = other.m_height;
-      m_fields = other.m_fields;
+      *this = std::move(other);
       return;
     }
 
     for (auto &it : m_table) {
+      // inserting a range of the column into itself would read through iterators invalidated by the reallocation
       auto &column = it.second;
+      column.reserve(m_height * other.m_height);
       for (size_t i = 1; i < other.m_height; i++) {
-        column.insert(column.end(), column.begin(), column.begin() + m_height);
+        for (size_t row = 0; row < m_height; row++) {
+          column.push_back(column[row]);
+        }
       }
     }
     for (auto &it : other.m_table) {
       auto &column = m_table[it.first];
-      std::for_each(it.second.begin(), it.second.end(), [&](const T &item) { column.insert(column.end(), m_height, item); });
+      if (m_height == 1) {
+        column.insert(column.end(), std::make_move_iterator(it.second.begin()), std::make_move_iterator(it.second.end()));
+      }
+      else {
+        std::for_each(it.second.begin(), it.second.end(), [&](const T &item) { column.insert(column.end(), m_height, item); });
+      }
       m_fields.push_back(it.first);
     }
 
     m_height *= other.m_height;
   }
 
+  /*
+   * in-place alternative to joining one-row tables: values of the next row are appended to the columns returned by
+   * `addColumn` (added, filled with default values, if the field is missing) and `addRow` completes the row,
+   * columns the row has no value for get the default value
+   */
+  std::vector<T> &addColumn(const std::string &field)
+  {
+    auto it = m_table.find(field);
+    if (it == m_table.end()) {
+      it = m_table.insert({field, std::vector<T>(m_height)}).first;
+      m_fields.push_back(field);
+    }
+    return it->second;
+  }
+
+  void addRow()
+  {
+    m_height++;
+    for (auto &it : m_table) {
+      it.second.resize(m_height);
+    }
+  }
+
   const std::vector<T> &operator[](const std::string &field) const
   {
     if (m_table.find(field) != m_table.end()) {
@@ -126,6 +211,8 @@ public:
   }
 
 private:
+  static const size_t ColumnOverhead = 4 * sizeof(void *) + sizeof(std::pair<const std::string, std::vector<T>>) + sizeof(std::string);
+
   std::map<std::string, std::vector<T>> m_table;
   size_t m_height = 0;
   std::vector<std::string> m_fields;
@@ -0,0 +1,328 @@
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+#include "TableCache.hpp"
+#include "Trace.hpp"
+
+static const char TableCacheMagic[8] = {'P', 'L', 'I', 'S', 'T', 'T', 'B', 'L'};
+static const uint32_t TableCacheVersion = 2;
+static const uint32_t TableCacheByteOrder = 0x01020304;
+
+enum TableCacheType
+{
+  TableCacheNull,
+  TableCacheInteger,
+  TableCacheReal,
+  TableCacheText,
+  TableCacheBlob,
+  TableCacheBoolean,
+  TableCacheDate,
+};
+
+/*
+ * the directory (key, then name, column type, types and values offsets of every column) follows the header, column data and the
+ * heap follow the directory, everything is in the byte order of the machine that wrote the file
+ */
+struct TableCacheHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint64_t height;
+  uint64_t width;
+  uint64_t directorySize;
+  uint64_t heapOffset;
+  uint64_t heapSize;
+  uint64_t fileSize;
+  uint64_t checksum;
+};
+
+static uint64_t TableCacheHash(const void *data, const size_t size, uint64_t hash = 14695981039346656037ULL)
+{
+  const uint8_t *bytes = (const uint8_t *)data;
+  for (size_t index = 0; index < size; index++) {
+    hash = (hash ^ bytes[index]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+static uint64_t TableCacheChecksum(TableCacheHeader header, const void *directory)
+{
+  header.checksum = 0;
+  return TableCacheHash(directory, header.directorySize, TableCacheHash(&header, sizeof(header)));
+}
+
+static size_t TableCacheAlign(const size_t size)
+{
+  return (size + 7) & ~(size_t)7;
+}
+
+static void TableCacheAppend(std::string &bytes, const void *data, const size_t size)
+{
+  bytes.append((const char *)data, size);
+}
+
+static void TableCacheAppendString(std::string &bytes, const std::string &string)
+{
+  const uint32_t length = (uint32_t)string.size();
+  TableCacheAppend(bytes, &length, sizeof(length));
+  bytes.append(string);
+}
+
+/*
+ * bounds-checked reader over the directory
+ */
+struct TableCacheReader
+{
+  const uint8_t *data;
+  size_t size;
+  size_t offset;
+
+  bool read(void *value, const size_t length)
+  {
+    if (length > size - offset) {
+      return false;
+    }
+    std::memcpy(value, data + offset, length);
+    offset += length;
+    return true;
+  }
+
+  bool read(std::string &string)
+  {
+    uint32_t length;
+    if (!read(&length, sizeof(length)) || length > size - offset) {
+      return false;
+    }
+    string.assign((const char *)data + offset, length);
+    offset += length;
+    return true;
+  }
+};
+
+std::string TableCache::getPath(const std::string &directory, const std::string &source, const std::string &variant)
+{
+  std::string absolute = source;
+  char *resolved = realpath(source.c_str(), NULL);
+  if (resolved != NULL) {
+    absolute = resolved;
+    free(resolved);
+  }
+  const uint64_t hash = TableCacheHash(variant.data(), variant.size(), TableCacheHash(absolute.c_str(), absolute.size() + 1));
+  char suffix[32];
+  snprintf(suffix, sizeof(suffix), ".%016llx.plistcache", (unsigned long long)hash);
+  if (directory.empty()) {
+    return absolute + suffix;
+  }
+  const size_t slash = absolute.rfind('/');
+  const auto name = slash == std::string::npos ? absolute : absolute.substr(slash + 1);
+  return directory + (directory.back() == '/' ? "" : "/") + name + suffix;
+}
+
+bool TableCache::serialize(const Table<Cell> &table, const std::string &key, std::string &bytes)
+{
+  TRACE_SCOPE("TableCache::serialize");
+  const auto &fields = table.getFields();
+  const size_t height = table.getHeight();
+
+  TableCacheHeader header;
+  std::memcpy(header.magic, TableCacheMagic, sizeof(header.magic));
+  header.version = TableCacheVersion;
+  header.byteOrder = TableCacheByteOrder;
+  header.height = height;
+  header.width = fields.size();
+
+  // offsets in the directory are fixed-size, so the layout is known before anything is written
+  size_t directorySize = sizeof(uint32_t) + key.size();
+  for (auto &field : fields) {
+    directorySize += sizeof(uint32_t) + field.size() + sizeof(uint8_t) + 2 * sizeof(uint64_t);
+  }
+  header.directorySize = directorySize;
+  size_t offset = TableCacheAlign(sizeof(header) + directorySize);
+
+  std::string directory;
+  directory.reserve(directorySize);
+  TableCacheAppendString(directory, key);
+  std::vector<size_t> offsets;
+  for (auto &field : fields) {
+    const uint64_t types = offset;
+    const uint64_t values = TableCacheAlign(types + height);
+    offset = values + height * sizeof(uint64_t);
+    const uint8_t type = TypedColumn::infer(table[field]);
+    TableCacheAppendString(directory, field);
+    TableCacheAppend(directory, &type, sizeof(type));
+    TableCacheAppend(directory, &types, sizeof(types));
+    TableCacheAppend(directory, &values, sizeof(values));
+    offsets.push_back(types);
+    offsets.push_back(values);
+  }
+  header.heapOffset = offset;
+
+  bytes.assign(offset, '\0');
+  std::string heap;
+  std::unordered_map<std::string, uint64_t> entries;
+  static const Cell null;
+  for (size_t column = 0; column < fields.size(); column++) {
+    const auto &cells = table[fields[column]];
+    uint8_t *types = (uint8_t *)&bytes[offsets[2 * column]];
+    char *values = &bytes[offsets[2 * column + 1]];
+    for (size_t row = 0; row < height; row++) {
+      const Cell &cell = row < cells.size() ? cells[row] : null;
+      uint64_t value = 0;
+      switch (cell.type()) {
+        case Cell::NUL:
+          types[row] = TableCacheNull;
+          break;
+        case Cell::INTEGER:
+          types[row] = cell.isBoolean() ? TableCacheBoolean : TableCacheInteger;
+          value = (uint64_t)cell.integerValue();
+          break;
+        case Cell::REAL:
+          types[row] = cell.isDate() ? TableCacheDate : TableCacheReal;
+          std::memcpy(&value, &cell.realValue(), sizeof(value));
+          break;
+        case Cell::TEXT:
+        case Cell::BLOB: {
+          types[row] = cell.isText() ? TableCacheText : TableCacheBlob;
+          std::string data;
+          if (cell.isText()) {
+            data = cell.textValue();
+          }
+          else {
+            data.assign(cell.blobValue().begin(), cell.blobValue().end());
+          }
+          auto it = entries.find(data);
+          if (it == entries.end()) {
+            const uint64_t length = data.size();
+            it = entries.insert({data, heap.size()}).first;
+            TableCacheAppend(heap, &length, sizeof(length));
+            heap.append(data);
+            heap.resize(TableCacheAlign(heap.size()), '\0');
+          }
+          value = it->second;
+          break;
+        }
+        default:
+          return false;
+      }
+      std::memcpy(values + row * sizeof(value), &value, sizeof(value));
+    }
+  }
+  header.heapSize = heap.size();
+  bytes.append(heap);
+  header.fileSize = bytes.size();
+  header.checksum = TableCacheChecksum(header, directory.data());
+  std::memcpy(&bytes[0], &header, sizeof(header));
+  std::memcpy(&bytes[sizeof(header)], directory.data(), directory.size());
+  return true;
+}
+
+std::shared_ptr<const TableCache> TableCache::open(const std::string &path, const std::string &key)
+{
+  TRACE_SCOPE("TableCache::open");
+  auto buffer = Buffer::fromFile(path);
+  if (buffer == nullptr || buffer->size() < sizeof(TableCacheHeader)) {
+    return nullptr;
+  }
+  const uint8_t *data = buffer->data();
+  const size_t size = buffer->size();
+  TableCacheHeader header;
+  std::memcpy(&header, data, sizeof(header));
+  if (std::memcmp(header.magic, TableCacheMagic, sizeof(header.magic)) != 0 || header.version != TableCacheVersion ||
+      header.byteOrder != TableCacheByteOrder || header.fileSize != size ||
+      header.directorySize > size - sizeof(header) || header.checksum != TableCacheChecksum(header, data + sizeof(header))) {
+    return nullptr;
+  }
+
+  TableCacheReader reader{data + sizeof(header), (size_t)header.directorySize, 0};
+  std::string cacheKey;
+  if (!reader.read(cacheKey) || cacheKey != key || header.height > size / sizeof(uint64_t) ||
+      header.heapOffset > size || header.heapSize > size - header.heapOffset) {
+    return nullptr;
+  }
+
+  std::shared_ptr<TableCache> cache(new TableCache());
+  cache->m_height = (size_t)header.height;
+  for (uint64_t index = 0; index < header.width; index++) {
+    std::string field;
+    uint8_t type;
+    uint64_t types, values;
+    if (!reader.read(field) || !reader.read(&type, sizeof(type)) || type > TypedColumn::MIXED ||
+        !reader.read(&types, sizeof(types)) || !reader.read(&values, sizeof(values)) ||
+        types > size || header.height > size - types || values > size ||
+        header.height * sizeof(uint64_t) > size - values) {
+      return nullptr;
+    }
+    cache->m_fields.push_back(field);
+    cache->m_columns.push_back({(TypedColumn::Type)type, data + types, data + values});
+  }
+  cache->m_heap = data + header.heapOffset;
+  cache->m_heapSize = (size_t)header.heapSize;
+  cache->m_buffer = buffer;
+  return cache;
+}
+
+size_t TableCache::getColumn(const std::string &field) const
+{
+  for (size_t index = 0; index < m_fields.size(); index++) {
+    if (m_fields[index] == field) {
+      return index;
+    }
+  }
+  return m_fields.size();
+}
+
+TypedColumn::Type TableCache::getType(const size_t column) const
+{
+  return column < m_columns.size() ? m_columns[column].type : TypedColumn::NUL;
+}
+
+Cell TableCache::getCell(const size_t row, const size_t column) const
+{
+  if (row >= m_height || column >= m_columns.size()) {
+    return nullptr;
+  }
+  uint64_t value;
+  std::memcpy(&value, m_columns[column].values + row * sizeof(value), sizeof(value));
+  switch (m_columns[column].types[row]) {
+    case TableCacheInteger:
+      return (Cell::Integer)value;
+    case TableCacheBoolean:
+      return Cell::boolean(value != 0);
+    case TableCacheReal:
+    case TableCacheDate: {
+      Cell::Real real;
+      std::memcpy(&real, &value, sizeof(real));
+      return m_columns[column].types[row] == TableCacheDate ? Cell::date(real) : Cell(real);
+    }
+    case TableCacheText:
+    case TableCacheBlob: {
+      uint64_t length;
+      if (m_heapSize < sizeof(length) || value > m_heapSize - sizeof(length)) {
+        return nullptr;
+      }
+      std::memcpy(&length, m_heap + value, sizeof(length));
+      if (length > m_heapSize - value - sizeof(length)) {
+        return nullptr;
+      }
+      const uint8_t *bytes = m_heap + value + sizeof(length);
+      if (m_columns[column].types[row] == TableCacheText) {
+        return Cell::Text((const char *)bytes, (size_t)length);
+      }
+      return Cell::Blob(bytes, bytes + length);
+    }
+    default:
+      return nullptr;
+  }
+}
+
+size_t TableCache::memoryUsage() const
+{
+  size_t usage = m_columns.capacity() * sizeof(Column) + m_fields.capacity() * sizeof(std::string);
+  for (auto &field : m_fields) {
+    usage += field.capacity() >= sizeof(std::string) ? field.capacity() + 1 : 0;
+  }
+  return usage;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "Buffer.hpp"
+#include "Cell.hpp"
+#include "Table.hpp"
+#include "TypedColumn.hpp"
+
+/*
+ * flattened table persisted in a memory-mappable columnar file, so an unchanged document doesn't have to be parsed
+ * and flattened again by the next process
+ * every column is a vector of type tags followed by a vector of 8-byte values, texts and blobs are offsets into a
+ * shared, deduplicated heap, cells are decoded on access straight from the mapping
+ * the header and the column directory are checksummed, offsets into the data are bounds-checked on access
+ */
+class TableCache
+{
+public:
+  /*
+   * file next to `source`, or in `directory` if it's not empty, `variant` tells apart tables built differently from
+   * the same document (key path, depth, options)
+   */
+  static std::string getPath(const std::string &directory, const std::string &source, const std::string &variant);
+
+  /*
+   * returns nullptr unless the file exists, is intact and was written for `key`
+   */
+  static std::shared_ptr<const TableCache> open(const std::string &path, const std::string &key);
+
+  /*
+   * returns false if the table holds containers, which can't be cached
+   */
+  static bool serialize(const Table<Cell> &, const std::string &key, std::string &bytes);
+
+  size_t getHeight() const { return m_height; }
+  const std::vector<std::string> &getFields() const { return m_fields; }
+
+  /*
+   * column index of `field`, or getFields().size() if there is no such column
+   */
+  size_t getColumn(const std::string &field) const;
+
+  /*
+   * type shared by the values of the column, inferred when the file was written
+   */
+  TypedColumn::Type getType(const size_t column) const;
+  Cell getCell(const size_t row, const size_t column) const;
+
+  size_t memoryUsage() const;
+
+private:
+  TableCache() = default;
+
+  struct Column
+  {
+    TypedColumn::Type type;
+    const uint8_t *types;
+    const uint8_t *values;
+  };
+
+  std::shared_ptr<const Buffer> m_buffer;
+  size_t m_height = 0;
+  std::vector<std::string> m_fields;
+  std::vector<Column> m_columns;
+  const uint8_t *m_heap = nullptr;
+  size_t m_heapSize = 0;
+};
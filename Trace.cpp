@@ -0,0 +1,119 @@
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+#include <unistd.h>
+#include "Trace.hpp"
+
+struct TraceEvent
+{
+  const char *name;
+  uint64_t begin;
+  uint64_t end;
+  uint32_t thread;
+  const char *argument;
+  int64_t value;
+};
+
+static const size_t TraceFlushThreshold = 4096;
+
+static std::mutex s_mutex;
+static FILE *s_file = NULL;
+static std::string s_path;
+static std::vector<TraceEvent> s_events;
+static bool s_first = true;
+
+std::atomic<bool> Trace::s_enabled{false};
+
+static uint32_t TraceThreadId()
+{
+  static std::atomic<uint32_t> counter{0};
+  static thread_local uint32_t thread = ++counter;
+  return thread;
+}
+
+static void TraceFlush()
+{
+  if (s_file == NULL) {
+    s_events.clear();
+    return;
+  }
+  const int pid = (int)getpid();
+  for (auto &event : s_events) {
+    std::fprintf(s_file, "%s{\"name\":\"%s\",\"cat\":\"plist\",\"ph\":\"X\",\"ts\":%" PRIu64 ",\"dur\":%" PRIu64 ",\"pid\":%d,\"tid\":%u",
+                 s_first ? "" : ",\n", event.name, event.begin, event.end - event.begin, pid, event.thread);
+    if (event.argument != nullptr) {
+      std::fprintf(s_file, ",\"args\":{\"%s\":%" PRId64 "}", event.argument, event.value);
+    }
+    std::fputs("}", s_file);
+    s_first = false;
+  }
+  std::fflush(s_file);
+  s_events.clear();
+}
+
+bool Trace::start(const std::string &path)
+{
+  std::lock_guard<std::mutex> lock(s_mutex);
+  // a single trace is recorded at a time, starting it again is fine but not towards another file
+  if (s_file != NULL) {
+    return path == s_path;
+  }
+  s_file = std::fopen(path.c_str(), "w");
+  if (s_file == NULL) {
+    return false;
+  }
+  s_path = path;
+  std::fputs("[\n", s_file);
+  s_first = true;
+  static bool registered = false;
+  if (!registered) {
+    std::atexit(stop);
+    registered = true;
+  }
+  s_enabled.store(true, std::memory_order_relaxed);
+  return true;
+}
+
+bool Trace::startFromEnvironment()
+{
+  const char *path = std::getenv("PLIST_TRACE");
+  if (path == NULL || *path == '\0') {
+    return false;
+  }
+  return start(path);
+}
+
+void Trace::stop()
+{
+  s_enabled.store(false, std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lock(s_mutex);
+  TraceFlush();
+  if (s_file != NULL) {
+    std::fputs("\n]\n", s_file);
+    std::fclose(s_file);
+    s_file = NULL;
+    s_path.clear();
+  }
+}
+
+uint64_t Trace::now()
+{
+  using namespace std::chrono;
+  return (uint64_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void Trace::complete(const char *name, uint64_t begin, uint64_t end, const char *argument, int64_t value)
+{
+  const uint32_t thread = TraceThreadId();
+  std::lock_guard<std::mutex> lock(s_mutex);
+  if (s_file == NULL) {
+    return;
+  }
+  s_events.push_back({name, begin, end, thread, argument, value});
+  if (s_events.size() >= TraceFlushThreshold) {
+    TraceFlush();
+  }
+}
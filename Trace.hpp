@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/*
+ * Chrome trace-event recorder (chrome://tracing, Perfetto, speedscope)
+ * events are buffered in memory and appended to the output file in batches, the file uses the JSON array format
+ * which viewers accept even when the closing bracket is missing (e.g. the process was killed)
+ * when tracing is disabled every `Scope` costs a single relaxed atomic load
+ */
+class Trace
+{
+public:
+  /*
+   * truncates `path`, meant for trusted callers only (the host application, PLIST_TRACE)
+   * fails if the file can't be opened or a trace is already being recorded to another file
+   */
+  static bool start(const std::string &path);
+  static bool startFromEnvironment();
+  static void stop();
+
+  static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+  static uint64_t now();
+
+  static void complete(const char *name, uint64_t begin, uint64_t end, const char *argument = nullptr, int64_t value = 0);
+
+  class Scope
+  {
+  public:
+    Scope(const char *name) : m_name(isEnabled() ? name : nullptr), m_begin(m_name ? now() : 0) { }
+    ~Scope() { if (m_name) complete(m_name, m_begin, now()); }
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    const char *m_name;
+    uint64_t m_begin;
+  };
+
+private:
+  static std::atomic<bool> s_enabled;
+};
+
+#define TRACE_CONCAT_(a, b) a ## b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
@@ -0,0 +1,273 @@
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include "TypedColumn.hpp"
+#include "Trace.hpp"
+
+static const uint32_t TypedColumnNullCode = std::numeric_limits<uint32_t>::max();
+
+/*
+ * text of a cell being encoded, distinct values are found without copying them
+ */
+struct TypedColumnKey
+{
+  const char *data;
+  size_t size;
+
+  bool operator==(const TypedColumnKey &other) const
+  {
+    return size == other.size && std::memcmp(data, other.data, size) == 0;
+  }
+};
+
+struct TypedColumnKeyHash
+{
+  size_t operator()(const TypedColumnKey &key) const
+  {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t index = 0; index < key.size; index++) {
+      hash = (hash ^ (uint8_t)key.data[index]) * 1099511628211ULL;
+    }
+    return (size_t)hash;
+  }
+};
+
+static TypedColumn::Type TypedColumnGetType(const Cell &cell)
+{
+  switch (cell.type()) {
+    case Cell::NUL:
+      return TypedColumn::NUL;
+    case Cell::INTEGER:
+      return cell.isBoolean() ? TypedColumn::BOOLEAN : TypedColumn::INTEGER;
+    case Cell::REAL:
+      return cell.isDate() ? TypedColumn::DATE : TypedColumn::REAL;
+    case Cell::TEXT:
+      return TypedColumn::TEXT;
+    case Cell::BLOB:
+      return TypedColumn::BLOB;
+    default:
+      return TypedColumn::MIXED;
+  }
+}
+
+TypedColumn::Type TypedColumn::infer(const std::vector<Cell> &cells)
+{
+  Type type = NUL;
+  for (auto &cell : cells) {
+    const Type cellType = TypedColumnGetType(cell);
+    if (cellType == NUL || cellType == type) {
+      continue;
+    }
+    if (type != NUL || cellType == MIXED) {
+      return MIXED;
+    }
+    type = cellType;
+  }
+  return type;
+}
+
+const char *TypedColumn::getDeclaredType(const Type type)
+{
+  switch (type) {
+    case INTEGER:
+    case BOOLEAN:
+      return "INTEGER";
+    case REAL:
+    case DATE:
+      return "REAL";
+    case TEXT:
+      return "TEXT";
+    case BLOB:
+      return "BLOB";
+    default:
+      return "";
+  }
+}
+
+TypedColumn::TypedColumn(const std::vector<Cell> &cells) : m_type(infer(cells)), m_size(cells.size())
+{
+  TRACE_SCOPE("TypedColumn::TypedColumn");
+  if (m_type == NUL) {
+    return;
+  }
+  if (m_type == MIXED) {
+    m_cells = cells;
+    return;
+  }
+
+  m_nulls.assign((m_size + 63) / 64, 0);
+  if (m_type == TEXT && encode(cells)) {
+    for (size_t row = 0; row < m_size; row++) {
+      if (m_codes[row] == TypedColumnNullCode) {
+        m_nulls[row / 64] |= (uint64_t)1 << (row % 64);
+      }
+    }
+    return;
+  }
+  if (m_type == TEXT || m_type == BLOB) {
+    size_t bytes = 0;
+    for (auto &cell : cells) {
+      bytes += cell.isNull() ? 0 : m_type == TEXT ? cell.textValue().size() : cell.blobValue().size();
+    }
+    m_bytes.reserve(bytes);
+    m_offsets.reserve(m_size + 1);
+    m_offsets.push_back(0);
+  }
+  else if (m_type == INTEGER || m_type == BOOLEAN) {
+    m_integers.assign(m_size, 0);
+  }
+  else {
+    m_reals.assign(m_size, 0);
+  }
+
+  for (size_t row = 0; row < m_size; row++) {
+    const Cell &cell = cells[row];
+    if (cell.isNull()) {
+      m_nulls[row / 64] |= (uint64_t)1 << (row % 64);
+    }
+    else if (m_type == TEXT) {
+      m_bytes.append(cell.textValue());
+    }
+    else if (m_type == BLOB) {
+      m_bytes.append(cell.blobValue().begin(), cell.blobValue().end());
+    }
+    else if (!m_integers.empty()) {
+      m_integers[row] = cell.integerValue();
+    }
+    else {
+      m_reals[row] = cell.realValue();
+    }
+    if (!m_offsets.empty()) {
+      m_offsets.push_back(m_bytes.size());
+    }
+  }
+}
+
+bool TypedColumn::encode(const std::vector<Cell> &cells)
+{
+  TRACE_SCOPE("TypedColumn::encode");
+  const size_t limit = std::min(m_size / 2, (size_t)TypedColumnNullCode);
+  if (limit == 0) {
+    return false;
+  }
+  std::unordered_map<TypedColumnKey, uint32_t, TypedColumnKeyHash> codes;
+  m_codes.resize(m_size);
+  for (size_t row = 0; row < m_size; row++) {
+    if (cells[row].isNull()) {
+      m_codes[row] = TypedColumnNullCode;
+      continue;
+    }
+    const auto &text = cells[row].textValue();
+    const uint32_t code = (uint32_t)codes.size();
+    m_codes[row] = codes.insert({{text.data(), text.size()}, code}).first->second;
+    if (codes.size() > limit) {
+      std::vector<uint32_t>().swap(m_codes);
+      return false;
+    }
+  }
+
+  std::vector<const TypedColumnKey *> entries(codes.size());
+  size_t bytes = 0;
+  for (auto &it : codes) {
+    entries[it.second] = &it.first;
+    bytes += it.first.size;
+  }
+  m_bytes.reserve(bytes);
+  m_offsets.reserve(entries.size() + 1);
+  m_offsets.push_back(0);
+  for (auto entry : entries) {
+    m_bytes.append(entry->data, entry->size);
+    m_offsets.push_back(m_bytes.size());
+  }
+
+  // codes in the order of their values, so that `findCode` is a binary search
+  m_sortedCodes.resize(entries.size());
+  std::iota(m_sortedCodes.begin(), m_sortedCodes.end(), 0);
+  std::sort(m_sortedCodes.begin(), m_sortedCodes.end(), [this](const uint32_t left, const uint32_t right) {
+    return compare(left, m_bytes.data() + m_offsets[right], m_offsets[right + 1] - m_offsets[right]) < 0;
+  });
+  return true;
+}
+
+int TypedColumn::compare(const uint32_t code, const char *bytes, const size_t length) const
+{
+  const size_t size = m_offsets[code + 1] - m_offsets[code];
+  const int result = std::memcmp(m_bytes.data() + m_offsets[code], bytes, std::min(size, length));
+  return result != 0 ? result : size < length ? -1 : size > length ? 1 : 0;
+}
+
+bool TypedColumn::findCode(const char *bytes, const size_t length, uint32_t &code) const
+{
+  auto it = std::lower_bound(m_sortedCodes.begin(), m_sortedCodes.end(), 0, [&](const uint32_t entry, int) {
+    return compare(entry, bytes, length) < 0;
+  });
+  if (it == m_sortedCodes.end() || compare(*it, bytes, length) != 0) {
+    return false;
+  }
+  code = *it;
+  return true;
+}
+
+bool TypedColumn::isNull(const size_t row) const
+{
+  switch (m_type) {
+    case NUL:
+      return true;
+    case MIXED:
+      return m_cells[row].isNull();
+    default:
+      return (m_nulls[row / 64] >> (row % 64)) & 1;
+  }
+}
+
+const char *TypedColumn::getBytes(const size_t row, size_t &length) const
+{
+  const size_t entry = m_codes.empty() ? row : m_codes[row];
+  length = m_offsets[entry + 1] - m_offsets[entry];
+  return m_bytes.data() + m_offsets[entry];
+}
+
+Cell TypedColumn::getCell(const size_t row) const
+{
+  if (row >= m_size || isNull(row)) {
+    return nullptr;
+  }
+  size_t length;
+  switch (m_type) {
+    case INTEGER:
+      return m_integers[row];
+    case BOOLEAN:
+      return Cell::boolean(m_integers[row] != 0);
+    case REAL:
+      return m_reals[row];
+    case DATE:
+      return Cell::date(m_reals[row]);
+    case TEXT: {
+      const char *bytes = getBytes(row, length);
+      return Cell::Text(bytes, length);
+    }
+    case BLOB: {
+      const uint8_t *bytes = (const uint8_t *)getBytes(row, length);
+      return Cell::Blob(bytes, bytes + length);
+    }
+    default:
+      return m_cells[row];
+  }
+}
+
+size_t TypedColumn::memoryUsage() const
+{
+  size_t usage = sizeof(*this) + m_nulls.capacity() * sizeof(uint64_t) + m_integers.capacity() * sizeof(int64_t) +
+                 m_reals.capacity() * sizeof(double) + m_offsets.capacity() * sizeof(size_t) +
+                 m_codes.capacity() * sizeof(uint32_t) + m_sortedCodes.capacity() * sizeof(uint32_t) +
+                 m_cells.capacity() * sizeof(Cell);
+  if (m_bytes.capacity() >= sizeof(std::string)) {
+    usage += m_bytes.capacity() + 1;
+  }
+  for (auto &cell : m_cells) {
+    usage += cell.isNull() ? 0 : cell.memoryUsage();
+  }
+  return usage;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Cell.hpp"
+
+/*
+ * column of a loaded table, homogeneous columns are stored densely (integers and reals in arrays, texts and blobs
+ * back to back in one buffer) next to a null bitmap, only columns mixing types keep their cells
+ * booleans and dates are types of their own, so that writers and `getCell` keep telling them apart
+ * text columns repeating a few values (at most one distinct value per two rows) are dictionary encoded: every row
+ * holds the code of its value and every distinct value is stored once
+ */
+class TypedColumn
+{
+public:
+  enum Type
+  {
+    NUL, INTEGER, BOOLEAN, REAL, DATE, TEXT, BLOB, MIXED
+  };
+
+  explicit TypedColumn(const std::vector<Cell> &);
+
+  /*
+   * type shared by all the non-null cells, NUL if there are none
+   */
+  static Type infer(const std::vector<Cell> &);
+
+  /*
+   * type to declare the column with in the virtual table's schema, empty for NUL and MIXED columns
+   */
+  static const char *getDeclaredType(const Type);
+
+  Type getType() const { return m_type; }
+  size_t size() const { return m_size; }
+
+  bool isNull(const size_t row) const;
+  int64_t getInteger(const size_t row) const { return m_integers[row]; }
+  double getReal(const size_t row) const { return m_reals[row]; }
+  const char *getBytes(const size_t row, size_t &length) const;
+
+  bool isEncoded() const { return !m_codes.empty(); }
+  uint32_t getCode(const size_t row) const { return m_codes[row]; }
+
+  /*
+   * code of the text in an encoded column, false if no row holds it
+   */
+  bool findCode(const char *bytes, const size_t length, uint32_t &code) const;
+  const Cell &getMixed(const size_t row) const { return m_cells[row]; }
+
+  Cell getCell(const size_t row) const;
+
+  size_t memoryUsage() const;
+
+private:
+  bool encode(const std::vector<Cell> &);
+  int compare(const uint32_t code, const char *bytes, const size_t length) const;
+
+  Type m_type;
+  size_t m_size;
+  std::vector<uint64_t> m_nulls;
+  std::vector<int64_t> m_integers;
+  std::vector<double> m_reals;
+  std::vector<size_t> m_offsets;
+  std::string m_bytes;
+  std::vector<uint32_t> m_codes;
+  std::vector<uint32_t> m_sortedCodes;
+  std::vector<Cell> m_cells;
+};
@@ -0,0 +1,204 @@
+#include <algorithm>
+#include "Unicode.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+/*
+ * writes the UTF-8 form of `codePoint` (below U+110000), returns the end of what was written
+ */
+static char *UnicodeWriteUtf8(char *output, const uint32_t codePoint)
+{
+  if (codePoint < 0x80) {
+    *output++ = (char)codePoint;
+  }
+  else if (codePoint < 0x800) {
+    *output++ = (char)(0xC0 | (codePoint >> 6));
+    *output++ = (char)(0x80 | (codePoint & 0x3F));
+  }
+  else if (codePoint < 0x10000) {
+    *output++ = (char)(0xE0 | (codePoint >> 12));
+    *output++ = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+    *output++ = (char)(0x80 | (codePoint & 0x3F));
+  }
+  else {
+    *output++ = (char)(0xF0 | (codePoint >> 18));
+    *output++ = (char)(0x80 | ((codePoint >> 12) & 0x3F));
+    *output++ = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+    *output++ = (char)(0x80 | (codePoint & 0x3F));
+  }
+  return output;
+}
+
+void Unicode::appendUtf8(std::string &string, const uint32_t codePoint)
+{
+  char buffer[4];
+  string.append(buffer, UnicodeWriteUtf8(buffer, codePoint < 0x110000 ? codePoint : 0xFFFD));
+}
+
+template <bool isBigEndian>
+static uint32_t UnicodeGetUnit(const uint8_t *data, const size_t index)
+{
+  return isBigEndian ? (uint32_t)data[2 * index] << 8 | data[2 * index + 1]
+                     : (uint32_t)data[2 * index + 1] << 8 | data[2 * index];
+}
+
+/*
+ * length of the UTF-8 form of UTF-16, surrogates count 3 bytes each: exact without them, more than enough with them
+ * (a pair takes 4 bytes, a lone one is replaced with 3)
+ */
+template <bool isBigEndian>
+static size_t UnicodeCountUtf8(const uint8_t *data, const size_t units)
+{
+  size_t bytes = 0, index = 0;
+#if defined(__SSE2__)
+  // in the 16 bit lanes of a little-endian machine, the bytes of big-endian units are swapped
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i asciiMask = _mm_set1_epi16((short)(isBigEndian ? 0x80FF : 0xFF80));
+  const __m128i narrowMask = _mm_set1_epi16((short)(isBigEndian ? 0x00F8 : 0xF800));
+  for (; units - index >= 8; index += 8) {
+    const __m128i block = _mm_loadu_si128((const __m128i *)(data + 2 * index));
+    // 2 mask bits for every unit below U+0080, and for every unit below U+0800
+    const int ascii = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(block, asciiMask), zero));
+    const int narrow = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(block, narrowMask), zero));
+    bytes += 24 - (size_t)(__builtin_popcount((unsigned)ascii) + __builtin_popcount((unsigned)narrow)) / 2;
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  for (; units - index >= 16; index += 16) {
+    const uint8x16x2_t block = vld2q_u8(data + 2 * index);
+    const uint8x16_t high = block.val[isBigEndian ? 0 : 1], low = block.val[isBigEndian ? 1 : 0];
+    const uint8x16_t wide = vorrq_u8(vtstq_u8(high, high), vcgeq_u8(low, vdupq_n_u8(0x80)));
+    const uint8x16_t wider = vcgeq_u8(high, vdupq_n_u8(0x08));
+    bytes += 16 + vaddvq_u8(vandq_u8(wide, vdupq_n_u8(1))) + vaddvq_u8(vandq_u8(wider, vdupq_n_u8(1)));
+  }
+#endif
+  for (; index < units; index++) {
+    const uint32_t unit = UnicodeGetUnit<isBigEndian>(data, index);
+    bytes += unit < 0x80 ? 1 : unit < 0x800 ? 2 : 3;
+  }
+  return bytes;
+}
+
+template <bool isBigEndian>
+static void UnicodeAppendUtf16(std::string &string, const uint8_t *data, const size_t units)
+{
+  // sized once and written in place, then trimmed to what surrogate pairs saved
+  const size_t start = string.size();
+  string.resize(start + UnicodeCountUtf8<isBigEndian>(data, units));
+  char *output = &string[0] + start;
+  size_t index = 0;
+  while (index < units) {
+#if defined(__SSE2__)
+    // runs of 8 ASCII units
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i asciiMask = _mm_set1_epi16((short)(isBigEndian ? 0x80FF : 0xFF80));
+    for (; units - index >= 8; index += 8, output += 8) {
+      const __m128i block = _mm_loadu_si128((const __m128i *)(data + 2 * index));
+      if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(block, asciiMask), zero)) != 0xFFFF) {
+        break;
+      }
+      const __m128i lanes = isBigEndian ? _mm_srli_epi16(block, 8) : block;
+      _mm_storel_epi64((__m128i *)output, _mm_packus_epi16(lanes, zero));
+    }
+    const size_t blockUnits = 8;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    // runs of 16 ASCII units, or of 16 units of 3 bytes (most of CJK text)
+    while (units - index >= 16) {
+      const uint8x16x2_t block = vld2q_u8(data + 2 * index);
+      const uint8x16_t high = block.val[isBigEndian ? 0 : 1], low = block.val[isBigEndian ? 1 : 0];
+      if (vmaxvq_u8(high) == 0 && vmaxvq_u8(low) < 0x80) {
+        vst1q_u8((uint8_t *)output, low);
+        index += 16;
+        output += 16;
+        continue;
+      }
+      const uint8x16_t surrogates = vceqq_u8(vandq_u8(high, vdupq_n_u8(0xF8)), vdupq_n_u8(0xD8));
+      if (vminvq_u8(high) < 0x08 || vmaxvq_u8(surrogates) != 0) {
+        break;
+      }
+      uint8x16x3_t bytes;
+      bytes.val[0] = vorrq_u8(vshrq_n_u8(high, 4), vdupq_n_u8(0xE0));
+      bytes.val[1] = vorrq_u8(vshlq_n_u8(vandq_u8(high, vdupq_n_u8(0x0F)), 2), vshrq_n_u8(low, 6));
+      bytes.val[1] = vorrq_u8(bytes.val[1], vdupq_n_u8(0x80));
+      bytes.val[2] = vorrq_u8(vandq_u8(low, vdupq_n_u8(0x3F)), vdupq_n_u8(0x80));
+      vst3q_u8((uint8_t *)output, bytes);
+      index += 16;
+      output += 48;
+    }
+    const size_t blockUnits = 16;
+#else
+    const size_t blockUnits = units;
+#endif
+    // the block that stopped the vector loop, unit by unit
+    const size_t end = std::min(units, index + blockUnits);
+    while (index < end) {
+      uint32_t unit = UnicodeGetUnit<isBigEndian>(data, index++);
+      if (unit >= 0xD800 && unit < 0xE000) {
+        const uint32_t low = index < units ? UnicodeGetUnit<isBigEndian>(data, index) : 0;
+        if (unit < 0xDC00 && low >= 0xDC00 && low < 0xE000) {
+          unit = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+          index++;
+        }
+        else {
+          unit = 0xFFFD;
+        }
+      }
+      output = UnicodeWriteUtf8(output, unit);
+    }
+  }
+  string.resize((size_t)(output - string.data()));
+}
+
+void Unicode::appendUtf16BE(std::string &string, const uint8_t *data, const size_t units)
+{
+  UnicodeAppendUtf16<true>(string, data, units);
+}
+
+void Unicode::appendUtf16(std::string &string, const uint16_t *units, const size_t count)
+{
+  UnicodeAppendUtf16<__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__>(string, (const uint8_t *)units, count);
+}
+
+static void UnicodeAppendUnit(std::string &string, const uint32_t unit)
+{
+  string.push_back((char)(unit >> 8));
+  string.push_back((char)(unit & 0xFF));
+}
+
+size_t Unicode::encodeUtf16BE(std::string &string, const std::string &utf8)
+{
+  const uint8_t *data = reinterpret_cast<const uint8_t *>(utf8.data());
+  const size_t size = utf8.size();
+  size_t units = 0;
+  for (size_t index = 0; index < size;) {
+    const uint8_t lead = data[index];
+    size_t length = lead < 0x80 ? 1 : lead >= 0xC2 && lead < 0xE0 ? 2 : lead >= 0xE0 && lead < 0xF0 ? 3 : lead >= 0xF0 && lead < 0xF5 ? 4 : 0;
+    uint32_t codePoint = length == 1 ? lead : length == 2 ? lead & 0x1F : length == 3 ? lead & 0x0F : lead & 0x07;
+    bool isValid = length != 0 && index + length <= size;
+    for (size_t offset = 1; isValid && offset < length; offset++) {
+      isValid = (data[index + offset] & 0xC0) == 0x80;
+      codePoint = codePoint << 6 | (data[index + offset] & 0x3F);
+    }
+    // overlong forms, surrogates and values past U+10FFFF
+    isValid = isValid && !(length == 3 && codePoint < 0x800) && !(length == 4 && codePoint < 0x10000) &&
+              !(codePoint >= 0xD800 && codePoint < 0xE000) && codePoint < 0x110000;
+    if (!isValid) {
+      codePoint = 0xFFFD;
+      length = 1;
+    }
+    if (codePoint >= 0x10000) {
+      UnicodeAppendUnit(string, 0xD800 + ((codePoint - 0x10000) >> 10));
+      UnicodeAppendUnit(string, 0xDC00 + ((codePoint - 0x10000) & 0x3FF));
+      units += 2;
+    }
+    else {
+      UnicodeAppendUnit(string, codePoint);
+      units++;
+    }
+    index += length;
+  }
+  return units;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+class Unicode
+{
+public:
+  static void appendUtf8(std::string &, const uint32_t codePoint);
+
+  /*
+   * big-endian UTF-16 (bplist strings and keys), unpaired surrogates are replaced with U+FFFD
+   */
+  static void appendUtf16BE(std::string &, const uint8_t *data, const size_t units);
+
+  /*
+   * the same in the machine's byte order (the characters of a CFString)
+   */
+  static void appendUtf16(std::string &, const uint16_t *units, const size_t count);
+
+  /*
+   * the other way around, returns the number of units appended, malformed sequences are replaced with U+FFFD
+   */
+  static size_t encodeUtf16BE(std::string &, const std::string &utf8);
+};
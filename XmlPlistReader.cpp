@@ -0,0 +1,848 @@
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "XmlPlistReader.hpp"
+#include "Decimal.hpp"
+#include "Unicode.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/*
+ * the scanners below check 16 bytes at a time where the target has vector instructions (SSE2 on x86_64, NEON on
+ * arm64, both always available there), and byte by byte otherwise and for the last bytes of the buffer
+ * a block's mask has `XmlMaskBits` bits per byte, set for bytes that matched
+ */
+#if defined(__SSE2__)
+typedef __m128i XmlVector;
+static const unsigned XmlMaskBits = 1;
+static XmlVector XmlLoad(const char *data) { return _mm_loadu_si128((const __m128i *)data); }
+static XmlVector XmlEquals(const XmlVector block, const char character) { return _mm_cmpeq_epi8(block, _mm_set1_epi8(character)); }
+static XmlVector XmlOr(const XmlVector left, const XmlVector right) { return _mm_or_si128(left, right); }
+static uint64_t XmlMask(const XmlVector matches) { return (uint64_t)_mm_movemask_epi8(matches); }
+#elif defined(__ARM_NEON)
+typedef uint8x16_t XmlVector;
+static const unsigned XmlMaskBits = 4;
+static XmlVector XmlLoad(const char *data) { return vld1q_u8((const uint8_t *)data); }
+static XmlVector XmlEquals(const XmlVector block, const char character) { return vceqq_u8(block, vdupq_n_u8((uint8_t)character)); }
+static XmlVector XmlOr(const XmlVector left, const XmlVector right) { return vorrq_u8(left, right); }
+static uint64_t XmlMask(const XmlVector matches)
+{
+  // there's no movemask, narrowing keeps 4 bits of every byte
+  return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)), 0);
+}
+#endif
+
+static bool XmlIsSpace(const char character)
+{
+  return character == ' ' || character == '\t' || character == '\n' || character == '\r';
+}
+
+/*
+ * first offset at or after `offset` that isn't whitespace, `size` if there is none
+ */
+static size_t XmlSkipSpace(const char *data, const size_t size, size_t offset)
+{
+  if (offset < size && !XmlIsSpace(data[offset])) {
+    return offset;
+  }
+#if defined(__SSE2__) || defined(__ARM_NEON)
+  for (; size - offset >= 16; offset += 16) {
+    const XmlVector block = XmlLoad(data + offset);
+    const uint64_t spaces = XmlMask(XmlOr(XmlOr(XmlEquals(block, ' '), XmlEquals(block, '\t')),
+                                          XmlOr(XmlEquals(block, '\n'), XmlEquals(block, '\r'))));
+    const uint64_t others = ~spaces & (XmlMaskBits == 1 ? 0xFFFF : ~(uint64_t)0);
+    if (others != 0) {
+      return offset + (size_t)__builtin_ctzll(others) / XmlMaskBits;
+    }
+  }
+#endif
+  while (offset < size && XmlIsSpace(data[offset])) {
+    offset++;
+  }
+  return offset;
+}
+
+/*
+ * first offset at or after `offset` holding one of the characters of `set`, `size` if there is none
+ */
+template <size_t N>
+static size_t XmlFindAny(const char *data, const size_t size, size_t offset, const char (&set)[N])
+{
+#if defined(__SSE2__) || defined(__ARM_NEON)
+  for (; offset < size && size - offset >= 16; offset += 16) {
+    const XmlVector block = XmlLoad(data + offset);
+    XmlVector matches = XmlEquals(block, set[0]);
+    for (size_t index = 1; index < N - 1; index++) {
+      matches = XmlOr(matches, XmlEquals(block, set[index]));
+    }
+    const uint64_t mask = XmlMask(matches);
+    if (mask != 0) {
+      return offset + (size_t)__builtin_ctzll(mask) / XmlMaskBits;
+    }
+  }
+#endif
+  for (; offset < size; offset++) {
+    if (std::memchr(set, data[offset], N - 1) != NULL) {
+      return offset;
+    }
+  }
+  return size;
+}
+
+static bool XmlStartsWith(const char *data, const size_t size, const size_t offset, const char *prefix)
+{
+  const size_t length = std::strlen(prefix);
+  return offset <= size && size - offset >= length && std::memcmp(data + offset, prefix, length) == 0;
+}
+
+/*
+ * offset of `needle` at or after `offset`, `size` if there is none
+ */
+static size_t XmlFind(const char *data, const size_t size, size_t offset, const char *needle)
+{
+  while (offset < size) {
+    const char *found = (const char *)std::memchr(data + offset, needle[0], size - offset);
+    if (found == NULL) {
+      break;
+    }
+    offset = (size_t)(found - data);
+    if (XmlStartsWith(data, size, offset, needle)) {
+      return offset;
+    }
+    offset++;
+  }
+  return size;
+}
+
+static bool XmlAppendEntity(std::string &text, const char *entity, const size_t length)
+{
+  if (length >= 2 && entity[0] == '#') {
+    const bool isHex = entity[1] == 'x' || entity[1] == 'X';
+    uint32_t codePoint = 0;
+    for (size_t index = isHex ? 2 : 1; index < length; index++) {
+      const char character = entity[index];
+      uint32_t digit;
+      if (character >= '0' && character <= '9') {
+        digit = (uint32_t)(character - '0');
+      }
+      else if (isHex && character >= 'a' && character <= 'f') {
+        digit = (uint32_t)(character - 'a' + 10);
+      }
+      else if (isHex && character >= 'A' && character <= 'F') {
+        digit = (uint32_t)(character - 'A' + 10);
+      }
+      else {
+        return false;
+      }
+      codePoint = codePoint * (isHex ? 16 : 10) + digit;
+      if (codePoint > 0x10FFFF) {
+        return false;
+      }
+    }
+    Unicode::appendUtf8(text, codePoint);
+    return true;
+  }
+  static const struct
+  {
+    const char *name;
+    char character;
+  } entities[] = {{"lt", '<'}, {"gt", '>'}, {"amp", '&'}, {"quot", '"'}, {"apos", '\''}};
+  for (auto &it : entities) {
+    if (std::strlen(it.name) == length && std::memcmp(it.name, entity, length) == 0) {
+      text.push_back(it.character);
+      return true;
+    }
+  }
+  return false;
+}
+
+static void XmlTrim(const char *&data, size_t &size)
+{
+  while (size > 0 && XmlIsSpace(data[0])) {
+    data++;
+    size--;
+  }
+  while (size > 0 && XmlIsSpace(data[size - 1])) {
+    size--;
+  }
+}
+
+static bool XmlParseInteger(const char *data, size_t size, Cell::Integer &integer)
+{
+  XmlTrim(data, size);
+  size_t index = 0;
+  const bool isNegative = index < size && data[index] == '-';
+  if (index < size && (data[index] == '-' || data[index] == '+')) {
+    index++;
+  }
+  unsigned base = 10;
+  if (size - index > 2 && data[index] == '0' && (data[index + 1] == 'x' || data[index + 1] == 'X')) {
+    base = 16;
+    index += 2;
+  }
+  if (index == size) {
+    return false;
+  }
+  uint64_t value = 0;
+  for (; index < size; index++) {
+    const char character = data[index];
+    unsigned digit;
+    if (character >= '0' && character <= '9') {
+      digit = (unsigned)(character - '0');
+    }
+    else if (base == 16 && character >= 'a' && character <= 'f') {
+      digit = (unsigned)(character - 'a' + 10);
+    }
+    else if (base == 16 && character >= 'A' && character <= 'F') {
+      digit = (unsigned)(character - 'A' + 10);
+    }
+    else {
+      return false;
+    }
+    if (value > (UINT64_MAX - digit) / base) {
+      return false;
+    }
+    value = value * base + digit;
+  }
+  if (isNegative && value > (uint64_t)INT64_MAX + 1) {
+    return false;
+  }
+  // values above INT64_MAX are kept as their two's complement bit pattern, like CFNumberGetValue does
+  integer = isNegative ? (Cell::Integer)(0 - value) : (Cell::Integer)value;
+  return true;
+}
+
+static bool XmlParseReal(const char *data, size_t size, Cell::Real &real)
+{
+  XmlTrim(data, size);
+  return Decimal::parse(data, size, real);
+}
+
+static int64_t XmlDaysFromCivil(int64_t year, const int64_t month, const int64_t day)
+{
+  year -= month <= 2;
+  const int64_t era = (year >= 0 ? year : year - 399) / 400;
+  const int64_t yearOfEra = year - era * 400;
+  const int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  const int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  return era * 146097 + dayOfEra - 719468;
+}
+
+static bool XmlParseDigits(const char *data, const size_t count, int &value)
+{
+  value = 0;
+  for (size_t index = 0; index < count; index++) {
+    if (data[index] < '0' || data[index] > '9') {
+      return false;
+    }
+    value = value * 10 + (data[index] - '0');
+  }
+  return true;
+}
+
+/*
+ * `YYYY-MM-DDTHH:MM:SSZ`, converted to seconds since 2001-01-01T00:00:00Z (CFAbsoluteTime)
+ */
+static bool XmlParseDate(const char *data, size_t size, Cell::Real &real)
+{
+  XmlTrim(data, size);
+  int year, month, day, hour, minute, second;
+  if (size != 20 || !XmlParseDigits(data, 4, year) || data[4] != '-' || !XmlParseDigits(data + 5, 2, month) ||
+      data[7] != '-' || !XmlParseDigits(data + 8, 2, day) || data[10] != 'T' || !XmlParseDigits(data + 11, 2, hour) ||
+      data[13] != ':' || !XmlParseDigits(data + 14, 2, minute) || data[16] != ':' ||
+      !XmlParseDigits(data + 17, 2, second) || data[19] != 'Z' || month < 1 || month > 12 || day < 1 || day > 31) {
+    return false;
+  }
+  const int64_t days = XmlDaysFromCivil(year, month, day) - XmlDaysFromCivil(2001, 1, 1);
+  real = (Cell::Real)(days * 86400 + hour * 3600 + minute * 60 + second);
+  return true;
+}
+
+/*
+ * values of base64 characters, -1 outside the alphabet
+ */
+struct XmlBase64Table
+{
+  int8_t values[256];
+
+  XmlBase64Table()
+  {
+    const char *alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::memset(values, -1, sizeof(values));
+    for (int8_t value = 0; value < 64; value++) {
+      values[(uint8_t)alphabet[value]] = value;
+    }
+  }
+};
+
+/*
+ * 4 lanes of 24 bits, the first byte on top, to 12 bytes
+ * 13 bytes are written, the last one is garbage
+ */
+static void XmlStoreBase64Words(const uint32_t (&words)[4], uint8_t *bytes)
+{
+  for (size_t index = 0; index < 4; index++) {
+    const uint32_t word = __builtin_bswap32(words[index] << 8);
+    std::memcpy(bytes + index * 3, &word, sizeof(word));
+  }
+}
+
+#if defined(__SSE2__)
+static __m128i XmlInRange(const __m128i block, const char first, const char last)
+{
+  // comparisons are signed, bytes above 0x7F fall in no range
+  return _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8(first - 1)), _mm_cmplt_epi8(block, _mm_set1_epi8(last + 1)));
+}
+
+/*
+ * 16 base64 characters to 12 bytes, false if one of them is outside the alphabet (whitespace, padding)
+ */
+static bool XmlDecodeBase64Block(const char *data, uint8_t *bytes)
+{
+  const __m128i block = _mm_loadu_si128((const __m128i *)data);
+  const __m128i upper = XmlInRange(block, 'A', 'Z');
+  const __m128i lower = XmlInRange(block, 'a', 'z');
+  const __m128i digit = XmlInRange(block, '0', '9');
+  const __m128i plus = _mm_cmpeq_epi8(block, _mm_set1_epi8('+'));
+  const __m128i slash = _mm_cmpeq_epi8(block, _mm_set1_epi8('/'));
+  const __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, _mm_or_si128(plus, slash)));
+  if (_mm_movemask_epi8(valid) != 0xFFFF) {
+    return false;
+  }
+  // every range is moved to its values by adding a constant
+  __m128i shift = _mm_and_si128(upper, _mm_set1_epi8(-'A'));
+  shift = _mm_or_si128(shift, _mm_and_si128(lower, _mm_set1_epi8(26 - 'a')));
+  shift = _mm_or_si128(shift, _mm_and_si128(digit, _mm_set1_epi8(52 - '0')));
+  shift = _mm_or_si128(shift, _mm_and_si128(plus, _mm_set1_epi8(62 - '+')));
+  shift = _mm_or_si128(shift, _mm_and_si128(slash, _mm_set1_epi8(63 - '/')));
+  const __m128i values = _mm_add_epi8(block, shift);
+  // pairs of 6 bits to 12 in every 16 bit lane, then pairs of 12 to 24 in every 32 bit lane
+  const __m128i pairs =
+    _mm_or_si128(_mm_slli_epi16(_mm_and_si128(values, _mm_set1_epi16(0xFF)), 6), _mm_srli_epi16(values, 8));
+  const __m128i words = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+  uint32_t lanes[4];
+  _mm_storeu_si128((__m128i *)lanes, words);
+  XmlStoreBase64Words(lanes, bytes);
+  return true;
+}
+#elif defined(__ARM_NEON)
+static uint8x16_t XmlInRange(const uint8x16_t block, const char first, const char last)
+{
+  return vandq_u8(vcgeq_u8(block, vdupq_n_u8((uint8_t)first)), vcleq_u8(block, vdupq_n_u8((uint8_t)last)));
+}
+
+/*
+ * 16 base64 characters to 12 bytes, false if one of them is outside the alphabet (whitespace, padding)
+ */
+static bool XmlDecodeBase64Block(const char *data, uint8_t *bytes)
+{
+  const uint8x16_t block = vld1q_u8((const uint8_t *)data);
+  const uint8x16_t upper = XmlInRange(block, 'A', 'Z');
+  const uint8x16_t lower = XmlInRange(block, 'a', 'z');
+  const uint8x16_t digit = XmlInRange(block, '0', '9');
+  const uint8x16_t plus = vceqq_u8(block, vdupq_n_u8('+'));
+  const uint8x16_t slash = vceqq_u8(block, vdupq_n_u8('/'));
+  if (~XmlMask(vorrq_u8(vorrq_u8(upper, lower), vorrq_u8(digit, vorrq_u8(plus, slash)))) != 0) {
+    return false;
+  }
+  // every range is moved to its values by adding a constant
+  uint8x16_t shift = vandq_u8(upper, vdupq_n_u8((uint8_t)-'A'));
+  shift = vorrq_u8(shift, vandq_u8(lower, vdupq_n_u8((uint8_t)(26 - 'a'))));
+  shift = vorrq_u8(shift, vandq_u8(digit, vdupq_n_u8((uint8_t)(52 - '0'))));
+  shift = vorrq_u8(shift, vandq_u8(plus, vdupq_n_u8((uint8_t)(62 - '+'))));
+  shift = vorrq_u8(shift, vandq_u8(slash, vdupq_n_u8((uint8_t)(63 - '/'))));
+  const uint16x8_t values = vreinterpretq_u16_u8(vaddq_u8(block, shift));
+  // pairs of 6 bits to 12 in every 16 bit lane, then pairs of 12 to 24 in every 32 bit lane
+  const uint32x4_t pairs =
+    vreinterpretq_u32_u16(vorrq_u16(vshlq_n_u16(vandq_u16(values, vdupq_n_u16(0xFF)), 6), vshrq_n_u16(values, 8)));
+  const uint32x4_t words = vorrq_u32(vshlq_n_u32(vandq_u32(pairs, vdupq_n_u32(0xFFFF)), 12), vshrq_n_u32(pairs, 16));
+  uint32_t lanes[4];
+  vst1q_u32(lanes, words);
+  XmlStoreBase64Words(lanes, bytes);
+  return true;
+}
+#endif
+
+/*
+ * base64 into `blob`, whitespace is skipped and decoding stops at the first '='
+ * the blob is sized for the longest result up front and trimmed to what was decoded
+ */
+static bool XmlDecodeBase64(const char *data, const size_t size, Cell::Blob &blob)
+{
+  static const XmlBase64Table table;
+  // one more byte for the garbage written after the last vector block
+  blob.resize(size / 4 * 3 + 1);
+  uint8_t *bytes = blob.data();
+  uint32_t accumulator = 0;
+  int count = 0;
+  size_t offset = 0;
+  while (offset < size) {
+#if defined(__SSE2__) || defined(__ARM_NEON)
+    while (count == 0 && size - offset >= 16 && XmlDecodeBase64Block(data + offset, bytes)) {
+      offset += 16;
+      bytes += 12;
+    }
+    if (offset == size) {
+      break;
+    }
+#endif
+    const int value = table.values[(uint8_t)data[offset]];
+    if (value < 0) {
+      if (data[offset] == '=') {
+        break;
+      }
+      if (!XmlIsSpace(data[offset])) {
+        return false;
+      }
+      offset = XmlSkipSpace(data, size, offset);
+      continue;
+    }
+    accumulator = accumulator << 6 | (uint32_t)value;
+    if (++count == 4) {
+      *bytes++ = (uint8_t)(accumulator >> 16);
+      *bytes++ = (uint8_t)(accumulator >> 8);
+      *bytes++ = (uint8_t)accumulator;
+      accumulator = 0;
+      count = 0;
+    }
+    offset++;
+  }
+  // leftover characters hold 8 or 16 bits and 4 or 2 bits of padding
+  if (count >= 2) {
+    *bytes++ = (uint8_t)(accumulator >> (count * 6 - 8));
+  }
+  if (count == 3) {
+    *bytes++ = (uint8_t)(accumulator >> 2);
+  }
+  blob.resize((size_t)(bytes - blob.data()));
+  return true;
+}
+
+std::shared_ptr<XmlPlistReader> XmlPlistReader::create(const std::shared_ptr<const Buffer> &buffer)
+{
+  std::shared_ptr<XmlPlistReader> reader(new XmlPlistReader(buffer));
+  const char *data = (const char *)buffer->data();
+  const size_t size = buffer->size();
+
+  size_t offset = XmlStartsWith(data, size, 0, "\xEF\xBB\xBF") ? 3 : 0;
+  offset = reader->skipMisc(offset);
+  Tag tag;
+  if (!reader->getTag(offset, tag) || tag.isClosing) {
+    return nullptr;
+  }
+  const bool isWrapped = tag.is("plist");
+  if (isWrapped) {
+    if (tag.isEmpty) {
+      return nullptr;
+    }
+    offset = reader->skipMisc(tag.end);
+  }
+
+  size_t end;
+  if (reader->getType(offset) == Cell::NUL || !reader->skipElement(offset, end)) {
+    return nullptr;
+  }
+  reader->m_root = offset;
+
+  if (isWrapped) {
+    Tag closing;
+    if (!reader->getTag(reader->skipMisc(end), closing) || !closing.isClosing || !closing.is("plist")) {
+      return nullptr;
+    }
+  }
+  return reader;
+}
+
+bool XmlPlistReader::getTag(const size_t offset, Tag &tag) const
+{
+  const char *data = (const char *)m_buffer->data();
+  const size_t size = m_buffer->size();
+  if (offset >= size || data[offset] != '<') {
+    return false;
+  }
+  size_t position = offset + 1;
+  tag.isClosing = position < size && data[position] == '/';
+  if (tag.isClosing) {
+    position++;
+  }
+  tag.name = data + position;
+  while (position < size && !XmlIsSpace(data[position]) && data[position] != '>' && data[position] != '/') {
+    position++;
+  }
+  tag.length = (size_t)(data + position - tag.name);
+  if (tag.length == 0) {
+    return false;
+  }
+  while (position < size && data[position] != '>') {
+    if (data[position] == '"' || data[position] == '\'') {
+      const char *quote = (const char *)std::memchr(data + position + 1, data[position], size - position - 1);
+      if (quote == NULL) {
+        return false;
+      }
+      position = (size_t)(quote - data);
+    }
+    position++;
+  }
+  if (position >= size) {
+    return false;
+  }
+  tag.isEmpty = !tag.isClosing && data[position - 1] == '/';
+  tag.end = position + 1;
+  return true;
+}
+
+size_t XmlPlistReader::skipMisc(size_t offset) const
+{
+  const char *data = (const char *)m_buffer->data();
+  const size_t size = m_buffer->size();
+  while (offset < size) {
+    offset = XmlSkipSpace(data, size, offset);
+    if (size - offset < 2 || data[offset] != '<' || (data[offset + 1] != '?' && data[offset + 1] != '!')) {
+      break;
+    }
+    if (XmlStartsWith(data, size, offset, "<?")) {
+      offset = std::min(XmlFind(data, size, offset + 2, "?>") + 2, size);
+    }
+    else if (XmlStartsWith(data, size, offset, "<!--")) {
+      offset = std::min(XmlFind(data, size, offset + 4, "-->") + 3, size);
+    }
+    else if (XmlStartsWith(data, size, offset, "<!") && !XmlStartsWith(data, size, offset, "<![CDATA[")) {
+      int nesting = 0;
+      for (offset += 2; offset < size && (data[offset] != '>' || nesting > 0); offset++) {
+        nesting += data[offset] == '[' ? 1 : data[offset] == ']' ? -1 : 0;
+      }
+      offset = std::min(offset + 1, size);
+    }
+    else {
+      break;
+    }
+  }
+  return offset;
+}
+
+bool XmlPlistReader::skipElement(const size_t offset, size_t &end) const
+{
+  Tag tag;
+  if (!getTag(offset, tag) || tag.isClosing) {
+    return false;
+  }
+  if (tag.isEmpty) {
+    end = tag.end;
+    return true;
+  }
+
+  const char *data = (const char *)m_buffer->data();
+  const size_t size = m_buffer->size();
+  size_t position = tag.end;
+  size_t nesting = 1;
+  while (nesting > 0) {
+    position = XmlFindAny(data, size, position, "<");
+    if (position >= size) {
+      return false;
+    }
+    if (XmlStartsWith(data, size, position, "<![CDATA[")) {
+      position = XmlFind(data, size, position + 9, "]]>") + 3;
+    }
+    else if (XmlStartsWith(data, size, position, "<!--")) {
+      position = XmlFind(data, size, position + 4, "-->") + 3;
+    }
+    else if (XmlStartsWith(data, size, position, "<?")) {
+      position = XmlFind(data, size, position + 2, "?>") + 2;
+    }
+    else if (position + 1 < size && data[position + 1] == '/') {
+      // only the end of the last closing tag matters
+      if (--nesting == 0 && !getTag(position, tag)) {
+        return false;
+      }
+      position = nesting == 0 ? tag.end : position + 2;
+    }
+    else {
+      if (!getTag(position, tag)) {
+        return false;
+      }
+      nesting += tag.isEmpty ? 0 : 1;
+      position = tag.end;
+    }
+  }
+  end = position;
+  return end <= size;
+}
+
+bool XmlPlistReader::getText(const Tag &tag, std::string &text, size_t &end) const
+{
+  text.clear();
+  if (tag.isEmpty) {
+    end = tag.end;
+    return true;
+  }
+
+  const char *data = (const char *)m_buffer->data();
+  const size_t size = m_buffer->size();
+  size_t position = tag.end;
+  while (position < size) {
+    // character data and entities up to the next markup, in one pass
+    const size_t lessThan = XmlFindAny(data, size, position, "<&");
+    if (lessThan == size) {
+      return false;
+    }
+    text.append(data + position, lessThan - position);
+    if (data[lessThan] == '&') {
+      const char *semicolon = (const char *)std::memchr(data + lessThan, ';', size - lessThan);
+      if (semicolon == NULL || !XmlAppendEntity(text, data + lessThan + 1, (size_t)(semicolon - data) - lessThan - 1)) {
+        return false;
+      }
+      position = (size_t)(semicolon - data) + 1;
+      continue;
+    }
+    if (XmlStartsWith(data, size, lessThan, "<![CDATA[")) {
+      const size_t close = XmlFind(data, size, lessThan + 9, "]]>");
+      if (close == size) {
+        return false;
+      }
+      text.append(data + lessThan + 9, close - lessThan - 9);
+      position = close + 3;
+      continue;
+    }
+    if (XmlStartsWith(data, size, lessThan, "<!--")) {
+      position = XmlFind(data, size, lessThan + 4, "-->") + 3;
+      continue;
+    }
+    Tag closing;
+    if (!getTag(lessThan, closing) || !closing.isClosing || closing.length != tag.length ||
+        std::memcmp(closing.name, tag.name, tag.length) != 0) {
+      return false;
+    }
+    end = closing.end;
+    return true;
+  }
+  return false;
+}
+
+/*
+ * length of the text of an element that is plain character data (no entities, sections or comments) and can be
+ * read right from the buffer, false otherwise
+ */
+bool XmlPlistReader::getCharacters(const Tag &tag, size_t &length, size_t &end) const
+{
+  const char *data = (const char *)m_buffer->data();
+  const size_t size = m_buffer->size();
+  const size_t lessThan = tag.isEmpty ? tag.end : XmlFindAny(data, size, tag.end, "<&");
+  Tag closing;
+  if (!tag.isEmpty && (lessThan == size || data[lessThan] != '<' || !getTag(lessThan, closing) ||
+                       !closing.isClosing || closing.length != tag.length ||
+                       std::memcmp(closing.name, tag.name, tag.length) != 0)) {
+    return false;
+  }
+  length = lessThan - tag.end;
+  end = tag.isEmpty ? tag.end : closing.end;
+  return true;
+}
+
+Cell::Type XmlPlistReader::getType(const Node node) const
+{
+  Tag tag;
+  if (!getTag(node, tag) || tag.isClosing) {
+    return Cell::NUL;
+  }
+  if (tag.is("dict")) return Cell::ROW;
+  if (tag.is("array")) return Cell::COLUMN;
+  if (tag.is("string")) return Cell::TEXT;
+  if (tag.is("integer") || tag.is("true") || tag.is("false")) return Cell::INTEGER;
+  if (tag.is("real") || tag.is("date")) return Cell::REAL;
+  if (tag.is("data")) return Cell::BLOB;
+  return Cell::NUL;
+}
+
+bool XmlPlistReader::find(const Node node, const std::string &key, Node &result) const
+{
+  Tag tag;
+  if (!getTag(node, tag) || tag.isClosing || !tag.is("dict") || tag.isEmpty) {
+    return false;
+  }
+  std::string text;
+  size_t position = tag.end;
+  while (true) {
+    Tag keyTag;
+    if (!getTag(skipMisc(position), keyTag) || !keyTag.is("key") || keyTag.isClosing || !getText(keyTag, text, position)) {
+      return false;
+    }
+    position = skipMisc(position);
+    if (text == key) {
+      result = position;
+      return true;
+    }
+    if (!skipElement(position, position)) {
+      return false;
+    }
+  }
+}
+
+bool XmlPlistReader::next(const Node node, size_t &position, Node &item, std::string &key) const
+{
+  // positions are offsets right after the previous item, 0 is never one of them
+  Tag tag;
+  if (!getTag(node, tag) || tag.isClosing || tag.isEmpty || !(tag.is("dict") || tag.is("array"))) {
+    return false;
+  }
+  Tag child;
+  size_t offset = skipMisc(position == 0 ? tag.end : position);
+  if (!getTag(offset, child) || child.isClosing) {
+    return false;
+  }
+  if (tag.is("dict")) {
+    if (!child.is("key") || !getText(child, key, offset)) {
+      return false;
+    }
+    offset = skipMisc(offset);
+  }
+  if (getType(offset) == Cell::NUL || !skipElement(offset, position)) {
+    return false;
+  }
+  item = offset;
+  return true;
+}
+
+Cell XmlPlistReader::read(const Node node, const int depth) const
+{
+  /*
+   * containers being read are kept on a stack, a document nests as deep as it's long
+   */
+  std::vector<ReadFrame> frames;
+  size_t offset = node;
+  while (true) {
+    Tag tag;
+    if (!getTag(offset, tag) || tag.isClosing) {
+      return nullptr;
+    }
+    const bool isDictionary = tag.is("dict");
+    size_t position;
+    if ((isDictionary || tag.is("array")) && !tag.isEmpty && depth - (int)frames.size() > 0) {
+      frames.push_back(ReadFrame{tag, isDictionary, tag.end, "", {}, {}});
+    }
+    else {
+      Cell cell;
+      if (!read(offset, tag, depth - (int)frames.size(), cell, position)) {
+        return nullptr;
+      }
+      if (frames.empty()) {
+        return cell;
+      }
+      frames.back().add(std::move(cell), position);
+    }
+
+    while (true) {
+      auto &frame = frames.back();
+      Tag child;
+      position = skipMisc(frame.position);
+      if (!getTag(position, child)) {
+        return nullptr;
+      }
+      if (!child.isClosing) {
+        if (frame.isDictionary) {
+          if (!child.is("key") || !getText(child, frame.key, position)) {
+            return nullptr;
+          }
+          position = skipMisc(position);
+        }
+        offset = position;
+        break;
+      }
+      if (child.length != frame.tag.length || std::memcmp(child.name, frame.tag.name, child.length) != 0) {
+        return nullptr;
+      }
+      Cell container = frame.isDictionary ? Cell(std::move(frame.row)) : Cell(std::move(frame.column));
+      frames.pop_back();
+      if (frames.empty()) {
+        return container;
+      }
+      frames.back().add(std::move(container), child.end);
+    }
+  }
+}
+
+/*
+ * `cell` is the value of any element but a non-empty container that is read deeper than `depth`
+ */
+bool XmlPlistReader::read(const size_t offset, const Tag &tag, const int depth, Cell &cell, size_t &end) const
+{
+  const bool isDictionary = tag.is("dict");
+  if (isDictionary || tag.is("array")) {
+    if (tag.isEmpty) {
+      cell = isDictionary ? Cell(Cell::Row()) : Cell(Cell::Column());
+      end = tag.end;
+      return true;
+    }
+    if (depth > 0) {
+      return false;
+    }
+    cell = lazy(offset, isDictionary ? Cell::ROW : Cell::COLUMN);
+    return skipElement(offset, end);
+  }
+
+  if (tag.is("true") || tag.is("false")) {
+    std::string text;
+    cell = Cell::boolean(tag.is("true"));
+    return getText(tag, text, end);
+  }
+
+  // values are read from the buffer unless they need unescaping first
+  const char *data = (const char *)m_buffer->data() + tag.end;
+  size_t length;
+  std::string text;
+  if (!getCharacters(tag, length, end)) {
+    if (!getText(tag, text, end)) {
+      return false;
+    }
+    data = text.data();
+    length = text.size();
+  }
+  if (tag.is("string")) {
+    cell = data == text.data() ? std::move(text) : Cell::Text(data, length);
+    return true;
+  }
+  if (tag.is("integer")) {
+    Cell::Integer integer;
+    if (!XmlParseInteger(data, length, integer)) {
+      return false;
+    }
+    cell = integer;
+    return true;
+  }
+  if (tag.is("real") || tag.is("date")) {
+    Cell::Real real;
+    if (!(tag.is("real") ? XmlParseReal(data, length, real) : XmlParseDate(data, length, real))) {
+      return false;
+    }
+    cell = tag.is("date") ? Cell::date(real) : Cell(real);
+    return true;
+  }
+  if (tag.is("data")) {
+    Cell::Blob blob;
+    if (!XmlDecodeBase64(data, length, blob)) {
+      return false;
+    }
+    cell = std::move(blob);
+    return true;
+  }
+  return false;
+}
+
+bool XmlPlistReader::slice(const Node node, std::string &bytes) const
+{
+  size_t end;
+  if (!skipElement(node, end)) {
+    return false;
+  }
+  bytes.assign("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+               "<!DOCTYPE plist PUBLIC \"-//Apple//DTD PLIST 1.0//EN\" \"http://www.apple.com/DTDs/PropertyList-1.0.dtd\">\n"
+               "<plist version=\"1.0\">\n");
+  bytes.append((const char *)m_buffer->data() + node, end - node);
+  bytes.append("\n</plist>\n");
+  return true;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstring>
+#include <vector>
+#include "PlistReader.hpp"
+
+/*
+ * XML plist reader, nodes are offsets of element start tags
+ * subtrees that are not decoded are skipped by matching container tags only, their contents are validated when
+ * (and if) they are decoded
+ */
+class XmlPlistReader : public PlistReader
+{
+public:
+  static std::shared_ptr<XmlPlistReader> create(const std::shared_ptr<const Buffer> &);
+
+  Node getRoot() const override { return m_root; }
+  Cell::Type getType(const Node) const override;
+  bool find(const Node, const std::string &, Node &) const override;
+  bool next(const Node, size_t &, Node &, std::string &) const override;
+  Cell read(const Node, const int) const override;
+  bool slice(const Node, std::string &) const override;
+
+private:
+  XmlPlistReader(const std::shared_ptr<const Buffer> &buffer) : PlistReader(buffer) { }
+
+  struct Tag
+  {
+    const char *name;
+    size_t length;
+    bool isClosing;
+    bool isEmpty;
+    size_t end;
+
+    template <size_t N>
+    bool is(const char (&tag)[N]) const
+    {
+      return length == N - 1 && std::memcmp(tag, name, N - 1) == 0;
+    }
+  };
+
+  bool getTag(const size_t, Tag &) const;
+  size_t skipMisc(size_t) const;
+  bool skipElement(const size_t, size_t &) const;
+  bool getText(const Tag &, std::string &, size_t &) const;
+  bool getCharacters(const Tag &, size_t &, size_t &) const;
+  bool read(const size_t, const Tag &, const int, Cell &, size_t &) const;
+
+  struct ReadFrame
+  {
+    Tag tag;
+    bool isDictionary;
+    size_t position;
+    std::string key;
+    Cell::Row row;
+    Cell::Column column;
+
+    void add(Cell &&cell, const size_t end)
+    {
+      if (isDictionary) {
+        row.insert({key, std::move(cell)});
+      }
+      else {
+        column.push_back(std::move(cell));
+      }
+      position = end;
+    }
+  };
+
+  Node m_root = 0;
+};
@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "Decimal.hpp"
+#include "Trace.hpp"
+#include "XmlPlistWriter.hpp"
+
+static const size_t XmlMaxIndent = 64;
+
+static void XmlAppendEscaped(std::string &xml, const std::string &text)
+{
+  for (const char character : text) {
+    switch (character) {
+      case '&':
+        xml.append("&amp;");
+        break;
+      case '<':
+        xml.append("&lt;");
+        break;
+      case '>':
+        xml.append("&gt;");
+        break;
+      case '\t':
+      case '\n':
+      case '\r':
+        xml.push_back(character);
+        break;
+      default:
+        // other control characters can't appear in XML 1.0, even as references
+        if ((unsigned char)character >= 0x20) {
+          xml.push_back(character);
+        }
+        break;
+    }
+  }
+}
+
+static void XmlAppendElement(std::string &xml, const char *name, const std::string &text, bool escape = false)
+{
+  xml.append("<").append(name).append(">");
+  if (escape) {
+    XmlAppendEscaped(xml, text);
+  }
+  else {
+    xml.append(text);
+  }
+  xml.append("</").append(name).append(">\n");
+}
+
+static std::string XmlFormatReal(const double value)
+{
+  if (std::isnan(value)) {
+    return "nan";
+  }
+  if (std::isinf(value)) {
+    return value < 0 ? "-infinity" : "+infinity";
+  }
+  return Decimal::format(value);
+}
+
+static std::string XmlFormatDate(const double value)
+{
+  // seconds since 2001-01-01, civil date from days since 1970-01-01
+  const int64_t seconds = (int64_t)std::floor(value) + 978307200;
+  int64_t days = seconds / 86400 - (seconds % 86400 < 0 ? 1 : 0);
+  const int64_t time = seconds - days * 86400;
+  days += 719468;
+  const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+  const int64_t dayOfEra = days - era * 146097;
+  const int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+  const int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+  const int64_t monthIndex = (5 * dayOfYear + 2) / 153;
+  const int64_t day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+  const int64_t month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+  const int64_t year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+
+  char buffer[128];
+  std::snprintf(buffer, sizeof(buffer), "%04lld-%02lld-%02lldT%02lld:%02lld:%02lldZ", (long long)year, (long long)month,
+                (long long)day, (long long)(time / 3600), (long long)(time / 60 % 60), (long long)(time % 60));
+  return buffer;
+}
+
+static std::string XmlFormatBase64(const Cell::Blob &blob)
+{
+  static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string text;
+  text.reserve((blob.size() + 2) / 3 * 4);
+  for (size_t index = 0; index < blob.size(); index += 3) {
+    const size_t remaining = blob.size() - index;
+    const uint32_t bits = (uint32_t)blob[index] << 16 | (remaining > 1 ? (uint32_t)blob[index + 1] << 8 : 0) |
+                          (remaining > 2 ? (uint32_t)blob[index + 2] : 0);
+    text.push_back(alphabet[bits >> 18 & 0x3F]);
+    text.push_back(alphabet[bits >> 12 & 0x3F]);
+    text.push_back(remaining > 1 ? alphabet[bits >> 6 & 0x3F] : '=');
+    text.push_back(remaining > 2 ? alphabet[bits & 0x3F] : '=');
+  }
+  return text;
+}
+
+/*
+ * anything but non-empty containers, which XmlAppend opens
+ */
+static void XmlAppendValue(std::string &xml, const Cell &cell)
+{
+  switch (cell.type()) {
+    case Cell::INTEGER:
+      if (cell.isBoolean()) {
+        xml.append(cell.integerValue() ? "<true/>\n" : "<false/>\n");
+      }
+      else {
+        XmlAppendElement(xml, "integer", std::to_string(cell.integerValue()));
+      }
+      break;
+    case Cell::REAL:
+      if (cell.isDate()) {
+        XmlAppendElement(xml, "date", XmlFormatDate(cell.realValue()));
+      }
+      else {
+        XmlAppendElement(xml, "real", XmlFormatReal(cell.realValue()));
+      }
+      break;
+    case Cell::TEXT:
+      XmlAppendElement(xml, "string", cell.textValue(), true);
+      break;
+    case Cell::BLOB:
+      XmlAppendElement(xml, "data", XmlFormatBase64(cell.blobValue()));
+      break;
+    case Cell::ROW:
+      xml.append("<dict/>\n");
+      break;
+    case Cell::COLUMN:
+      xml.append("<array/>\n");
+      break;
+    case Cell::NUL:
+      break;
+  }
+}
+
+struct XmlFrame
+{
+  const Cell *cell;
+  Cell::Row::const_iterator row;
+  size_t column;
+};
+
+static size_t XmlIndent(const size_t depth)
+{
+  // deeper levels stay at the same indentation, so the output grows linearly with the nesting
+  return std::min<size_t>(depth, XmlMaxIndent);
+}
+
+static void XmlAppend(std::string &xml, const Cell &root)
+{
+  // containers being written are kept on a stack, documents can nest as deep as they're long
+  std::vector<XmlFrame> frames;
+  const Cell *cell = &root;
+  while (true) {
+    if (cell != nullptr) {
+      xml.append(XmlIndent(frames.size()), '\t');
+      if ((cell->isRow() || cell->isColumn()) && cell->size() != 0) {
+        xml.append(cell->isRow() ? "<dict>\n" : "<array>\n");
+        frames.push_back(XmlFrame{cell, cell->isRow() ? cell->rowValue().begin() : Cell::Row::const_iterator(), 0});
+      }
+      else {
+        XmlAppendValue(xml, *cell);
+      }
+    }
+    if (frames.empty()) {
+      return;
+    }
+
+    auto &frame = frames.back();
+    cell = nullptr;
+    if (frame.cell->isRow()) {
+      const auto &row = frame.cell->rowValue();
+      while (frame.row != row.end() && !frame.row->second.isValid()) {
+        ++frame.row;
+      }
+      if (frame.row != row.end()) {
+        xml.append(XmlIndent(frames.size()), '\t');
+        XmlAppendElement(xml, "key", frame.row->first, true);
+        cell = &(frame.row++)->second;
+      }
+    }
+    else {
+      const auto &column = frame.cell->columnValue();
+      while (frame.column < column.size() && !column[frame.column].isValid()) {
+        frame.column++;
+      }
+      if (frame.column < column.size()) {
+        cell = &column[frame.column++];
+      }
+    }
+    if (cell == nullptr) {
+      xml.append(XmlIndent(frames.size() - 1), '\t').append(frame.cell->isRow() ? "</dict>\n" : "</array>\n");
+      frames.pop_back();
+    }
+  }
+}
+
+bool XmlPlistWriter::write(const Cell &cell, std::string &xml)
+{
+  TRACE_SCOPE("XmlPlistWriter::write");
+  if (!cell.isValid()) {
+    return false;
+  }
+  xml.assign("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+             "<!DOCTYPE plist PUBLIC \"-//Apple//DTD PLIST 1.0//EN\" \"http://www.apple.com/DTDs/PropertyList-1.0.dtd\">\n"
+             "<plist version=\"1.0\">\n");
+  XmlAppend(xml, cell);
+  xml.append("</plist>\n");
+  return true;
+}
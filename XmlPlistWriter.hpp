@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+#include "Cell.hpp"
+
+/*
+ * XML plist writer, the format Apple's tools produce (tab indentation, base64 data, dates in UTC with whole seconds)
+ * the indentation stops growing 64 levels deep
+ * null cells are left out, booleans and dates keep their elements
+ */
+class XmlPlistWriter
+{
+public:
+  static bool write(const Cell &, std::string &);
+};
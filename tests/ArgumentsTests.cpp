@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+#include "Arguments.hpp"
+
+TEST(Arguments, Positional)
+{
+  const char *argv[] = {"/tmp/file.plist", "2", "key.path"};
+  Arguments arguments(3, argv);
+  ASSERT_EQ(arguments.size(), (size_t)3);
+  ASSERT_EQ(arguments[0], "/tmp/file.plist");
+  ASSERT_EQ(arguments[1], "2");
+  ASSERT_EQ(arguments[2], "key.path");
+  ASSERT_EQ(arguments[3], "");
+  ASSERT_EQ(arguments.getOptions().empty(), true);
+}
+
+TEST(Arguments, Options)
+{
+  const char *argv[] = {"/tmp/file.plist", "Trace = '/tmp/trace.json'", "limit=0x10", "flag=", "off=no"};
+  Arguments arguments(5, argv);
+  ASSERT_EQ(arguments.size(), (size_t)1);
+  ASSERT_EQ(arguments.has("trace"), true);
+  ASSERT_EQ(arguments.get("trace"), "/tmp/trace.json");
+  ASSERT_EQ(arguments.getInteger("limit"), 16);
+  ASSERT_EQ(arguments.getInteger("missing", 7), 7);
+  ASSERT_EQ(arguments.getBoolean("flag"), true);
+  ASSERT_EQ(arguments.getBoolean("off", true), false);
+  ASSERT_EQ(arguments.getBoolean("missing"), false);
+}
+
+TEST(Arguments, PositionalWithEquals)
+{
+  const char *argv[] = {"/tmp/a=b.plist", "0", "a.b"};
+  Arguments arguments(3, argv);
+  ASSERT_EQ(arguments.size(), (size_t)3);
+  ASSERT_EQ(arguments[0], "/tmp/a=b.plist");
+}
+
+TEST(Arguments, Size)
+{
+  size_t size = 0;
+  ASSERT_EQ(Arguments::parseSize("4096", size), true);
+  ASSERT_EQ(size, (size_t)4096);
+  ASSERT_EQ(Arguments::parseSize("512k", size), true);
+  ASSERT_EQ(size, (size_t)512 << 10);
+  ASSERT_EQ(Arguments::parseSize("64MB", size), true);
+  ASSERT_EQ(size, (size_t)64 << 20);
+  ASSERT_EQ(Arguments::parseSize("2G", size), true);
+  ASSERT_EQ(size, (size_t)2 << 30);
+
+  for (auto invalid : {"", "abc", "10XB", "-1", "+1", "1 M", "1MM", "1.5G", "99999999999999999999", "99999999999G"}) {
+    size = 7;
+    ASSERT_EQ(Arguments::parseSize(invalid, size), false) << invalid;
+    ASSERT_EQ(size, (size_t)7);
+  }
+
+  const char *argv[] = {"/tmp/file.plist", "memory_limit=abc", "sample=10", "empty="};
+  Arguments arguments(4, argv);
+  ASSERT_EQ(arguments.getSize("memory_limit", size), false);
+  ASSERT_EQ(arguments.getSize("sample", size), true);
+  ASSERT_EQ(size, (size_t)10);
+  ASSERT_EQ(arguments.getSize("empty", size), true);
+  ASSERT_EQ(arguments.getSize("missing", size), true);
+  ASSERT_EQ(size, (size_t)10);
+}
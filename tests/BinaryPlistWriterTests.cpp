@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include <climits>
+#include "BinaryPlistWriter.hpp"
+#include "PlistReader.hpp"
+
+static Cell BinaryPlistWriterRoundTrip(const Cell &cell, std::string &bytes)
+{
+  EXPECT_EQ(BinaryPlistWriter::write(cell, bytes), true);
+  auto reader = PlistReader::create(Buffer::copy(bytes.data(), bytes.size()));
+  EXPECT_NE(reader, nullptr);
+  return reader ? reader->read(reader->getRoot(), INT_MAX) : Cell();
+}
+
+TEST(BinaryPlistWriter, RoundTrip)
+{
+  Cell::Column items;
+  for (Cell::Integer index = 0; index < 20; index++) {
+    items.push_back(index * 1000);
+  }
+  const Cell::Row row{
+    {"integer", (Cell::Integer)-42},
+    {"large", (Cell::Integer)0x123456789},
+    {"real", 2.5},
+    {"boolean", Cell::boolean(true)},
+    {"date", Cell::date(600000000.5)},
+    {"text", Cell::Text("ключ")},
+    {"long text", Cell::Text("more than fifteen characters")},
+    {"blob", Cell::Blob{0, 1, 2}},
+    {"uid", Cell::Row{{"CF$UID", (Cell::Integer)7}}},
+    {"items", items},
+    {"missing", nullptr},
+  };
+
+  std::string bytes;
+  auto cell = BinaryPlistWriterRoundTrip(row, bytes);
+  ASSERT_EQ(cell.isRow(), true);
+  ASSERT_EQ(cell.size(), (size_t)10);
+  ASSERT_EQ(cell["integer"].integerValue(), -42);
+  ASSERT_EQ(cell["large"].integerValue(), 0x123456789);
+  ASSERT_EQ(cell["real"].realValue(), 2.5);
+  ASSERT_EQ(cell["boolean"].isBoolean(), true);
+  ASSERT_EQ(cell["boolean"].integerValue(), 1);
+  ASSERT_EQ(cell["date"].isDate(), true);
+  ASSERT_EQ(cell["date"].realValue(), 600000000.5);
+  ASSERT_EQ(cell["text"].textValue(), "ключ");
+  ASSERT_EQ(cell["long text"].textValue(), "more than fifteen characters");
+  ASSERT_EQ(cell["blob"].blobValue(), (Cell::Blob{0, 1, 2}));
+  ASSERT_EQ(cell["uid"]["CF$UID"].integerValue(), 7);
+  ASSERT_EQ(cell["items"].size(), (size_t)20);
+  ASSERT_EQ(cell["items"][19].integerValue(), 19000);
+}
+
+TEST(BinaryPlistWriter, Deduplication)
+{
+  Cell::Column same, different;
+  for (size_t index = 0; index < 100; index++) {
+    same.push_back(Cell::Row{{"name", Cell::Text("value")}});
+    different.push_back(Cell::Row{{"name", Cell::Text("value" + std::to_string(index))}});
+  }
+  std::string sameBytes, differentBytes;
+  ASSERT_EQ(BinaryPlistWriterRoundTrip(same, sameBytes).size(), (size_t)100);
+  ASSERT_EQ(BinaryPlistWriterRoundTrip(different, differentBytes).size(), (size_t)100);
+  // the key and the value are stored once, instead of a hundred values
+  ASSERT_LT(sameBytes.size() + 99 * 6, differentBytes.size());
+}
+
+TEST(BinaryPlistWriter, ReferenceSize)
+{
+  Cell::Column small, large;
+  for (Cell::Integer index = 0; index < 1000; index++) {
+    (index < 50 ? small : large).push_back(index);
+  }
+  std::string smallBytes, largeBytes;
+  ASSERT_EQ(BinaryPlistWriterRoundTrip(small, smallBytes)[49].integerValue(), 49);
+  ASSERT_EQ(BinaryPlistWriterRoundTrip(large, largeBytes)[949].integerValue(), 999);
+  // offset and reference sizes are the 7th and 8th trailer bytes
+  ASSERT_EQ(smallBytes[smallBytes.size() - 26], 1);
+  ASSERT_EQ(smallBytes[smallBytes.size() - 25], 1);
+  ASSERT_EQ(largeBytes[largeBytes.size() - 26], 2);
+  ASSERT_EQ(largeBytes[largeBytes.size() - 25], 2);
+}
+
+TEST(BinaryPlistWriter, Null)
+{
+  std::string bytes;
+  ASSERT_EQ(BinaryPlistWriter::write(Cell(), bytes), false);
+}
@@ -107,3 +107,34 @@ TEST(Cell, DateFloat)
   ASSERT_EQ(cell.isReal(), true);
   ASSERT_EQ(cell.realValue(), 0.2);
 }
+
+TEST(Cell, MemoryUsage)
+{
+  Cell integer((Cell::Integer)1);
+  Cell shortText((Cell::Text)"a");
+  Cell longText((Cell::Text)std::string(1024, 'a'));
+  Cell blob(Cell::Blob(100, 0));
+  ASSERT_GT(integer.memoryUsage(), (size_t)0);
+  ASSERT_GT(longText.memoryUsage(), shortText.memoryUsage() + 1024);
+  ASSERT_GE(blob.memoryUsage(), (size_t)100);
+  Cell column(Cell::Column{integer, longText});
+  ASSERT_GE(column.memoryUsage(), integer.memoryUsage() + longText.memoryUsage() + 2 * sizeof(Cell));
+  Cell row(Cell::Row{{"key", column}});
+  ASSERT_GT(row.memoryUsage(), column.memoryUsage());
+}
+
+TEST(Cell, Lazy)
+{
+  int loads = 0;
+  auto cell = Cell::lazy(Cell::COLUMN, [&loads] {
+    loads++;
+    return Cell::Column{(Cell::Integer)1, (Cell::Text)"text"};
+  });
+  ASSERT_EQ(cell.isColumn(), true);
+  cell.memoryUsage();
+  ASSERT_EQ(loads, 0);
+  ASSERT_EQ(cell.size(), (size_t)2);
+  ASSERT_EQ(cell[0].integerValue(), 1);
+  ASSERT_EQ(cell[1].textValue(), "text");
+  ASSERT_EQ(loads, 1);
+}
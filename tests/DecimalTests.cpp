@@ -0,0 +1,48 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include "Decimal.hpp"
+
+static void DecimalExpect(const std::string &text)
+{
+  double value, expected = std::strtod(text.c_str(), nullptr);
+  ASSERT_TRUE(Decimal::parse(text.data(), text.size(), value)) << text;
+  ASSERT_EQ(std::memcmp(&value, &expected, sizeof(value)), 0) << text;
+}
+
+TEST(Decimal, Parse)
+{
+  for (auto text : {"0", "-0", "+1", "1.", ".5", "00012.50", "1e3", "1E-3", "-2.5e+10", "9007199254740993",
+                    "0.1000000000000000055511151231257827021181583404541015625", "123456789012345678901234567890",
+                    "2.2250738585072011e-308", "4.9406564584124654e-324", "2.4703282292062327e-324",
+                    "1.7976931348623157e308", "1.7976931348623159e308", "1e-400", "1e400", "0e999999",
+                    "7.2057594037927933e16", "1.00000000000000011102230246251565404236316680908203125",
+                    "0x1p3", "infinity", "-INF", "nan"}) {
+    DecimalExpect(text);
+  }
+  for (auto text : {"", "-", ".", "e5", "1e", "1e+", "1.2.3", "1,5", "1 ", "0x"}) {
+    double value;
+    ASSERT_FALSE(Decimal::parse(text, std::strlen(text), value)) << text;
+  }
+
+  // the shortest and the longest representations of random doubles, and of random decimals
+  std::mt19937_64 random(42);
+  char buffer[64];
+  for (int index = 0; index < 20000; index++) {
+    uint64_t bits = random();
+    double number;
+    std::memcpy(&number, &bits, sizeof(number));
+    if (!std::isfinite(number)) {
+      continue;
+    }
+    for (int precision : {6, 15, 17}) {
+      std::snprintf(buffer, sizeof(buffer), "%.*g", precision, number);
+      DecimalExpect(buffer);
+    }
+    std::snprintf(buffer, sizeof(buffer), "%llu.%llue%d", (unsigned long long)(random() % 1000000),
+                  (unsigned long long)random(), (int)(random() % 80) - 40);
+    DecimalExpect(buffer);
+  }
+}
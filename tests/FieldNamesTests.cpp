@@ -0,0 +1,28 @@
+#include <gtest/gtest.h>
+#include "FieldNames.hpp"
+
+TEST(FieldNames, Names)
+{
+  FieldNames names;
+  ASSERT_EQ(names.getName(FieldNames::Root), "");
+  ASSERT_EQ(names.getName(names.getValue(FieldNames::Root)), "_");
+  ASSERT_EQ(names.getName(names.getChild(FieldNames::Root, "")), "_");
+
+  const size_t meta = names.getChild(FieldNames::Root, "Meta");
+  ASSERT_EQ(names.getName(meta), "meta");
+  ASSERT_EQ(names.getChild(FieldNames::Root, "Meta"), meta);
+  ASSERT_EQ(names.getChild(FieldNames::Root, "META"), meta);
+  ASSERT_EQ(names.getChild(meta, ""), meta);
+  ASSERT_EQ(names.getValue(meta), meta);
+
+  const size_t owner = names.getChild(meta, "Owner");
+  ASSERT_EQ(names.getName(owner), "meta.owner");
+  // equal names share the id whichever keys lead to them
+  ASSERT_EQ(names.getChild(FieldNames::Root, "meta.owner"), owner);
+
+  ASSERT_EQ(names.getElement(FieldNames::Root, 0), names.getValue(FieldNames::Root));
+  ASSERT_EQ(names.getElement(FieldNames::Root, 2), names.getValue(FieldNames::Root));
+  ASSERT_EQ(names.getElement(meta, 0), meta);
+  ASSERT_EQ(names.getName(names.getElement(meta, 1)), "meta._");
+  ASSERT_EQ(names.getName(names.getElement(names.getElement(meta, 1), 2)), "meta._._");
+}
@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+#include "BinaryPlistWriter.hpp"
+#include "KeyedArchive.hpp"
+
+static Cell KeyedArchiveUID(Cell::Integer uid)
+{
+  return Cell::Row{{"CF$UID", uid}};
+}
+
+static Cell KeyedArchiveClass(const Cell::Column &classes)
+{
+  return Cell::Row{{"$classname", classes.front()}, {"$classes", classes}};
+}
+
+static Cell KeyedArchiveMake(const Cell::Column &objects, const Cell::Row &top)
+{
+  return Cell::Row{
+    {"$archiver", Cell::Text("NSKeyedArchiver")},
+    {"$version", (Cell::Integer)100000},
+    {"$objects", objects},
+    {"$top", top},
+  };
+}
+
+TEST(KeyedArchive, Graph)
+{
+  const auto archive = KeyedArchiveMake({
+    Cell::Text("$null"),
+    Cell::Row{
+      {"$class", KeyedArchiveUID(7)},
+      {"NS.keys", Cell::Column{KeyedArchiveUID(2), KeyedArchiveUID(3)}},
+      {"NS.objects", Cell::Column{KeyedArchiveUID(4), KeyedArchiveUID(5)}},
+    },
+    Cell::Text("name"),
+    Cell::Text("items"),
+    Cell::Text("first"),
+    Cell::Row{{"$class", KeyedArchiveUID(8)}, {"NS.objects", Cell::Column{KeyedArchiveUID(6), KeyedArchiveUID(6)}}},
+    Cell::Row{
+      {"$class", KeyedArchiveUID(9)},
+      {"title", KeyedArchiveUID(4)},
+      {"parent", KeyedArchiveUID(1)},
+      {"note", KeyedArchiveUID(0)},
+      {"count", (Cell::Integer)3},
+    },
+    KeyedArchiveClass({Cell::Text("NSMutableDictionary"), Cell::Text("NSDictionary"), Cell::Text("NSObject")}),
+    KeyedArchiveClass({Cell::Text("NSArray"), Cell::Text("NSObject")}),
+    KeyedArchiveClass({Cell::Text("Item"), Cell::Text("NSObject")}),
+  }, {{"root", KeyedArchiveUID(1)}});
+
+  // UIDs have to survive the binary round trip the table goes through
+  std::string bytes;
+  ASSERT_EQ(BinaryPlistWriter::write(archive, bytes), true);
+  auto root = KeyedArchive::decode(Buffer::copy(bytes.data(), bytes.size()));
+
+  ASSERT_EQ(root.isRow(), true);
+  ASSERT_EQ(root.size(), (size_t)2);
+  ASSERT_EQ(root["name"].textValue(), "first");
+  const auto &items = root["items"];
+  ASSERT_EQ(items.isColumn(), true);
+  ASSERT_EQ(items.size(), (size_t)2);
+
+  const auto &item = items[(Cell::Index)0];
+  ASSERT_EQ(item["$class"].textValue(), "Item");
+  ASSERT_EQ(item["title"].textValue(), "first");
+  ASSERT_EQ(item["count"].integerValue(), 3);
+  ASSERT_EQ(item["note"].isNull(), true);
+  // the reference back to the root being decoded is a cycle
+  ASSERT_EQ(item["parent"]["CF$UID"].integerValue(), 1);
+
+  // shared objects are decoded once
+  ASSERT_EQ(&item.rowValue(), &items[(Cell::Index)1].rowValue());
+}
+
+TEST(KeyedArchive, Foundation)
+{
+  const auto archive = KeyedArchiveMake({
+    Cell::Text("$null"),
+    Cell::Row{{"$class", KeyedArchiveUID(5)}, {"NS.time", 600000000.5}},
+    Cell::Row{{"$class", KeyedArchiveUID(6)}, {"NS.data", Cell::Blob{1, 2, 3}}},
+    Cell::Row{{"$class", KeyedArchiveUID(7)}, {"NS.bytes", Cell::Blob{'a', 'b'}}},
+    Cell::Row{{"$class", KeyedArchiveUID(8)}},
+    KeyedArchiveClass({Cell::Text("NSDate"), Cell::Text("NSObject")}),
+    KeyedArchiveClass({Cell::Text("NSMutableData"), Cell::Text("NSData"), Cell::Text("NSObject")}),
+    KeyedArchiveClass({Cell::Text("NSMutableString"), Cell::Text("NSString"), Cell::Text("NSObject")}),
+    KeyedArchiveClass({Cell::Text("NSNull"), Cell::Text("NSObject")}),
+  }, {
+    {"date", KeyedArchiveUID(1)},
+    {"data", KeyedArchiveUID(2)},
+    {"string", KeyedArchiveUID(3)},
+    {"null", KeyedArchiveUID(4)},
+    {"missing", KeyedArchiveUID(42)},
+  });
+
+  auto top = KeyedArchive::decode(archive);
+  ASSERT_EQ(top.isRow(), true);
+  ASSERT_EQ(top["date"].isDate(), true);
+  ASSERT_EQ(top["date"].realValue(), 600000000.5);
+  ASSERT_EQ(top["data"].blobValue(), (Cell::Blob{1, 2, 3}));
+  ASSERT_EQ(top["string"].textValue(), "ab");
+  ASSERT_EQ(top["null"].isNull(), true);
+  ASSERT_EQ(top["missing"].isNull(), true);
+
+  ASSERT_EQ(KeyedArchive::isArchive(Cell::Row{{"$top", Cell::Row()}}), false);
+  ASSERT_EQ(KeyedArchive::decode(Cell::Column()).isNull(), true);
+}
+
+TEST(KeyedArchive, Deep)
+{
+  // each array holds the next one, a chain as long as the archive
+  const Cell::Integer depth = 100000;
+  Cell::Column objects{Cell::Text("$null")};
+  for (Cell::Integer uid = 1; uid <= depth; uid++) {
+    objects.push_back(Cell::Row{{"$class", KeyedArchiveUID(depth + 2)}, {"NS.objects", Cell::Column{KeyedArchiveUID(uid + 1)}}});
+  }
+  objects.push_back(Cell::Text("leaf"));
+  objects.push_back(KeyedArchiveClass({Cell::Text("NSArray"), Cell::Text("NSObject")}));
+  auto root = KeyedArchive::decode(KeyedArchiveMake(objects, {{"root", KeyedArchiveUID(1)}}));
+
+  const Cell *cell = &root;
+  for (Cell::Integer level = 0; level < depth; level++) {
+    ASSERT_EQ(cell->isColumn(), true);
+    ASSERT_EQ(cell->size(), (size_t)1);
+    cell = &cell->columnValue()[0];
+  }
+  ASSERT_EQ(cell->textValue(), "leaf");
+}
@@ -0,0 +1,189 @@
+#include <dirent.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include <sqlite3.h>
+#include "Module.h"
+
+/*
+ * the module calls SQLite through the extension API, the library leaves defining it to the loadable extension
+ */
+const sqlite3_api_routines *sqlite3_api = NULL;
+
+static int ModuleTestsInit(sqlite3 *db, char **, const sqlite3_api_routines *api)
+{
+  sqlite3_api = api;
+  return registerModule(db, "plist");
+}
+
+static sqlite3 *ModuleTestsOpen(const std::string &path)
+{
+  sqlite3_auto_extension((void (*)(void))ModuleTestsInit);
+  sqlite3 *db = NULL;
+  if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+    sqlite3_close(db);
+    return NULL;
+  }
+  return db;
+}
+
+static bool ModuleTestsExecute(sqlite3 *db, const std::string &sql)
+{
+  return sqlite3_exec(db, sql.c_str(), NULL, NULL, NULL) == SQLITE_OK;
+}
+
+static std::string ModuleTestsQuery(sqlite3 *db, const std::string &sql)
+{
+  sqlite3_stmt *statement = NULL;
+  if (sqlite3_prepare_v2(db, sql.c_str(), -1, &statement, NULL) != SQLITE_OK) {
+    return "error: " + std::string(sqlite3_errmsg(db));
+  }
+  std::string result;
+  while (sqlite3_step(statement) == SQLITE_ROW) {
+    for (int column = 0; column < sqlite3_column_count(statement); column++) {
+      const char *text = (const char *)sqlite3_column_text(statement, column);
+      result += (column == 0 ? "" : "|") + std::string(text != NULL ? text : "");
+    }
+    result += "\n";
+  }
+  sqlite3_finalize(statement);
+  return result;
+}
+
+static void ModuleTestsWriteFile(const std::string &path, const std::string &contents)
+{
+  FILE *file = fopen(path.c_str(), "w");
+  fwrite(contents.c_str(), 1, contents.length(), file);
+  fclose(file);
+}
+
+static const char *ModuleTestsItems = R"(<plist version="1.0"><array>
+  <dict><key>name</key><string>a</string><key>size</key><integer>1</integer></dict>
+  <dict><key>name</key><string>b</string><key>size</key><integer>2</integer></dict>
+</array></plist>)";
+
+TEST(Module, Materialize)
+{
+  const std::string path = testing::TempDir() + "module-materialize.plist";
+  const std::string database = testing::TempDir() + "module-materialize.db";
+  std::remove(database.c_str());
+  ModuleTestsWriteFile(path, ModuleTestsItems);
+  sqlite3 *db = ModuleTestsOpen(database);
+  ASSERT_NE(db, nullptr);
+  ASSERT_EQ(ModuleTestsExecute(db, "CREATE VIRTUAL TABLE t USING plist(" + path + ", materialize=1, index=name)"), true);
+  ASSERT_EQ(ModuleTestsQuery(db, "SELECT rowid, name, size FROM t_rows"), "0|a|1\n1|b|2\n");
+  ASSERT_EQ(ModuleTestsQuery(db, "SELECT name FROM t ORDER BY size DESC"), "b\na\n");
+
+  // a scan reading the rows keeps them from being replaced, the others read the file's new rows from memory
+  sqlite3_stmt *scan = NULL;
+  ASSERT_EQ(sqlite3_prepare_v2(db, "SELECT name FROM t", -1, &scan, NULL), SQLITE_OK);
+  ASSERT_EQ(sqlite3_step(scan), SQLITE_ROW);
+  // the new document has another field sorting first, the rows keep the declared columns either way
+  ModuleTestsWriteFile(path, R"(<plist version="1.0"><array>
+    <dict><key>age</key><integer>5</integer><key>name</key><string>c</string><key>size</key><integer>9</integer></dict>
+  </array></plist>)");
+  ASSERT_EQ(ModuleTestsQuery(db, "SELECT name, size FROM t"), "c|9\n");
+  ASSERT_EQ(ModuleTestsQuery(db, "SELECT count(*) FROM t_rows"), "2\n");
+  sqlite3_finalize(scan);
+  ASSERT_EQ(ModuleTestsQuery(db, "SELECT name, size FROM t"), "c|9\n");
+  ASSERT_EQ(ModuleTestsQuery(db, "SELECT name, size FROM t_rows"), "c|9\n");
+
+  // only the module writes the rows
+  ASSERT_EQ(sqlite3_db_config(db, SQLITE_DBCONFIG_DEFENSIVE, 1, NULL), SQLITE_OK);
+  ASSERT_EQ(ModuleTestsExecute(db, "DELETE FROM t_rows"), false);
+  ASSERT_EQ(ModuleTestsQuery(db, "SELECT name FROM t"), "c\n");
+
+  // the rows' own rowid can't be shadowed by a field
+  ModuleTestsWriteFile(path, R"(<plist version="1.0"><array><dict><key>ROWID</key><integer>1</integer></dict></array></plist>)");
+  ASSERT_EQ(ModuleTestsExecute(db, "CREATE VIRTUAL TABLE r USING plist(" + path + ", materialize=1)"), false);
+  ASSERT_NE(std::string(sqlite3_errmsg(db)).find("named like the rowid"), std::string::npos);
+  sqlite3_close(db);
+  std::remove(database.c_str());
+  std::remove(path.c_str());
+}
+
+TEST(Module, MaterializePushdown)
+{
+  const std::string path = testing::TempDir() + "module-pushdown.plist";
+  ModuleTestsWriteFile(path, ModuleTestsItems);
+  sqlite3 *db = ModuleTestsOpen(":memory:");
+  ASSERT_NE(db, nullptr);
+  ASSERT_EQ(ModuleTestsExecute(db, "CREATE VIRTUAL TABLE t USING plist(" + path + ", materialize=1, index=name)"), true);
+  // constraints become the WHERE clause of the query over the rows
+  const auto plan = ModuleTestsQuery(db, "EXPLAIN QUERY PLAN SELECT size FROM t WHERE name = 'b' AND size >= 1");
+  ASSERT_NE(plan.find("\"name\" = ? AND \"size\" >= ?"), std::string::npos);
+  ASSERT_EQ(ModuleTestsQuery(db, "SELECT size FROM t WHERE name = 'b' AND size >= 1"), "2\n");
+  ASSERT_EQ(ModuleTestsQuery(db, "SELECT name FROM t WHERE rowid = 0"), "a\n");
+  sqlite3_close(db);
+  std::remove(path.c_str());
+}
+
+TEST(Module, MaterializeRename)
+{
+  const std::string path = testing::TempDir() + "module-rename.plist";
+  ModuleTestsWriteFile(path, ModuleTestsItems);
+  sqlite3 *db = ModuleTestsOpen(":memory:");
+  ASSERT_NE(db, nullptr);
+  ASSERT_EQ(ModuleTestsExecute(db, "CREATE VIRTUAL TABLE t USING plist(" + path + ", materialize=1)"), true);
+  ASSERT_EQ(ModuleTestsExecute(db, "ALTER TABLE t RENAME TO u"), true);
+  const std::string tables = "SELECT name FROM sqlite_master WHERE type = 'table' ORDER BY name";
+  ASSERT_EQ(ModuleTestsQuery(db, tables), "u\nu_rows\nu_source\n");
+  ASSERT_EQ(ModuleTestsQuery(db, "SELECT count(*) FROM u"), "2\n");
+  ASSERT_EQ(ModuleTestsExecute(db, "DROP TABLE u"), true);
+  ASSERT_EQ(ModuleTestsQuery(db, tables), "");
+  sqlite3_close(db);
+  std::remove(path.c_str());
+}
+
+TEST(Module, CacheDirectory)
+{
+  const std::string path = testing::TempDir() + "module-cache.plist";
+  ModuleTestsWriteFile(path, ModuleTestsItems);
+  sqlite3 *db = ModuleTestsOpen(":memory:");
+  ASSERT_NE(db, nullptr);
+  // schemas can't choose where the cache is written
+  ASSERT_EQ(ModuleTestsExecute(db, "CREATE VIRTUAL TABLE d USING plist(" + path + ", cache=" + testing::TempDir() + ")"),
+            false);
+  ASSERT_NE(std::string(sqlite3_errmsg(db)).find("PLIST_CACHE_DIR"), std::string::npos);
+  // the host does
+  std::string directory = testing::TempDir() + "module-cache-XXXXXX";
+  ASSERT_NE(mkdtemp(&directory[0]), nullptr);
+  setenv("PLIST_CACHE_DIR", directory.c_str(), 1);
+  ASSERT_EQ(ModuleTestsExecute(db, "CREATE VIRTUAL TABLE t USING plist(" + path + ", cache=1)"), true);
+  unsetenv("PLIST_CACHE_DIR");
+  ASSERT_EQ(ModuleTestsQuery(db, "SELECT name FROM t"), "a\nb\n");
+  sqlite3_close(db);
+  size_t count = 0;
+  DIR *entries = opendir(directory.c_str());
+  while (struct dirent *entry = readdir(entries)) {
+    if (entry->d_name[0] != '.') {
+      std::remove((directory + "/" + entry->d_name).c_str());
+      count++;
+    }
+  }
+  closedir(entries);
+  rmdir(directory.c_str());
+  ASSERT_EQ(count, (size_t)1);
+  std::remove(path.c_str());
+}
+
+TEST(Module, SampleLoadsInBackground)
+{
+  const std::string path = testing::TempDir() + "module-sample.plist";
+  std::string contents = R"(<plist version="1.0"><array>)";
+  for (int index = 0; index < 10000; index++) {
+    contents += "<dict><key>name</key><string>item " + std::to_string(index) + "</string></dict>";
+  }
+  ModuleTestsWriteFile(path, contents + "</array></plist>");
+  sqlite3 *db = ModuleTestsOpen(":memory:");
+  ASSERT_NE(db, nullptr);
+  // the rows don't fit the memory limit, the sample does: xCreate returns without waiting for the rows, whose
+  // failure is reported by the first scan
+  ASSERT_EQ(ModuleTestsExecute(db, "CREATE VIRTUAL TABLE t USING plist(" + path + ", sample=10, memory_limit=65536)"),
+            true);
+  ASSERT_EQ(ModuleTestsQuery(db, "PRAGMA table_info(t)").find("name"), (size_t)2);
+  ASSERT_EQ(ModuleTestsExecute(db, "SELECT count(*) FROM t"), false);
+  ASSERT_NE(std::string(sqlite3_errmsg(db)).find("memory limit"), std::string::npos);
+  sqlite3_close(db);
+  std::remove(path.c_str());
+}
@@ -0,0 +1,322 @@
+#include <gtest/gtest.h>
+#include <climits>
+#include <cmath>
+#include "BinaryPlistWriter.hpp"
+#include "PlistReader.hpp"
+#include "XmlPlistWriter.hpp"
+
+/*
+ * {"a": {"b": {"c": 1}}, "e": "x", "k": "ключ"}
+ */
+static const uint8_t binaryPlist[] = {
+  0x62, 0x70, 0x6c, 0x69, 0x73, 0x74, 0x30, 0x30, 0xd3, 0x01, 0x02, 0x03, 0x04, 0x09, 0x0a, 0x51,
+  0x61, 0x51, 0x65, 0x51, 0x6b, 0xd1, 0x05, 0x06, 0x51, 0x62, 0xd1, 0x07, 0x08, 0x51, 0x63, 0x10,
+  0x01, 0x51, 0x78, 0x64, 0x04, 0x3a, 0x04, 0x3b, 0x04, 0x4e, 0x04, 0x47, 0x08, 0x0f, 0x11, 0x13,
+  0x15, 0x18, 0x1a, 0x1d, 0x1f, 0x21, 0x23, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x01, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0b, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x2c
+};
+
+TEST(PlistReader, Unsupported)
+{
+  std::string text = "{ a = b; }";
+  ASSERT_EQ(PlistReader::create(Buffer::copy(text.c_str(), text.length())), nullptr);
+  ASSERT_EQ(PlistReader::create(Buffer::copy(binaryPlist, 40)), nullptr);
+}
+
+TEST(PlistReader, Binary)
+{
+  auto reader = PlistReader::create(Buffer::copy(binaryPlist, sizeof(binaryPlist)));
+  ASSERT_NE(reader, nullptr);
+  auto cell = reader->read(reader->getRoot(), INT_MAX);
+  ASSERT_EQ(cell.isRow(), true);
+  ASSERT_EQ(cell.size(), (size_t)3);
+  ASSERT_EQ(cell["a"]["b"]["c"].integerValue(), 1);
+  ASSERT_EQ(cell["e"].textValue(), "x");
+  ASSERT_EQ(cell["k"].textValue(), "ключ");
+}
+
+TEST(PlistReader, BinaryKeyPath)
+{
+  auto reader = PlistReader::create(Buffer::copy(binaryPlist, sizeof(binaryPlist)));
+  ASSERT_NE(reader, nullptr);
+  PlistReader::Node node;
+  ASSERT_EQ(reader->findKeyPath("a.b", node), true);
+  ASSERT_EQ(reader->getType(node), Cell::ROW);
+  ASSERT_EQ(reader->read(node, INT_MAX)["c"].integerValue(), 1);
+  ASSERT_EQ(reader->findKeyPath("a.x", node), false);
+  ASSERT_EQ(reader->findKeyPath("e.b", node), false);
+}
+
+TEST(PlistReader, BinaryDepth)
+{
+  auto reader = PlistReader::create(Buffer::copy(binaryPlist, sizeof(binaryPlist)));
+  ASSERT_NE(reader, nullptr);
+  auto cell = reader->read(reader->getRoot(), 1);
+  ASSERT_EQ(cell["a"].isRow(), true);
+  const size_t usage = cell.memoryUsage();
+  ASSERT_EQ(cell["a"]["b"]["c"].integerValue(), 1);
+  ASSERT_GT(cell.memoryUsage(), usage);
+}
+
+TEST(PlistReader, BinaryNull)
+{
+  // [1, null, {"a": null}]
+  const uint8_t bytes[] = {
+    0x62, 0x70, 0x6c, 0x69, 0x73, 0x74, 0x30, 0x30, 0xa3, 0x01, 0x02, 0x03, 0x10, 0x01, 0x00, 0xd1,
+    0x04, 0x02, 0x51, 0x61, 0x08, 0x0c, 0x0e, 0x0f, 0x12, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x14
+  };
+  auto reader = PlistReader::create(Buffer::copy(bytes, sizeof(bytes)));
+  ASSERT_NE(reader, nullptr);
+  auto cell = reader->read(reader->getRoot(), INT_MAX);
+  ASSERT_EQ(cell.isColumn(), true);
+  ASSERT_EQ(cell.size(), (size_t)3);
+  ASSERT_EQ(cell[0].integerValue(), 1);
+  ASSERT_EQ(cell[1].isNull(), true);
+  ASSERT_EQ(cell[2].isRow(), true);
+  ASSERT_EQ(cell[2]["a"].isNull(), true);
+  ASSERT_EQ(cell[2].size(), (size_t)1);
+}
+
+TEST(PlistReader, XmlDepth)
+{
+  std::string xml = R"(
+<?xml version="1.0" encoding="UTF-8"?>
+<!DOCTYPE plist PUBLIC "-//Apple//DTD PLIST 1.0//EN" "http://www.apple.com/DTDs/ PropertyList-1.0.dtd">
+<plist version="1.0">
+  <dict>
+    <key>a</key>
+    <dict>
+      <key>b</key>
+      <array>
+        <!-- comment -->
+        <string><![CDATA[<c>]]> &amp; &#x44;</string>
+        <date>2001-01-02T00:00:01Z</date>
+        <data>AAEC
+          Aw==</data>
+      </array>
+    </dict>
+  </dict>
+</plist>
+)";
+  auto reader = PlistReader::create(Buffer::copy(xml.c_str(), xml.length()));
+  ASSERT_NE(reader, nullptr);
+  auto cell = reader->read(reader->getRoot(), 1);
+  ASSERT_EQ(cell["a"].isRow(), true);
+  auto &array = cell["a"]["b"];
+  ASSERT_EQ(array.isColumn(), true);
+  ASSERT_EQ(array.size(), (size_t)3);
+  ASSERT_EQ(array[0].textValue(), "<c> & D");
+  ASSERT_EQ(array[1].realValue(), 86401);
+  ASSERT_EQ(array[2].blobValue(), Cell::Blob({0, 1, 2, 3}));
+}
+
+TEST(PlistReader, XmlMalformedSubtree)
+{
+  std::string xml = R"(
+<plist version="1.0">
+  <dict>
+    <key>a</key>
+    <dict>
+      <key>b</key>
+      <integer>one</integer>
+    </dict>
+  </dict>
+</plist>
+)";
+  auto reader = PlistReader::create(Buffer::copy(xml.c_str(), xml.length()));
+  ASSERT_NE(reader, nullptr);
+  ASSERT_EQ(reader->read(reader->getRoot(), INT_MAX).isValid(), false);
+  auto cell = reader->read(reader->getRoot(), 1);
+  ASSERT_EQ(cell["a"].isRow(), true);
+  ASSERT_EQ(cell["a"]["b"].isValid(), false);
+}
+
+TEST(PlistReader, Slice)
+{
+  auto reader = PlistReader::create(Buffer::copy(binaryPlist, sizeof(binaryPlist)));
+  ASSERT_NE(reader, nullptr);
+  PlistReader::Node node;
+  ASSERT_EQ(reader->findKeyPath("a", node), true);
+  std::string bytes;
+  ASSERT_EQ(reader->slice(node, bytes), true);
+  ASSERT_LT(bytes.size(), sizeof(binaryPlist));
+  auto slice = PlistReader::create(Buffer::copy(bytes.data(), bytes.size()));
+  ASSERT_NE(slice, nullptr);
+  auto cell = slice->read(slice->getRoot(), INT_MAX);
+  ASSERT_EQ(cell.size(), (size_t)1);
+  ASSERT_EQ(cell["b"]["c"].integerValue(), 1);
+
+  std::string xml;
+  const Cell text("x");
+  ASSERT_EQ(XmlPlistWriter::write(Cell::Row{{"a", Cell::Column{text, Cell::Row{{"b", text}}}}, {"c", (Cell::Integer)2}}, xml), true);
+  reader = PlistReader::create(Buffer::copy(xml.data(), xml.size()));
+  ASSERT_NE(reader, nullptr);
+  ASSERT_EQ(reader->findKeyPath("a", node), true);
+  ASSERT_EQ(reader->slice(node, bytes), true);
+  ASSERT_EQ(bytes.compare(0, 5, "<?xml"), 0);
+  slice = PlistReader::create(Buffer::copy(bytes.data(), bytes.size()));
+  ASSERT_NE(slice, nullptr);
+  cell = slice->read(slice->getRoot(), INT_MAX);
+  ASSERT_EQ(cell.size(), (size_t)2);
+  ASSERT_EQ(cell[1]["b"].textValue(), "x");
+}
+
+TEST(PlistReader, Next)
+{
+  std::string xml = R"(<plist version="1.0"><dict><key>a</key><array><integer>1</integer><!-- 2 --><string>3</string></array><key>e</key><dict/></dict></plist>)";
+  auto readers = {PlistReader::create(Buffer::copy(xml.c_str(), xml.length())),
+                  PlistReader::create(Buffer::copy(binaryPlist, sizeof(binaryPlist)))};
+  for (auto &reader : readers) {
+    ASSERT_NE(reader, nullptr);
+    size_t position = 0;
+    PlistReader::Node item;
+    std::string key;
+    ASSERT_EQ(reader->next(reader->getRoot(), position, item, key), true);
+    ASSERT_EQ(key, "a");
+    ASSERT_EQ(reader->next(reader->getRoot(), position, item, key), true);
+    ASSERT_EQ(key, "e");
+    const PlistReader::Node last = item;
+    ASSERT_EQ(reader->findKeyPath("a", item), true);
+    size_t itemPosition = 0;
+    size_t count = 0;
+    PlistReader::Node child;
+    while (reader->next(item, itemPosition, child, key)) {
+      count++;
+    }
+    ASSERT_EQ(count, reader->read(item, INT_MAX).size());
+    // an empty dictionary in one, a string in the other
+    itemPosition = 0;
+    ASSERT_EQ(reader->next(last, itemPosition, child, key), false);
+  }
+}
+
+TEST(PlistReader, XmlBlocks)
+{
+  // whitespace, entities and markup at every offset within and across the scanners' 16 byte blocks
+  for (size_t padding = 0; padding < 40; padding++) {
+    const std::string space(padding, padding % 2 == 0 ? '\t' : ' ');
+    const std::string text = std::string(padding, 'x') + "&amp;" + std::string(padding % 17, 'y');
+    std::string xml = "<plist>" + space + "\n<array>" + space + "<string>" + text + "</string>" + space +
+                      "<dict>" + space + "<key>k</key>" + space + "<true/></dict>\r\n</array>" + space + "</plist>";
+    auto reader = PlistReader::create(Buffer::copy(xml.c_str(), xml.length()));
+    ASSERT_NE(reader, nullptr);
+    auto cell = reader->read(reader->getRoot(), INT_MAX);
+    ASSERT_EQ(cell.size(), (size_t)2);
+    ASSERT_EQ(cell[0].textValue(), std::string(padding, 'x') + "&" + std::string(padding % 17, 'y'));
+    ASSERT_EQ(cell[1]["k"].integerValue(), 1);
+
+    // the unterminated text runs into the end of the buffer
+    xml = "<plist><string>" + text;
+    ASSERT_EQ(PlistReader::create(Buffer::copy(xml.c_str(), xml.length())), nullptr);
+  }
+}
+
+TEST(PlistReader, XmlData)
+{
+  // every length, broken by whitespace at every offset within the decoder's 16 character blocks
+  const char *alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  for (size_t length = 0; length < 64; length++) {
+    Cell::Blob blob;
+    for (size_t index = 0; index < length; index++) {
+      blob.push_back((uint8_t)(index * 37 + length));
+    }
+    std::string base64;
+    for (size_t index = 0; index < length; index += 3) {
+      const uint32_t word = (uint32_t)blob[index] << 16 | (index + 1 < length ? blob[index + 1] << 8 : 0) |
+                            (index + 2 < length ? blob[index + 2] : 0);
+      for (size_t digit = 0; digit < 4; digit++) {
+        base64.push_back(index + digit <= length ? alphabet[(word >> (18 - 6 * digit)) & 63] : '=');
+      }
+    }
+    const size_t width = length % 23 + 1;
+    std::string text;
+    for (size_t index = 0; index < base64.size(); index += width) {
+      text += base64.substr(index, width) + (index % 2 == 0 ? "\n\t" : " ");
+    }
+    // a comment makes the text go through unescaping first
+    const std::string xml = "<plist><array><data>" + text + "</data><data>" + text + "<!-- -->\n</data></array></plist>";
+    auto reader = PlistReader::create(Buffer::copy(xml.c_str(), xml.length()));
+    ASSERT_NE(reader, nullptr);
+    auto cell = reader->read(reader->getRoot(), INT_MAX);
+    ASSERT_EQ(cell.size(), (size_t)2);
+    ASSERT_EQ(cell[0].blobValue(), blob);
+    ASSERT_EQ(cell[1].blobValue(), blob);
+  }
+
+  for (auto text : {"QUJD*EVGR0hJSktMTU5PUFFS", "QUJDREVGR0hJSktMTU5PUFF\xC3\xA9", "QUJD&lt;"}) {
+    const std::string xml = std::string("<plist><data>") + text + "</data></plist>";
+    auto reader = PlistReader::create(Buffer::copy(xml.c_str(), xml.length()));
+    ASSERT_NE(reader, nullptr);
+    ASSERT_FALSE(reader->read(reader->getRoot(), INT_MAX).isValid());
+  }
+
+  // a whole block, and decoding stops at the padding
+  const std::string xml = "<plist><data>QUJDREVGR0hJSktMTU5PUFFS==QUJD</data></plist>";
+  const std::string text = "ABCDEFGHIJKLMNOPQR";
+  auto reader = PlistReader::create(Buffer::copy(xml.c_str(), xml.length()));
+  ASSERT_EQ(reader->read(reader->getRoot(), INT_MAX).blobValue(), Cell::Blob(text.begin(), text.end()));
+}
+
+TEST(PlistReader, XmlNumbers)
+{
+  std::string xml = R"(
+<plist><array>
+  <integer> -0x7fffffffffffffff </integer>
+  <integer>18446744073709551615</integer>
+  <real>
+    0.1
+  </real>
+  <real>1.7976931348623157e308</real>
+  <real>-infinity</real>
+  <real>1<!-- -->.5</real>
+  <date>1999-12-31T23:59:59Z</date>
+</array></plist>
+)";
+  auto reader = PlistReader::create(Buffer::copy(xml.c_str(), xml.length()));
+  ASSERT_NE(reader, nullptr);
+  auto cell = reader->read(reader->getRoot(), INT_MAX);
+  ASSERT_EQ(cell.size(), (size_t)7);
+  ASSERT_EQ(cell[0].integerValue(), -INT64_MAX);
+  ASSERT_EQ(cell[1].integerValue(), -1);
+  ASSERT_EQ(cell[2].realValue(), 0.1);
+  ASSERT_EQ(cell[3].realValue(), 1.7976931348623157e308);
+  ASSERT_EQ(cell[4].realValue(), -HUGE_VAL);
+  ASSERT_EQ(cell[5].realValue(), 1.5);
+  ASSERT_TRUE(cell[6].isDate());
+  ASSERT_EQ(cell[6].realValue(), -31622401);
+
+  for (auto value : {"<integer>18446744073709551616</integer>", "<integer>0x</integer>", "<real>1,5</real>",
+                     "<real>1e</real>", "<date>2020-1-01T00:00:00Z</date>", "<date>2020-01-01 00:00:00Z</date>",
+                     "<date>2020-13-01T00:00:00Z</date>"}) {
+    xml = std::string("<plist>") + value + "</plist>";
+    reader = PlistReader::create(Buffer::copy(xml.c_str(), xml.length()));
+    ASSERT_NE(reader, nullptr);
+    ASSERT_FALSE(reader->read(reader->getRoot(), INT_MAX).isValid()) << value;
+  }
+}
+
+TEST(PlistReader, Deep)
+{
+  // writers and readers alike keep the containers they're in on the heap
+  const int depth = 200000;
+  Cell deep = (Cell::Integer)1;
+  for (int level = 0; level < depth; level++) {
+    deep = level % 2 == 0 ? Cell(Cell::Column{deep}) : Cell(Cell::Row{{"a", deep}});
+  }
+  for (int format = 0; format < 2; format++) {
+    std::string bytes;
+    ASSERT_EQ(format == 0 ? BinaryPlistWriter::write(deep, bytes) : XmlPlistWriter::write(deep, bytes), true);
+    auto reader = PlistReader::create(Buffer::copy(bytes.data(), bytes.size()));
+    ASSERT_NE(reader, nullptr);
+    const auto cell = reader->read(reader->getRoot(), INT_MAX);
+    const Cell *item = &cell;
+    for (int level = depth - 1; level >= 0; level--) {
+      ASSERT_EQ(item->isColumn(), level % 2 == 0);
+      item = level % 2 == 0 ? &item->columnValue()[0] : &item->rowValue().at("a");
+    }
+    ASSERT_EQ(item->integerValue(), 1);
+  }
+}
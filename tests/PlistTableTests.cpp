@@ -1,4 +1,6 @@
 #include <gtest/gtest.h>
+#include <thread>
+#include <utime.h>
 #include "PlistTable.hpp"
 
 
@@ -406,3 +408,713 @@ TEST(PlistTable, CamelcaseNames)
   ASSERT_NE(std::find(fields.begin(), fields.end(), "key1.key3"), fields.end());
   ASSERT_NE(std::find(fields.begin(), fields.end(), "key1.key4._"), fields.end());
 }
+
+TEST(PlistTable, MemoryUsage)
+{
+  std::string xml = R"(
+<?xml version="1.0" encoding="UTF-8"?>
+<!DOCTYPE plist PUBLIC "-//Apple//DTD PLIST 1.0//EN" "http://www.apple.com/DTDs/ PropertyList-1.0.dtd">
+<plist version="1.0">
+  <dict>
+    <key>key1</key>
+    <array>
+      <string>a rather long string that does not fit inline</string>
+      <integer>2</integer>
+    </array>
+    <key>key2</key>
+    <array>
+      <integer>3</integer>
+      <integer>4</integer>
+    </array>
+  </dict>
+</plist>
+)";
+  const size_t totalBefore = PlistTable::getTotalMemoryUsage();
+  {
+    PlistTable table;
+    ASSERT_EQ(table.load(xml.c_str(), xml.length(), 0), true);
+    ASSERT_GT(table.getMemoryUsage(), Table<Cell>::memoryUsage(2, 4));
+    ASSERT_EQ(PlistTable::getTotalMemoryUsage(), totalBefore + table.getMemoryUsage());
+  }
+  ASSERT_EQ(PlistTable::getTotalMemoryUsage(), totalBefore);
+}
+
+TEST(PlistTable, Types)
+{
+  std::string xml = R"(
+<?xml version="1.0" encoding="UTF-8"?>
+<!DOCTYPE plist PUBLIC "-//Apple//DTD PLIST 1.0//EN" "http://www.apple.com/DTDs/ PropertyList-1.0.dtd">
+<plist version="1.0">
+  <array>
+    <dict>
+      <key>name</key><string>a</string>
+      <key>size</key><integer>1</integer>
+      <key>done</key><true/>
+      <key>other</key><string>b</string>
+    </dict>
+    <dict>
+      <key>name</key><string>c</string>
+      <key>done</key><false/>
+      <key>other</key><real>1.5</real>
+    </dict>
+  </array>
+</plist>
+)";
+  PlistTable table;
+  ASSERT_EQ(table.load(xml.c_str(), xml.length(), 0), true);
+  const auto &fields = table.getFields();
+  const auto types = table.getTypes();
+  ASSERT_EQ(types.size(), fields.size());
+  std::map<std::string, TypedColumn::Type> fieldTypes;
+  for (size_t column = 0; column < fields.size(); column++) {
+    fieldTypes[fields[column]] = types[column];
+  }
+  ASSERT_EQ(fieldTypes["name"], TypedColumn::TEXT);
+  ASSERT_EQ(fieldTypes["size"], TypedColumn::INTEGER);
+  ASSERT_EQ(fieldTypes["done"], TypedColumn::BOOLEAN);
+  ASSERT_EQ(fieldTypes["other"], TypedColumn::MIXED);
+
+  const int done = (int)(std::find(fields.begin(), fields.end(), "done") - fields.begin());
+  const int size = (int)(std::find(fields.begin(), fields.end(), "size") - fields.begin());
+  ASSERT_TRUE(table.getCell(1, done).isBoolean());
+  ASSERT_EQ(table.getCell(1, done).integerValue(), 0);
+  ASSERT_TRUE(table.getCell(1, size).isNull());
+}
+
+TEST(PlistTable, Records)
+{
+  std::string xml = R"(
+<?xml version="1.0" encoding="UTF-8"?>
+<!DOCTYPE plist PUBLIC "-//Apple//DTD PLIST 1.0//EN" "http://www.apple.com/DTDs/ PropertyList-1.0.dtd">
+<plist version="1.0">
+  <array>
+    <dict>
+      <key>Name</key><string>x</string>
+      <key>n</key><integer>1</integer>
+    </dict>
+    <integer>5</integer>
+    <dict/>
+    <dict>
+      <key>sub</key><dict><key>a</key><integer>2</integer></dict>
+    </dict>
+    <dict>
+      <key>Name</key><string>y</string>
+      <key>z</key><real>1.5</real>
+    </dict>
+  </array>
+</plist>
+)";
+  PlistTable table;
+  ASSERT_EQ(table.load(xml.c_str(), xml.length(), 0), true);
+  // the empty dictionary has no row, new fields come in the order of their names
+  ASSERT_EQ(table.getFields(), std::vector<std::string>({"n", "name", "_", "sub.a", "z"}));
+  ASSERT_EQ(table.getHeight(), (size_t)4);
+  ASSERT_EQ(table.getCell(0, 1).textValue(), "x");
+  ASSERT_EQ(table.getCell(0, 0).integerValue(), 1);
+  ASSERT_TRUE(table.getCell(0, 2).isNull());
+  ASSERT_EQ(table.getCell(1, 2).integerValue(), 5);
+  ASSERT_TRUE(table.getCell(1, 1).isNull());
+  ASSERT_EQ(table.getCell(2, 3).integerValue(), 2);
+  ASSERT_EQ(table.getCell(3, 1).textValue(), "y");
+  ASSERT_EQ(table.getCell(3, 4).realValue(), 1.5);
+  ASSERT_TRUE(table.getCell(3, 0).isNull());
+}
+
+TEST(PlistTable, Deep)
+{
+  // values under empty keys keep the name of their dictionary, every level adds a row to "_"
+  std::string xml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<plist version=\"1.0\">";
+  const int depth = 1000;
+  for (int level = 0; level < depth; level++) {
+    xml += "<dict><key></key><array><integer>" + std::to_string(level) + "</integer>";
+  }
+  for (int level = 0; level < depth; level++) {
+    xml += "</array></dict>";
+  }
+  xml += "</plist>";
+  PlistTable table;
+  ASSERT_EQ(table.load(xml.c_str(), xml.length(), 0), true);
+  ASSERT_EQ(table.getFields(), std::vector<std::string>({"_"}));
+  ASSERT_EQ(table.getHeight(), (size_t)depth);
+  ASSERT_EQ(table.getCell(0, 0).integerValue(), 0);
+  ASSERT_EQ(table.getCell(depth - 1, 0).integerValue(), depth - 1);
+}
+
+TEST(PlistTable, MemoryLimitExceeded)
+{
+  std::string xml = R"(
+<?xml version="1.0" encoding="UTF-8"?>
+<!DOCTYPE plist PUBLIC "-//Apple//DTD PLIST 1.0//EN" "http://www.apple.com/DTDs/ PropertyList-1.0.dtd">
+<plist version="1.0">
+  <dict>
+    <key>key1</key>
+    <array>
+      <integer>1</integer>
+      <integer>2</integer>
+    </array>
+    <key>key2</key>
+    <array>
+      <integer>3</integer>
+      <integer>4</integer>
+    </array>
+  </dict>
+</plist>
+)";
+  const size_t totalBefore = PlistTable::getTotalMemoryUsage();
+  PlistTable table;
+  table.setMemoryLimit(1);
+  ASSERT_EQ(table.load(xml.c_str(), xml.length(), 0), false);
+  ASSERT_NE(table.getError().find("memory limit"), std::string::npos);
+  ASSERT_EQ(table.getMemoryUsage(), (size_t)0);
+  ASSERT_EQ(PlistTable::getTotalMemoryUsage(), totalBefore);
+
+  table.setMemoryLimit(0);
+  PlistTable::setGlobalMemoryLimit(totalBefore + 1);
+  const bool isLoaded = table.load(xml.c_str(), xml.length(), 0);
+  PlistTable::setGlobalMemoryLimit(0);
+  ASSERT_EQ(isLoaded, false);
+  ASSERT_NE(table.getError().find("global memory limit"), std::string::npos);
+  ASSERT_EQ(PlistTable::getTotalMemoryUsage(), totalBefore);
+
+  ASSERT_EQ(table.load(xml.c_str(), xml.length(), 0), true);
+  ASSERT_EQ(table.getError().empty(), true);
+  ASSERT_EQ(table.getHeight(), (size_t)4);
+}
+
+static void PlistTableWriteFile(const std::string &path, const std::string &contents)
+{
+  FILE *file = fopen(path.c_str(), "w");
+  fwrite(contents.c_str(), 1, contents.length(), file);
+  fclose(file);
+}
+
+static std::string PlistTableReadFile(const std::string &path)
+{
+  std::string contents;
+  FILE *file = fopen(path.c_str(), "r");
+  char buffer[4096];
+  for (size_t size; (size = fread(buffer, 1, sizeof(buffer), file)) > 0;) {
+    contents.append(buffer, size);
+  }
+  fclose(file);
+  return contents;
+}
+
+TEST(PlistTable, StreamDeep)
+{
+  // streamed elements are decoded whole, however deep they nest
+  const std::string path = testing::TempDir() + "stream-deep.plist";
+  const int depth = 200000;
+  std::string xml = "<plist version=\"1.0\"><array><dict><key>a</key>";
+  for (int level = 0; level < depth; level++) {
+    xml += "<dict><key></key>";
+  }
+  xml += "<integer>1</integer>";
+  for (int level = 0; level < depth; level++) {
+    xml += "</dict>";
+  }
+  xml += "</dict></array></plist>";
+  PlistTableWriteFile(path, xml);
+
+  PlistTable table;
+  table.setStreaming(true);
+  ASSERT_EQ(table.load(path, 0, ""), true);
+  ASSERT_EQ(table.getFields(), std::vector<std::string>({"a"}));
+  std::shared_ptr<PlistReader> reader;
+  PlistReader::Node node;
+  ASSERT_EQ(table.openStream(reader, node), true);
+  size_t position = 0;
+  std::shared_ptr<const PlistTable::Snapshot> snapshot;
+  ASSERT_EQ(table.readStream(*reader, node, position, snapshot), true);
+  ASSERT_NE(snapshot, nullptr);
+  ASSERT_EQ(snapshot->getHeight(), (size_t)1);
+  ASSERT_EQ(snapshot->getCell(0, 0).integerValue(), 1);
+  std::remove(path.c_str());
+}
+
+TEST(PlistTable, ReloadSync)
+{
+  const std::string path = testing::TempDir() + "reload-sync.plist";
+  PlistTableWriteFile(path, R"(<plist version="1.0"><array><integer>1</integer></array></plist>)");
+  PlistTable table;
+  table.setReloadMode(PlistTable::RELOAD_SYNC);
+  ASSERT_EQ(table.load(path, 0, ""), true);
+  auto snapshot = table.getSnapshot();
+  ASSERT_EQ(snapshot->getHeight(), (size_t)1);
+
+  table.refresh();
+  ASSERT_EQ(table.getSnapshot(), snapshot);
+
+  PlistTableWriteFile(path, R"(<plist version="1.0"><array><integer>1</integer><integer>2</integer></array></plist>)");
+  table.refresh();
+  ASSERT_EQ(table.getHeight(), (size_t)2);
+  ASSERT_EQ(table.getCell(1, 0).integerValue(), 2);
+  ASSERT_EQ(snapshot->getHeight(), (size_t)1);
+  std::remove(path.c_str());
+}
+
+TEST(PlistTable, ReloadFailed)
+{
+  const std::string path = testing::TempDir() + "reload-failed.plist";
+  PlistTableWriteFile(path, R"(<plist version="1.0"><array><integer>1</integer></array></plist>)");
+  PlistTable table;
+  table.setReloadMode(PlistTable::RELOAD_SYNC);
+  ASSERT_EQ(table.load(path, 0, ""), true);
+  auto snapshot = table.getSnapshot();
+
+  PlistTableWriteFile(path, R"(<plist version="1.0"><array><integer>)");
+  ASSERT_EQ(table.refresh(), false);
+  ASSERT_EQ(table.getError().empty(), false);
+  ASSERT_EQ(table.refresh(), false);
+  ASSERT_EQ(table.getSnapshot(), snapshot);
+
+  PlistTableWriteFile(path, R"(<plist version="1.0"><array><integer>1</integer><integer>2</integer></array></plist>)");
+  ASSERT_EQ(table.refresh(), true);
+  ASSERT_EQ(table.getHeight(), (size_t)2);
+  std::remove(path.c_str());
+}
+
+TEST(PlistTable, ReloadKeepsFields)
+{
+  const std::string path = testing::TempDir() + "reload-fields.plist";
+  PlistTableWriteFile(path, R"(<plist version="1.0"><dict><key>a</key><integer>1</integer></dict></plist>)");
+  PlistTable table;
+  table.setReloadMode(PlistTable::RELOAD_BACKGROUND);
+  ASSERT_EQ(table.load(path, 0, ""), true);
+
+  PlistTableWriteFile(path, R"(<plist version="1.0"><dict><key>b</key><integer>2</integer><key>c</key><integer>3</integer></dict></plist>)");
+  table.refresh();
+  while (table.isReloading()) {
+    std::this_thread::yield();
+  }
+  ASSERT_EQ(table.getFields(), std::vector<std::string>{"a"});
+  ASSERT_EQ(table.getHeight(), (size_t)1);
+  ASSERT_EQ(table.getCell(0, 0).isNull(), true);
+  std::remove(path.c_str());
+}
+
+TEST(PlistTable, ReloadOff)
+{
+  const std::string path = testing::TempDir() + "reload-off.plist";
+  PlistTableWriteFile(path, R"(<plist version="1.0"><array><integer>1</integer></array></plist>)");
+  PlistTable table;
+  table.setReloadMode(PlistTable::RELOAD_OFF);
+  ASSERT_EQ(table.load(path, 0, ""), true);
+  PlistTableWriteFile(path, R"(<plist version="1.0"><array><integer>1</integer><integer>2</integer></array></plist>)");
+  table.refresh();
+  ASSERT_EQ(table.isReloading(), false);
+  ASSERT_EQ(table.getHeight(), (size_t)1);
+  std::remove(path.c_str());
+}
+
+TEST(PlistTable, Write)
+{
+  const std::string path = testing::TempDir() + "write.plist";
+  PlistTableWriteFile(path, R"(<plist version="1.0"><dict><key>Items</key><array>
+    <dict><key>Name</key><string>a</string><key>Done</key><true/><key>Meta</key><dict><key>Size</key><integer>1</integer></dict></dict>
+    <dict><key>Name</key><string>b</string><key>Done</key><false/></dict>
+    <dict><key>Name</key><string>c</string><key>Done</key><false/></dict>
+  </array><key>Version</key><integer>2</integer></dict></plist>)");
+  PlistTable table;
+  table.setWritable(true);
+  ASSERT_EQ(table.load(path, 0, "Items"), true);
+  ASSERT_EQ(table.getFields(), (std::vector<std::string>{"done", "meta.size", "name"}));
+
+  ASSERT_EQ(table.begin(), true);
+  ASSERT_EQ(table.update(1, {(Cell::Integer)1, (Cell::Integer)5, Cell::Text("b")}), true);
+  ASSERT_EQ(table.remove(2), true);
+  int64_t rowid;
+  ASSERT_EQ(table.insert({nullptr, nullptr, Cell::Text("d")}, rowid), true);
+  ASSERT_EQ(rowid, 3);
+  ASSERT_EQ(table.update(rowid, {nullptr, nullptr, Cell::Text("e")}), true);
+  ASSERT_EQ(table.remove(5), false);
+
+  // scans keep the rows the transaction began with, the file changes once it's synced, the rows once it's committed
+  table.refresh();
+  ASSERT_EQ(table.getHeight(), (size_t)3);
+  ASSERT_EQ(table.getCell(2, 2).textValue(), "c");
+  ASSERT_EQ(Plist::parse(path)["Items"].size(), (size_t)3);
+  ASSERT_EQ(table.sync(), true);
+  table.commit();
+  ASSERT_EQ(table.getHeight(), (size_t)3);
+  ASSERT_EQ(table.getCell(2, 2).textValue(), "e");
+
+  // an XML document stays XML
+  ASSERT_EQ(PlistTableReadFile(path).compare(0, 5, "<?xml"), 0);
+  auto plist = Plist::parse(path);
+  ASSERT_EQ(plist["Version"].integerValue(), 2);
+  auto &items = plist["Items"];
+  ASSERT_EQ(items.size(), (size_t)3);
+  ASSERT_EQ(items[0]["Done"].isBoolean(), true);
+  ASSERT_EQ(items[0]["Meta"]["Size"].integerValue(), 1);
+  ASSERT_EQ(items[1]["Done"].isBoolean(), true);
+  ASSERT_EQ(items[1]["Done"].integerValue(), 1);
+  ASSERT_EQ(items[1]["Meta"]["Size"].integerValue(), 5);
+  ASSERT_EQ(items[2]["Name"].textValue(), "e");
+  ASSERT_EQ(items[2].size(), (size_t)1);
+
+  // the table's own write doesn't trigger a reload
+  auto snapshot = table.getSnapshot();
+  table.refresh();
+  ASSERT_EQ(table.getSnapshot(), snapshot);
+  ASSERT_EQ(table.getCell(1, 1).integerValue(), 5);
+  std::remove(path.c_str());
+}
+
+TEST(PlistTable, WriteRollback)
+{
+  const std::string path = testing::TempDir() + "write-rollback.plist";
+  const std::string contents = R"(<plist version="1.0"><array><dict><key>a</key><integer>1</integer></dict></array></plist>)";
+  PlistTableWriteFile(path, contents);
+  PlistTable table;
+  table.setWritable(true);
+  ASSERT_EQ(table.load(path, 0, ""), true);
+  auto snapshot = table.getSnapshot();
+
+  ASSERT_EQ(table.begin(), true);
+  ASSERT_EQ(table.remove(0), true);
+  ASSERT_EQ(table.sync(), true);
+  ASSERT_EQ(Plist::parse(path).size(), (size_t)0);
+  // the bytes the transaction began with are written back as they were
+  table.rollback();
+  ASSERT_EQ(table.getSnapshot(), snapshot);
+  ASSERT_EQ(PlistTableReadFile(path), contents);
+  std::remove(path.c_str());
+}
+
+TEST(PlistTable, WriteEmptyRow)
+{
+  const std::string path = testing::TempDir() + "write-empty-row.plist";
+  PlistTableWriteFile(path, R"(<plist version="1.0"><array><dict><key>a</key><integer>1</integer></dict></array></plist>)");
+  PlistTable table;
+  table.setWritable(true);
+  ASSERT_EQ(table.load(path, 0, ""), true);
+
+  // a row without values gets its own rowid too
+  ASSERT_EQ(table.begin(), true);
+  int64_t empty, filled;
+  ASSERT_EQ(table.insert({nullptr}, empty), true);
+  ASSERT_EQ(table.insert({(Cell::Integer)2}, filled), true);
+  ASSERT_EQ(empty, 1);
+  ASSERT_EQ(filled, 2);
+  ASSERT_EQ(table.update(empty, {(Cell::Integer)3}), true);
+  ASSERT_EQ(table.remove(filled), true);
+  ASSERT_EQ(table.sync(), true);
+  table.commit();
+  auto plist = Plist::parse(path);
+  ASSERT_EQ(plist.size(), (size_t)2);
+  ASSERT_EQ(plist[1]["a"].integerValue(), 3);
+  std::remove(path.c_str());
+}
+
+TEST(PlistTable, WriteKeys)
+{
+  const std::string path = testing::TempDir() + "write-keys.plist";
+  PlistTableWriteFile(path, R"(<plist version="1.0"><array>
+    <dict><key>com.example.size</key><integer>1</integer><key>Name</key><string>a</string></dict>
+    <dict><key>name</key><string>b</string></dict>
+  </array></plist>)");
+  PlistTable table;
+  table.setWritable(true);
+  ASSERT_EQ(table.load(path, 0, ""), true);
+  ASSERT_EQ(table.getFields(), (std::vector<std::string>{"com.example.size", "name"}));
+
+  // a key containing dots stays one key, a row's own spelling of a key is kept
+  ASSERT_EQ(table.begin(), true);
+  ASSERT_EQ(table.update(0, {(Cell::Integer)2, Cell::Text("c")}), true);
+  ASSERT_EQ(table.update(1, {(Cell::Integer)3, Cell::Text("d")}), true);
+  // a new row has no spelling of its own to pick from
+  int64_t rowid;
+  ASSERT_EQ(table.insert({(Cell::Integer)4, Cell::Text("e")}, rowid), false);
+  ASSERT_NE(table.getError().find("more than one key"), std::string::npos);
+  ASSERT_EQ(table.insert({(Cell::Integer)4, nullptr}, rowid), true);
+  ASSERT_EQ(table.sync(), true);
+  table.commit();
+  auto plist = Plist::parse(path);
+  ASSERT_EQ(plist.size(), (size_t)3);
+  ASSERT_EQ(plist[0]["com.example.size"].integerValue(), 2);
+  ASSERT_EQ(plist[0]["Name"].textValue(), "c");
+  ASSERT_EQ(plist[0].size(), (size_t)2);
+  ASSERT_EQ(plist[1]["com.example.size"].integerValue(), 3);
+  ASSERT_EQ(plist[1]["name"].textValue(), "d");
+  ASSERT_EQ(plist[2]["com.example.size"].integerValue(), 4);
+  ASSERT_EQ(plist[2].size(), (size_t)1);
+  std::remove(path.c_str());
+}
+
+TEST(PlistTable, WriteReadOnly)
+{
+  const std::string path = testing::TempDir() + "write-read-only.plist";
+  PlistTableWriteFile(path, R"(<plist version="1.0"><array><dict><key>a</key><array/></dict></array></plist>)");
+  PlistTable table;
+  ASSERT_EQ(table.load(path, 0, ""), true);
+  ASSERT_EQ(table.begin(), false);
+  table.setWritable(true);
+  ASSERT_EQ(table.begin(), false);
+  ASSERT_NE(table.getError().find("array of dictionaries"), std::string::npos);
+  std::remove(path.c_str());
+}
+
+TEST(PlistTable, Nested)
+{
+  std::string xml = R"(
+<plist version="1.0">
+  <dict>
+    <key>xml</key>
+    <data>PHBsaXN0IHZlcnNpb249IjEuMCI+PGRpY3Q+PGtleT5YPC9rZXk+PGludGVnZXI+NTwvaW50ZWdlcj48a2V5Pnk8L2tleT48YXJyYXk+PHN0cmluZz5hPC9zdHJpbmc+PHN0cmluZz5iPC9zdHJpbmc+PC9hcnJheT48L2RpY3Q+PC9wbGlzdD4=</data>
+    <key>binary</key>
+    <array>
+      <data>YnBsaXN0MDDRAQJRehAHCAsNAAAAAAAAAQEAAAAAAAAAAwAAAAAAAAAAAAAAAAAAAA8=</data>
+    </array>
+    <key>other</key>
+    <data>AAEC</data>
+  </dict>
+</plist>
+)";
+  PlistTable plain;
+  ASSERT_EQ(plain.load(xml.c_str(), xml.length(), 0), true);
+  ASSERT_EQ(plain.getFields(), (std::vector<std::string>{"binary", "other", "xml"}));
+
+  PlistTable nested;
+  nested.setNested(true);
+  ASSERT_EQ(nested.load(xml.c_str(), xml.length(), 0), true);
+  auto fields = nested.getFields();
+  ASSERT_EQ(fields, (std::vector<std::string>{"binary.z", "other", "xml.x", "xml.y"}));
+  ASSERT_EQ(nested.getHeight(), (size_t)2);
+  ASSERT_EQ(nested.getCell(0, 0).integerValue(), 7);
+  ASSERT_EQ(nested.getCell(0, 2).integerValue(), 5);
+  ASSERT_EQ(nested.getCell(1, 3).textValue(), "b");
+  ASSERT_EQ(nested.getCell(0, 1).blobValue(), (Cell::Blob{0, 1, 2}));
+
+  // at the depth limit embedded plists stay data
+  PlistTable limited;
+  limited.setNested(true);
+  ASSERT_EQ(limited.load(xml.c_str(), xml.length(), 1), true);
+  ASSERT_EQ(limited.getFields(), (std::vector<std::string>{"other", "xml"}));
+}
+
+TEST(PlistTable, Archive)
+{
+  const std::string path = testing::TempDir() + "archive.plist";
+  PlistTableWriteFile(path, R"(<plist version="1.0"><dict>
+    <key>$archiver</key><string>NSKeyedArchiver</string>
+    <key>$top</key><dict><key>root</key><dict><key>CF$UID</key><integer>1</integer></dict></dict>
+    <key>$objects</key><array>
+      <string>$null</string>
+      <dict><key>$class</key><dict><key>CF$UID</key><integer>5</integer></dict>
+        <key>NS.keys</key><array><dict><key>CF$UID</key><integer>2</integer></dict></array>
+        <key>NS.objects</key><array><dict><key>CF$UID</key><integer>3</integer></dict></array></dict>
+      <string>people</string>
+      <dict><key>$class</key><dict><key>CF$UID</key><integer>6</integer></dict>
+        <key>NS.objects</key><array><dict><key>CF$UID</key><integer>4</integer></dict><dict><key>CF$UID</key><integer>4</integer></dict></array></dict>
+      <dict><key>$class</key><dict><key>CF$UID</key><integer>7</integer></dict>
+        <key>name</key><string>Ann</string><key>owner</key><dict><key>CF$UID</key><integer>1</integer></dict></dict>
+      <dict><key>$classname</key><string>NSDictionary</string><key>$classes</key><array><string>NSDictionary</string><string>NSObject</string></array></dict>
+      <dict><key>$classname</key><string>NSArray</string><key>$classes</key><array><string>NSArray</string><string>NSObject</string></array></dict>
+      <dict><key>$classname</key><string>Person</string><key>$classes</key><array><string>Person</string><string>NSObject</string></array></dict>
+    </array>
+  </dict></plist>)");
+  PlistTable table;
+  table.setArchive(true);
+  ASSERT_EQ(table.load(path, 0, "people"), true);
+  ASSERT_EQ(table.getFields(), (std::vector<std::string>{"$class", "name", "owner.cf$uid"}));
+  ASSERT_EQ(table.getHeight(), (size_t)2);
+  ASSERT_EQ(table.getCell(1, 0).textValue(), "Person");
+  ASSERT_EQ(table.getCell(1, 1).textValue(), "Ann");
+  ASSERT_EQ(table.getCell(1, 2).integerValue(), 1);
+
+  table.setWritable(true);
+  ASSERT_EQ(table.begin(), false);
+}
+
+TEST(PlistTable, Cache)
+{
+  const std::string directory = testing::TempDir();
+  const std::string path = directory + "cache.plist";
+  const std::string document = R"(<plist version="1.0"><array>
+    <dict><key>Name</key><string>a</string><key>Done</key><true/><key>Size</key><real>1.5</real></dict>
+    <dict><key>Name</key><string>a</string><key>Data</key><data>AAEC</data><key>Date</key><date>2020-01-01T00:00:00Z</date></dict>
+  </array></plist>)";
+  // the fingerprint is kept across rewrites of the same size, so only the cache can tell the old rows
+  const struct utimbuf time = {1000000000, 1000000000};
+  const auto cachePath = TableCache::getPath(directory, path, "0\n\n\n");
+  PlistTableWriteFile(path, document);
+  remove(cachePath.c_str());
+  utime(path.c_str(), &time);
+
+  PlistTable table;
+  table.setCache(directory);
+  ASSERT_EQ(table.load(path, 0, ""), true);
+  // rows still loaded by a table would be shared instead of read from the cache
+  table.unload();
+
+  std::string changed = document;
+  changed.replace(changed.find("<string>a"), 9, "<string>b");
+  PlistTableWriteFile(path, changed);
+  utime(path.c_str(), &time);
+
+  PlistTable cached;
+  cached.setCache(directory);
+  ASSERT_EQ(cached.load(path, 0, ""), true);
+  ASSERT_EQ(cached.getFields(), (std::vector<std::string>{"done", "name", "size", "data", "date"}));
+  ASSERT_EQ(cached.getHeight(), (size_t)2);
+  ASSERT_EQ(cached.getCell(0, 1).textValue(), "a");
+  ASSERT_EQ(cached.getCell(1, 1).textValue(), "a");
+  ASSERT_EQ(cached.getCell(0, 0).isBoolean(), true);
+  ASSERT_EQ(cached.getCell(0, 0).integerValue(), 1);
+  ASSERT_EQ(cached.getCell(0, 2).realValue(), 1.5);
+  ASSERT_EQ(cached.getCell(1, 3).blobValue(), (Cell::Blob{0, 1, 2}));
+  ASSERT_EQ(cached.getCell(1, 4).isDate(), true);
+  ASSERT_EQ(cached.getCell(1, 4).realValue(), 599529600.0);
+  ASSERT_EQ(cached.getCell(0, 3).isNull(), true);
+
+  // tables built differently from the same file don't share a cache
+  ASSERT_NE(TableCache::getPath(directory, path, "0\n\n\n"), TableCache::getPath(directory, path, "1\n\n\n"));
+
+  // a damaged cache is ignored
+  cached.unload();
+  FILE *file = fopen(cachePath.c_str(), "r+");
+  ASSERT_NE(file, nullptr);
+  fseek(file, 80, SEEK_SET);
+  fputc('x', file);
+  fclose(file);
+  PlistTable parsed;
+  parsed.setCache(directory);
+  ASSERT_EQ(parsed.load(path, 0, ""), true);
+  ASSERT_EQ(parsed.getCell(0, 1).textValue(), "b");
+
+  std::string bytes;
+  ASSERT_EQ(TableCache::serialize(Table<Cell>("items", Cell::Column{(Cell::Integer)1}), "", bytes), false);
+}
+
+TEST(PlistTable, Sample)
+{
+  const std::string path = testing::TempDir() + "sample.plist";
+  PlistTableWriteFile(path, R"(<plist version="1.0"><array>
+    <dict><key>Name</key><string>a</string></dict>
+    <dict><key>Name</key><string>b</string><key>Extra</key><integer>1</integer></dict>
+    <dict><key>Name</key><string>c</string></dict>
+    <dict><key>Name</key><string>d</string></dict>
+    <dict><key>Name</key><string>e</string><key>Size</key><integer>5</integer></dict>
+    <dict><key>Name</key><string>f</string></dict>
+  </array></plist>)");
+
+  PlistTable table;
+  table.setReloadMode(PlistTable::RELOAD_OFF);
+  table.setSample(3);
+  ASSERT_EQ(table.load(path, 0, ""), true);
+  ASSERT_EQ(table.getFields(), (std::vector<std::string>{"name", "size", "_residual"}));
+  ASSERT_EQ(table.getElementCount(), (size_t)6);
+  const auto types = table.getTypes();
+  ASSERT_EQ(types[0], TypedColumn::TEXT);
+  ASSERT_EQ(types[1], TypedColumn::INTEGER);
+
+  // the rows are flattened in the background, a scan waits for them
+  ASSERT_EQ(table.refresh(), true);
+  ASSERT_EQ(table.getTypes(), types);
+  ASSERT_EQ(table.getFields(), (std::vector<std::string>{"name", "size", "_residual"}));
+  ASSERT_EQ(table.getHeight(), (size_t)6);
+  ASSERT_EQ(table.getCell(5, 0).textValue(), "f");
+  ASSERT_EQ(table.getCell(4, 1).integerValue(), 5);
+  ASSERT_TRUE(table.getCell(0, 2).isNull());
+  ASSERT_EQ(table.getCell(1, 2).rowValue().at("extra").integerValue(), 1);
+
+  // small documents aren't sampled
+  PlistTable whole;
+  whole.setSample(10);
+  ASSERT_EQ(whole.load(path, 0, ""), true);
+  ASSERT_EQ(whole.getFields(), (std::vector<std::string>{"name", "extra", "size"}));
+  ASSERT_EQ(whole.getHeight(), (size_t)6);
+}
+
+TEST(PlistTable, Shared)
+{
+  const std::string path = testing::TempDir() + "shared.plist";
+  PlistTableWriteFile(path, R"(<plist version="1.0"><array>
+    <dict><key>Name</key><string>a</string><key>Size</key><integer>1</integer></dict>
+    <dict><key>Name</key><string>b</string><key>Size</key><integer>2</integer></dict>
+  </array></plist>)");
+
+  const size_t totalBefore = PlistTable::getTotalMemoryUsage();
+  std::vector<std::unique_ptr<PlistTable>> tables(8);
+  std::vector<std::thread> threads;
+  for (auto &table : tables) {
+    table.reset(new PlistTable());
+    table->setReloadMode(PlistTable::RELOAD_OFF);
+    threads.emplace_back([&table, &path] { table->load(path, 0, ""); });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (auto &table : tables) {
+    ASSERT_EQ(table->getSnapshot(), tables[0]->getSnapshot());
+    ASSERT_EQ(table->getFields(), (std::vector<std::string>{"name", "size"}));
+  }
+  ASSERT_EQ(tables[0]->getCell(1, 1).integerValue(), 2);
+  ASSERT_EQ(PlistTable::getTotalMemoryUsage(), totalBefore + tables[0]->getMemoryUsage());
+
+  // sharing doesn't get around a table's own limit
+  PlistTable limited;
+  limited.setMemoryLimit(tables[0]->getMemoryUsage() - 1);
+  ASSERT_EQ(limited.load(path, 0, ""), false);
+  ASSERT_NE(limited.getError().find("memory limit"), std::string::npos);
+
+  // the rows outlive the table that loaded them
+  const auto snapshot = tables[0]->getSnapshot();
+  tables.clear();
+  ASSERT_EQ(snapshot->getCell(0, 0).textValue(), "a");
+
+  PlistTable other;
+  ASSERT_EQ(other.load(path, 1, ""), true);
+  ASSERT_NE(other.getSnapshot(), snapshot);
+  PlistTable writable;
+  writable.setWritable(true);
+  ASSERT_EQ(writable.load(path, 0, ""), true);
+  ASSERT_NE(writable.getSnapshot(), snapshot);
+}
+
+TEST(PlistTable, Stream)
+{
+  const std::string path = testing::TempDir() + "stream.plist";
+  PlistTableWriteFile(path, R"(<plist version="1.0"><dict><key>Items</key><array>
+    <dict><key>Name</key><string>a</string></dict>
+    <dict><key>Name</key><string>b</string><key>Tags</key><array><string>x</string><string>y</string></array></dict>
+    <dict/>
+    <dict><key>Size</key><integer>4</integer></dict>
+  </array></dict></plist>)");
+
+  PlistTable table;
+  table.setStreaming(true);
+  ASSERT_EQ(table.load(path, 0, "Items"), true);
+  ASSERT_EQ(table.getFields(), (std::vector<std::string>{"name", "tags", "size"}));
+  ASSERT_EQ(table.getHeight(), (size_t)0);
+  ASSERT_EQ(table.getElementCount(), (size_t)4);
+
+  std::shared_ptr<PlistReader> reader;
+  PlistReader::Node node;
+  ASSERT_EQ(table.openStream(reader, node), true);
+  std::vector<std::vector<Cell>> rows;
+  size_t position = 0;
+  std::shared_ptr<const PlistTable::Snapshot> snapshot;
+  while (table.readStream(*reader, node, position, snapshot) && snapshot != nullptr) {
+    for (size_t row = 0; row < snapshot->getHeight(); row++) {
+      rows.push_back({snapshot->getCell(row, 0), snapshot->getCell(row, 1), snapshot->getCell(row, 2)});
+    }
+  }
+  ASSERT_EQ(rows.size(), (size_t)4);
+  ASSERT_EQ(rows[0][0].textValue(), "a");
+  ASSERT_EQ(rows[1][1].textValue(), "x");
+  ASSERT_EQ(rows[2][0].textValue(), "b");
+  ASSERT_EQ(rows[2][1].textValue(), "y");
+  ASSERT_EQ(rows[3][2].integerValue(), 4);
+
+  PlistTable sampled;
+  sampled.setStreaming(true);
+  sampled.setSample(2);
+  ASSERT_EQ(sampled.load(path, 0, "Items"), true);
+  ASSERT_EQ(sampled.getFields(), (std::vector<std::string>{"name", "_residual"}));
+
+  PlistTable scalar;
+  scalar.setStreaming(true);
+  ASSERT_EQ(scalar.load(path, 0, "Items.Missing"), false);
+}
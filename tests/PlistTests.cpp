@@ -204,3 +204,55 @@ TEST(Plist, DictionaryNonEmptyKeyPath)
   ASSERT_EQ(plist3["key4"].isText(), true);
   ASSERT_EQ(plist3["key4"].textValue(), "");
 }
+
+TEST(Plist, DepthLimited)
+{
+  std::string xml = R"(
+<?xml version="1.0" encoding="UTF-8"?>
+<!DOCTYPE plist PUBLIC "-//Apple//DTD PLIST 1.0//EN" "http://www.apple.com/DTDs/ PropertyList-1.0.dtd">
+<plist version="1.0">
+  <dict>
+    <key>key1</key>
+    <string>text</string>
+    <key>key2</key>
+    <dict>
+      <key>key3</key>
+      <array>
+        <integer>42</integer>
+      </array>
+    </dict>
+  </dict>
+</plist>
+)";
+  auto plist = Plist::parse(xml.c_str(), xml.length(), "", 1);
+  ASSERT_EQ(plist.isRow(), true);
+  ASSERT_EQ(plist["key1"].textValue(), "text");
+  ASSERT_EQ(plist["key2"].isRow(), true);
+  ASSERT_EQ(plist["key2"]["key3"][0].integerValue(), 42);
+
+  auto keyPathPlist = Plist::parse(xml.c_str(), xml.length(), "key2", 1);
+  ASSERT_EQ(keyPathPlist.isRow(), true);
+  ASSERT_EQ(keyPathPlist["key3"].isColumn(), true);
+}
+
+TEST(Plist, Deep)
+{
+  // a call per level would need a far larger stack than this, containers are measured and freed in a loop
+  Cell cell = (Cell::Integer)1;
+  for (int level = 0; level < 1000000; level++) {
+    if (level % 2 == 0) {
+      cell = Cell(Cell::Column{cell, (Cell::Integer)level});
+    }
+    else {
+      Cell::Row row;
+      row.insert({"a", cell});
+      cell = Cell(std::move(row));
+    }
+  }
+  ASSERT_GT(cell.memoryUsage(), 1000000 * sizeof(Cell));
+
+  Cell shared = cell["a"];
+  cell = nullptr;
+  ASSERT_EQ(shared[1].integerValue(), 999998);
+  ASSERT_EQ(shared[0]["a"][1].integerValue(), 999996);
+}
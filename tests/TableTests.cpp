@@ -217,3 +217,15 @@ TEST(Table, ComplexCombineComplex)
   ASSERT_EQ(t1["aa"], std::vector<int>({11, 11, 11, 13, 13, 13}));
   ASSERT_EQ(t1["bb"], std::vector<int>({12, 12, 12, 14, 14, 14}));
 }
+
+TEST(Table, ProjectedMemoryUsage)
+{
+  Table<int> t1{std::map<std::string, std::vector<int>>{{"a", {1, 2}}, {"b", {3, 4}}}};
+  Table<int> t2{std::map<std::string, std::vector<int>>{{"c", {5, 6, 7}}}};
+  ASSERT_EQ(t1.combinedMemoryUsage(t2), Table<int>::memoryUsage(3, 6));
+  ASSERT_EQ(t1.joinedMemoryUsage(t2), Table<int>::memoryUsage(3, 5));
+  ASSERT_EQ(t1.joinedMemoryUsage(t1), Table<int>::memoryUsage(2, 4));
+  ASSERT_EQ(Table<int>::memoryUsage(2, std::numeric_limits<size_t>::max()), std::numeric_limits<size_t>::max());
+  t1.combine(t2);
+  ASSERT_GE(t1.memoryUsage(), Table<int>::memoryUsage(3, 6));
+}
@@ -0,0 +1,39 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include "Trace.hpp"
+
+TEST(Trace, DisabledScope)
+{
+  ASSERT_EQ(Trace::isEnabled(), false);
+  TRACE_SCOPE("Trace::disabled");
+}
+
+TEST(Trace, CompleteEvents)
+{
+  const std::string path = testing::TempDir() + "trace.json";
+  ASSERT_EQ(Trace::start(path), true);
+  ASSERT_EQ(Trace::isEnabled(), true);
+  ASSERT_EQ(Trace::start(path), true);
+  ASSERT_EQ(Trace::start(testing::TempDir() + "other-trace.json"), false);
+  {
+    TRACE_SCOPE("Trace::outer");
+    TRACE_SCOPE("Trace::inner");
+  }
+  Trace::complete("Trace::scan", 10, 15, "rows", 42);
+  Trace::stop();
+  ASSERT_EQ(Trace::isEnabled(), false);
+
+  std::ifstream file(path);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  auto json = contents.str();
+  ASSERT_EQ(json.front(), '[');
+  ASSERT_NE(json.find("\"name\":\"Trace::outer\""), std::string::npos);
+  ASSERT_NE(json.find("\"name\":\"Trace::inner\""), std::string::npos);
+  ASSERT_NE(json.find("\"ts\":10,\"dur\":5"), std::string::npos);
+  ASSERT_NE(json.find("\"args\":{\"rows\":42}"), std::string::npos);
+  ASSERT_NE(json.find("]"), std::string::npos);
+  std::remove(path.c_str());
+}
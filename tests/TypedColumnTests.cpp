@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include "TypedColumn.hpp"
+
+TEST(TypedColumn, Infer)
+{
+  ASSERT_EQ(TypedColumn::infer({}), TypedColumn::NUL);
+  ASSERT_EQ(TypedColumn::infer({nullptr, nullptr}), TypedColumn::NUL);
+  ASSERT_EQ(TypedColumn::infer({(Cell::Integer)1, nullptr, (Cell::Integer)2}), TypedColumn::INTEGER);
+  ASSERT_EQ(TypedColumn::infer({Cell::boolean(true), nullptr}), TypedColumn::BOOLEAN);
+  ASSERT_EQ(TypedColumn::infer({Cell::boolean(true), (Cell::Integer)1}), TypedColumn::MIXED);
+  ASSERT_EQ(TypedColumn::infer({(Cell::Real)1.5, Cell::date(0)}), TypedColumn::MIXED);
+  ASSERT_EQ(TypedColumn::infer({Cell::date(0)}), TypedColumn::DATE);
+  ASSERT_EQ(TypedColumn::infer({Cell::Text("a"), Cell::Blob{1}}), TypedColumn::MIXED);
+  ASSERT_EQ(TypedColumn::infer({Cell::Row{}}), TypedColumn::MIXED);
+
+  ASSERT_STREQ(TypedColumn::getDeclaredType(TypedColumn::BOOLEAN), "INTEGER");
+  ASSERT_STREQ(TypedColumn::getDeclaredType(TypedColumn::DATE), "REAL");
+  ASSERT_STREQ(TypedColumn::getDeclaredType(TypedColumn::MIXED), "");
+}
+
+TEST(TypedColumn, Dense)
+{
+  TypedColumn integers({(Cell::Integer)-1, nullptr, (Cell::Integer)3});
+  ASSERT_EQ(integers.getType(), TypedColumn::INTEGER);
+  ASSERT_EQ(integers.size(), (size_t)3);
+  ASSERT_FALSE(integers.isNull(0));
+  ASSERT_TRUE(integers.isNull(1));
+  ASSERT_EQ(integers.getInteger(2), 3);
+  ASSERT_EQ(integers.getCell(0).integerValue(), -1);
+  ASSERT_TRUE(integers.getCell(1).isNull());
+  ASSERT_TRUE(integers.getCell(3).isNull());
+
+  TypedColumn texts({Cell::Text("one"), nullptr, Cell::Text(std::string("t\0o", 3))});
+  ASSERT_EQ(texts.getType(), TypedColumn::TEXT);
+  size_t length;
+  ASSERT_EQ(std::string(texts.getBytes(0, length), 3), "one");
+  ASSERT_EQ(length, (size_t)3);
+  ASSERT_TRUE(texts.isNull(1));
+  ASSERT_EQ(texts.getCell(2).textValue(), std::string("t\0o", 3));
+
+  TypedColumn blobs({Cell::Blob{1, 2}, Cell::Blob{}});
+  ASSERT_EQ(blobs.getType(), TypedColumn::BLOB);
+  ASSERT_EQ(blobs.getCell(0).blobValue(), (Cell::Blob{1, 2}));
+  ASSERT_TRUE(blobs.getCell(1).isBlob());
+
+  TypedColumn booleans({Cell::boolean(false), Cell::boolean(true)});
+  ASSERT_TRUE(booleans.getCell(1).isBoolean());
+  ASSERT_EQ(booleans.getInteger(1), 1);
+
+  TypedColumn dates({Cell::date(10.5)});
+  ASSERT_TRUE(dates.getCell(0).isDate());
+  ASSERT_EQ(dates.getReal(0), 10.5);
+
+  // 100 rows crossing words of the null bitmap
+  std::vector<Cell> cells;
+  for (int row = 0; row < 100; row++) {
+    cells.push_back(row % 3 == 0 ? Cell(nullptr) : Cell((Cell::Real)row));
+  }
+  TypedColumn reals(cells);
+  ASSERT_EQ(reals.getType(), TypedColumn::REAL);
+  for (size_t row = 0; row < cells.size(); row++) {
+    ASSERT_EQ(reals.isNull(row), row % 3 == 0);
+  }
+  ASSERT_EQ(reals.getReal(98), 98.0);
+}
+
+TEST(TypedColumn, Encoded)
+{
+  std::vector<Cell> cells;
+  for (int row = 0; row < 10; row++) {
+    cells.push_back(row == 4 ? Cell(nullptr) : Cell(Cell::Text(row % 3 == 0 ? "ok" : row % 3 == 1 ? "" : "failed")));
+  }
+  TypedColumn column(cells);
+  ASSERT_EQ(column.getType(), TypedColumn::TEXT);
+  ASSERT_TRUE(column.isEncoded());
+  ASSERT_TRUE(column.isNull(4));
+  for (size_t row = 0; row < cells.size(); row++) {
+    if (row != 4) {
+      ASSERT_EQ(column.getCell(row).textValue(), cells[row].textValue());
+    }
+  }
+  ASSERT_EQ(column.getCode(0), column.getCode(3));
+  ASSERT_NE(column.getCode(0), column.getCode(1));
+
+  uint32_t code;
+  ASSERT_TRUE(column.findCode("failed", 6, code));
+  ASSERT_EQ(code, column.getCode(2));
+  ASSERT_TRUE(column.findCode("", 0, code));
+  ASSERT_EQ(code, column.getCode(1));
+  ASSERT_FALSE(column.findCode("o", 1, code));
+  ASSERT_FALSE(column.findCode("oka", 3, code));
+
+  // mostly distinct values are stored as they are
+  TypedColumn distinct({Cell::Text("a"), Cell::Text("b"), Cell::Text("a")});
+  ASSERT_FALSE(distinct.isEncoded());
+  ASSERT_EQ(distinct.getCell(2).textValue(), "a");
+}
+
+TEST(TypedColumn, Mixed)
+{
+  TypedColumn mixed({Cell::Text("a"), (Cell::Integer)1, nullptr, Cell::Column{(Cell::Integer)2}});
+  ASSERT_EQ(mixed.getType(), TypedColumn::MIXED);
+  ASSERT_TRUE(mixed.isNull(2));
+  ASSERT_EQ(mixed.getMixed(0).textValue(), "a");
+  ASSERT_EQ(mixed.getCell(1).integerValue(), 1);
+  ASSERT_EQ(mixed.getCell(3).type(), Cell::COLUMN);
+  ASSERT_GT(mixed.memoryUsage(), 4 * sizeof(Cell));
+}
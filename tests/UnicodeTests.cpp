@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+#include <random>
+#include "Unicode.hpp"
+
+static std::string UnicodeDecode(const std::string &utf16)
+{
+  std::string utf8 = "prefix";
+  Unicode::appendUtf16BE(utf8, (const uint8_t *)utf16.data(), utf16.size() / 2);
+  return utf8.substr(6);
+}
+
+TEST(Unicode, Utf16BE)
+{
+  // runs of every width at every offset within and across the transcoder's blocks
+  std::mt19937 random(42);
+  const uint32_t codePoints[] = {'a', 0xE9, 0x4E2D, 0x1F600};
+  for (size_t length = 0; length < 100; length++) {
+    for (int mix = 0; mix < 40; mix++) {
+      std::string utf8;
+      for (size_t index = 0; index < length; index++) {
+        // random widths, or runs of `mix` units of one width
+        const size_t width = mix == 0 ? random() % 4 : (index / mix) % 4;
+        Unicode::appendUtf8(utf8, codePoints[width] + (width == 0 ? random() % 26 : random() % 64));
+      }
+      std::string utf16;
+      Unicode::encodeUtf16BE(utf16, utf8);
+      ASSERT_EQ(UnicodeDecode(utf16), utf8);
+    }
+  }
+
+  // lone surrogates, high ones at the end of a block and of the text
+  std::string utf16;
+  for (int index = 0; index < 7; index++) {
+    utf16 += std::string("\0a", 2);
+  }
+  utf16 += std::string("\xD8\x3D" "\0b" "\xDE\x00" "\xD8\x3D", 8);
+  ASSERT_EQ(UnicodeDecode(utf16), "aaaaaaa\xEF\xBF\xBD" "b\xEF\xBF\xBD\xEF\xBF\xBD");
+  ASSERT_EQ(UnicodeDecode(std::string("\xD8\x3D\xDE\x00", 4)), "\xF0\x9F\x98\x80");
+  ASSERT_EQ(UnicodeDecode(""), "");
+}
+
+TEST(Unicode, Utf16)
+{
+  // an ASCII run, a pair and a CJK run, in the machine's byte order
+  std::string utf8 = std::string(20, 'a') + "\xC3\xA9\xF0\x9F\x98\x80";
+  for (int index = 0; index < 20; index++) {
+    utf8 += "\xE4\xB8\xAD";
+  }
+  std::string utf16;
+  Unicode::encodeUtf16BE(utf16, utf8);
+  std::vector<uint16_t> units;
+  for (size_t index = 0; index < utf16.size(); index += 2) {
+    units.push_back((uint16_t)((uint8_t)utf16[index] << 8 | (uint8_t)utf16[index + 1]));
+  }
+  units.push_back(0xDC00);
+  std::string decoded;
+  Unicode::appendUtf16(decoded, units.data(), units.size());
+  ASSERT_EQ(decoded, utf8 + "\xEF\xBF\xBD");
+}
@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+#include <climits>
+#include <clocale>
+#include "PlistReader.hpp"
+#include "XmlPlistWriter.hpp"
+
+TEST(XmlPlistWriter, RoundTrip)
+{
+  const Cell::Row row{
+    {"integer", (Cell::Integer)-42},
+    {"real", 0.1},
+    {"boolean", Cell::boolean(false)},
+    {"date", Cell::date(-86400.0)},
+    {"text", Cell::Text("<a & b>")},
+    {"blob", Cell::Blob{0xFF, 0, 1, 2}},
+    {"empty", Cell::Column()},
+    {"items", Cell::Column{(Cell::Integer)1, Cell::Row{{"key", Cell::Text("ключ")}}}},
+    {"missing", nullptr},
+  };
+
+  std::string xml;
+  ASSERT_EQ(XmlPlistWriter::write(row, xml), true);
+  ASSERT_NE(xml.find("<string>&lt;a &amp; b&gt;</string>"), std::string::npos);
+  ASSERT_NE(xml.find("<date>2000-12-31T00:00:00Z</date>"), std::string::npos);
+  ASSERT_NE(xml.find("<real>0.1</real>"), std::string::npos);
+  ASSERT_NE(xml.find("<data>/wABAg==</data>"), std::string::npos);
+
+  auto reader = PlistReader::create(Buffer::copy(xml.data(), xml.size()));
+  ASSERT_NE(reader, nullptr);
+  auto cell = reader->read(reader->getRoot(), INT_MAX);
+  ASSERT_EQ(cell.size(), (size_t)8);
+  ASSERT_EQ(cell["integer"].integerValue(), -42);
+  ASSERT_EQ(cell["real"].realValue(), 0.1);
+  ASSERT_EQ(cell["boolean"].isBoolean(), true);
+  ASSERT_EQ(cell["date"].realValue(), -86400.0);
+  ASSERT_EQ(cell["text"].textValue(), "<a & b>");
+  ASSERT_EQ(cell["blob"].blobValue(), (Cell::Blob{0xFF, 0, 1, 2}));
+  ASSERT_EQ(cell["empty"].size(), (size_t)0);
+  ASSERT_EQ(cell["items"][1]["key"].textValue(), "ключ");
+}
+
+TEST(XmlPlistWriter, ControlCharacters)
+{
+  std::string xml;
+  ASSERT_EQ(XmlPlistWriter::write(Cell::Row{{"a\x01", Cell::Text("b\x1F\tc\n\x7F")}}, xml), true);
+  ASSERT_NE(xml.find("<key>a</key>"), std::string::npos);
+  ASSERT_NE(xml.find("<string>b\tc\n\x7F</string>"), std::string::npos);
+}
+
+TEST(XmlPlistWriter, Locale)
+{
+  // a comma-decimal locale, if the system has one, doesn't change the format
+  const std::string previous = setlocale(LC_NUMERIC, NULL);
+  const bool hasLocale = setlocale(LC_NUMERIC, "de_DE.UTF-8") != NULL || setlocale(LC_NUMERIC, "de_DE") != NULL;
+  std::string xml;
+  const bool isWritten = XmlPlistWriter::write(Cell::Column{1.5, 1e-300, 0.1 + 0.2}, xml);
+  setlocale(LC_NUMERIC, previous.c_str());
+  ASSERT_EQ(isWritten, true);
+  ASSERT_NE(xml.find("<real>1.5</real>"), std::string::npos) << hasLocale;
+  ASSERT_NE(xml.find("<real>1e-300</real>"), std::string::npos);
+  ASSERT_NE(xml.find("<real>0.30000000000000004</real>"), std::string::npos);
+}